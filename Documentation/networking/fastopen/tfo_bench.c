@@ -0,0 +1,276 @@
+/*
+ * TCP Fast Open request/response latency benchmark
+ *
+ * A server process accepts connections on the loopback interface, reads
+ * one request from each and answers it with one response.  The client
+ * opens a new connection for every request, once with connect() followed
+ * by send(), and once with sendto(MSG_FASTOPEN), which puts the request
+ * into the SYN when a Fast Open cookie for the server is cached.  For
+ * each mode it prints the mean time from opening the connection to
+ * receiving the response:
+ *
+ *	tfo_bench [-p port] [-n requests] [-l request_len] [-L response_len]
+ *
+ * Both the client and the server side need to be enabled first:
+ *
+ *	echo 3 > /proc/sys/net/ipv4/tcp_fastopen
+ *
+ * On loopback the handshake costs next to nothing; the round trip that
+ * Fast Open saves only shows up with some latency on the path, e.g.
+ *
+ *	tc qdisc add dev lo root netem delay 50ms
+ *
+ * The TCPFastOpen* counters of /proc/net/netstat are shown per mode too.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#ifndef MSG_FASTOPEN
+#define MSG_FASTOPEN	0x20000000
+#endif
+#ifndef TCP_FASTOPEN
+#define TCP_FASTOPEN	23
+#endif
+
+#define MAX_LEN		65536
+#define NR_COUNTERS	6
+
+static const char *counter_names[NR_COUNTERS] = {
+	"TCPFastOpenActive", "TCPFastOpenActiveFail",
+	"TCPFastOpenPassive", "TCPFastOpenPassiveFail",
+	"TCPFastOpenListenOverflow", "TCPFastOpenCookieReqd",
+};
+
+static int port = 8765;
+static int requests = 1000;
+static int request_len = 100;
+static int response_len = 1000;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-p port] [-n requests] [-l request_len]\n"
+		"       [-L response_len]\n", prog);
+	exit(1);
+}
+
+static void bail(const char *error)
+{
+	perror(error);
+	exit(1);
+}
+
+/* read all of len bytes, or until the peer closes */
+static int read_full(int fd, char *buf, int len)
+{
+	int n, done = 0;
+
+	while (done < len) {
+		n = read(fd, buf + done, len - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		done += n;
+	}
+	return done;
+}
+
+static void serve(int fd)
+{
+	static char buf[MAX_LEN];
+	int conn;
+
+	memset(buf, 0x5a, sizeof(buf));
+	for (;;) {
+		conn = accept(fd, NULL, NULL);
+		if (conn < 0) {
+			if (errno == EINTR)
+				continue;
+			bail("accept");
+		}
+		if (read_full(conn, buf, request_len) == request_len &&
+		    write(conn, buf, response_len) != response_len)
+			bail("write");
+		close(conn);
+	}
+}
+
+static pid_t start_server(void)
+{
+	struct sockaddr_in sin;
+	int fd, one = 1, qlen = 128;
+	pid_t pid;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		bail("socket");
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen)) < 0)
+		bail("setsockopt TCP_FASTOPEN");
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+		bail("bind");
+	if (listen(fd, 1024) < 0)
+		bail("listen");
+
+	pid = fork();
+	if (pid < 0)
+		bail("fork");
+	if (!pid)
+		serve(fd);
+	close(fd);
+	return pid;
+}
+
+/* the TCPFastOpen* fields from the TcpExt lines of /proc/net/netstat */
+static void read_counters(unsigned long long *val)
+{
+	char names[4096], values[4096];
+	char *n, *v, *ns, *vs;
+	FILE *f;
+	int i;
+
+	memset(val, 0, NR_COUNTERS * sizeof(*val));
+	f = fopen("/proc/net/netstat", "r");
+	if (!f)
+		return;
+	while (fgets(names, sizeof(names), f) &&
+	       fgets(values, sizeof(values), f)) {
+		if (strncmp(names, "TcpExt:", 7))
+			continue;
+		n = strtok_r(names, " \n", &ns);
+		v = strtok_r(values, " \n", &vs);
+		while ((n = strtok_r(NULL, " \n", &ns)) &&
+		       (v = strtok_r(NULL, " \n", &vs)))
+			for (i = 0; i < NR_COUNTERS; i++)
+				if (!strcmp(n, counter_names[i]))
+					val[i] = strtoull(v, NULL, 10);
+	}
+	fclose(f);
+}
+
+static double run(int fastopen)
+{
+	static char buf[MAX_LEN];
+	struct sockaddr_in sin;
+	struct timeval t0, t1;
+	int i, fd;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	memset(buf, 0xa5, request_len);
+
+	gettimeofday(&t0, NULL);
+	for (i = 0; i < requests; i++) {
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0)
+			bail("socket");
+		if (fastopen) {
+			if (sendto(fd, buf, request_len, MSG_FASTOPEN,
+				   (struct sockaddr *)&sin,
+				   sizeof(sin)) != request_len)
+				bail("sendto MSG_FASTOPEN");
+		} else {
+			if (connect(fd, (struct sockaddr *)&sin,
+				    sizeof(sin)) < 0)
+				bail("connect");
+			if (send(fd, buf, request_len, 0) != request_len)
+				bail("send");
+		}
+		if (read_full(fd, buf, response_len) != response_len) {
+			fprintf(stderr, "short response\n");
+			exit(1);
+		}
+		close(fd);
+	}
+	gettimeofday(&t1, NULL);
+
+	return ((t1.tv_sec - t0.tv_sec) * 1e6 +
+		(t1.tv_usec - t0.tv_usec)) / requests;
+}
+
+static void report(const char *mode, double usecs,
+		   unsigned long long *before, unsigned long long *after)
+{
+	int i;
+
+	printf("%-10s %10.1f us per request\n", mode, usecs);
+	for (i = 0; i < NR_COUNTERS; i++)
+		if (after[i] != before[i])
+			printf("           %-26s +%llu\n", counter_names[i],
+			       after[i] - before[i]);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long c0[NR_COUNTERS], c1[NR_COUNTERS], c2[NR_COUNTERS];
+	double plain, fast;
+	pid_t server;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:n:l:L:")) != -1) {
+		switch (opt) {
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'n':
+			requests = atoi(optarg);
+			break;
+		case 'l':
+			request_len = atoi(optarg);
+			break;
+		case 'L':
+			response_len = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (requests < 1 || request_len < 1 || request_len > MAX_LEN ||
+	    response_len < 1 || response_len > MAX_LEN)
+		usage(argv[0]);
+
+	printf("%d requests of %d bytes, %d byte responses, port %d\n",
+	       requests, request_len, response_len, port);
+	/* don't let the server inherit buffered output */
+	fflush(stdout);
+
+	server = start_server();
+
+	read_counters(c0);
+	plain = run(0);
+	read_counters(c1);
+	fast = run(1);
+	read_counters(c2);
+
+	report("connect", plain, c0, c1);
+	report("fastopen", fast, c1, c2);
+
+	kill(server, SIGKILL);
+	waitpid(server, NULL, 0);
+	return 0;
+}
@@ -0,0 +1,310 @@
+/*
+ * Loopback accept rate benchmark for SO_REUSEPORT
+ *
+ * Runs an increasing number of worker processes that do nothing but
+ * accept() and close() connections on the same TCP port, while a set of
+ * client processes connect to that port over the loopback interface as
+ * fast as they can.  For every number of workers it prints the number of
+ * connections accepted per second, and the smallest and largest share of
+ * a single worker, which shows how evenly the load is spread.
+ *
+ * In the default mode each worker has its own listening socket, bound
+ * with SO_REUSEPORT, so the kernel spreads the connections over them by
+ * flow hash.  With -s all workers accept() on a single socket shared
+ * across fork(), which is what servers have to do without SO_REUSEPORT,
+ * for comparison.
+ *
+ *	reuseport_bench [-s] [-6] [-p port] [-w max_workers]
+ *			[-c clients] [-t seconds]
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#ifndef SO_REUSEPORT
+# define SO_REUSEPORT	15
+#endif
+
+#define MAX_WORKERS	256
+
+static int shared;
+static int family = AF_INET;
+static int port = 5555;
+static int max_workers;
+static int nr_clients = 4;
+static int seconds = 5;
+
+static volatile sig_atomic_t done;
+
+/* one accept counter per worker, in memory shared with the parent */
+static volatile unsigned long *accepts;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-s] [-6] [-p port] [-w max_workers] "
+		"[-c clients] [-t seconds]\n"
+		"  -s  share one listening socket instead of SO_REUSEPORT\n"
+		"  -6  use IPv6 instead of IPv4 loopback\n", prog);
+	exit(1);
+}
+
+static void bail(const char *error)
+{
+	perror(error);
+	exit(1);
+}
+
+static void stop(int sig)
+{
+	done = 1;
+}
+
+static socklen_t loopback_addr(struct sockaddr_storage *ss)
+{
+	memset(ss, 0, sizeof(*ss));
+	if (family == AF_INET6) {
+		struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ss;
+
+		sin6->sin6_family = AF_INET6;
+		sin6->sin6_port = htons(port);
+		sin6->sin6_addr = in6addr_loopback;
+		return sizeof(*sin6);
+	} else {
+		struct sockaddr_in *sin = (struct sockaddr_in *)ss;
+
+		sin->sin_family = AF_INET;
+		sin->sin_port = htons(port);
+		sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		return sizeof(*sin);
+	}
+}
+
+static int listen_socket(int reuseport)
+{
+	struct sockaddr_storage ss;
+	socklen_t len = loopback_addr(&ss);
+	int one = 1;
+	int fd;
+
+	fd = socket(family, SOCK_STREAM, 0);
+	if (fd < 0)
+		bail("socket");
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0)
+		bail("setsockopt SO_REUSEADDR");
+	if (reuseport &&
+	    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0)
+		bail("setsockopt SO_REUSEPORT");
+	if (bind(fd, (struct sockaddr *)&ss, len) < 0)
+		bail("bind");
+	if (listen(fd, 1024) < 0)
+		bail("listen");
+	return fd;
+}
+
+/* interrupt blocking system calls on SIGTERM instead of restarting them */
+static void catch_sigterm(void)
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop;
+	sigaction(SIGTERM, &sa, NULL);
+}
+
+static void worker(int id, int fd, int ready)
+{
+	int conn;
+
+	catch_sigterm();
+	if (fd < 0)
+		fd = listen_socket(1);
+	if (write(ready, "", 1) != 1)
+		bail("write");
+
+	while (!done) {
+		conn = accept(fd, NULL, NULL);
+		if (conn < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			bail("accept");
+		}
+		close(conn);
+		accepts[id]++;
+	}
+	exit(0);
+}
+
+static void client(void)
+{
+	struct sockaddr_storage ss;
+	socklen_t len = loopback_addr(&ss);
+	/* reset instead of going through TIME_WAIT, not to run out of ports */
+	struct linger lin = { .l_onoff = 1, .l_linger = 0 };
+	int fd;
+
+	catch_sigterm();
+	while (!done) {
+		fd = socket(family, SOCK_STREAM, 0);
+		if (fd < 0)
+			bail("socket");
+		setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+		if (connect(fd, (struct sockaddr *)&ss, len) < 0 &&
+		    errno != EINTR && errno != ECONNREFUSED &&
+		    errno != EADDRNOTAVAIL)
+			bail("connect");
+		close(fd);
+	}
+	exit(0);
+}
+
+static void kill_all(pid_t *pids, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		kill(pids[i], SIGTERM);
+	for (i = 0; i < n; i++)
+		waitpid(pids[i], NULL, 0);
+}
+
+static void run(int workers)
+{
+	pid_t wpids[MAX_WORKERS], *cpids;
+	unsigned long start[MAX_WORKERS], n, total = 0, min = ~0UL, max = 0;
+	struct timeval t0, t1;
+	double elapsed;
+	int fd = -1, ready[2];
+	char c;
+	int i;
+
+	cpids = calloc(nr_clients, sizeof(*cpids));
+	if (!cpids)
+		bail("calloc");
+	if (pipe(ready) < 0)
+		bail("pipe");
+	if (shared)
+		fd = listen_socket(0);
+
+	for (i = 0; i < workers; i++) {
+		accepts[i] = 0;
+		wpids[i] = fork();
+		if (wpids[i] < 0)
+			bail("fork");
+		if (!wpids[i])
+			worker(i, fd, ready[1]);
+	}
+	for (i = 0; i < workers; i++)
+		if (read(ready[0], &c, 1) != 1)
+			bail("read");
+	if (fd >= 0)
+		close(fd);
+
+	for (i = 0; i < nr_clients; i++) {
+		cpids[i] = fork();
+		if (cpids[i] < 0)
+			bail("fork");
+		if (!cpids[i])
+			client();
+	}
+
+	/* let the clients get going before measuring */
+	sleep(1);
+	gettimeofday(&t0, NULL);
+	for (i = 0; i < workers; i++)
+		start[i] = accepts[i];
+	sleep(seconds);
+	gettimeofday(&t1, NULL);
+	for (i = 0; i < workers; i++) {
+		n = accepts[i] - start[i];
+		total += n;
+		if (n < min)
+			min = n;
+		if (n > max)
+			max = n;
+	}
+
+	kill_all(cpids, nr_clients);
+	kill_all(wpids, workers);
+	close(ready[0]);
+	close(ready[1]);
+	free(cpids);
+
+	elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1e6;
+	printf("%7d %12.0f %11.1f%% %11.1f%%\n", workers, total / elapsed,
+	       total ? 100.0 * min / total : 0.0,
+	       total ? 100.0 * max / total : 0.0);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, workers;
+
+	while ((opt = getopt(argc, argv, "s6p:w:c:t:")) != -1) {
+		switch (opt) {
+		case 's':
+			shared = 1;
+			break;
+		case '6':
+			family = AF_INET6;
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'w':
+			max_workers = atoi(optarg);
+			break;
+		case 'c':
+			nr_clients = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!max_workers)
+		max_workers = 2 * sysconf(_SC_NPROCESSORS_ONLN);
+	if (max_workers > MAX_WORKERS)
+		max_workers = MAX_WORKERS;
+	if (max_workers < 1 || nr_clients < 1 || seconds < 1)
+		usage(argv[0]);
+
+	accepts = mmap(NULL, MAX_WORKERS * sizeof(*accepts),
+		       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (accepts == MAP_FAILED)
+		bail("mmap");
+
+	printf("%s, %s loopback port %d, %d clients, %d seconds per run\n",
+	       shared ? "shared listening socket" : "SO_REUSEPORT",
+	       family == AF_INET6 ? "IPv6" : "IPv4", port, nr_clients,
+	       seconds);
+	printf("workers  accepts/sec  min/worker  max/worker\n");
+	/* don't let the children inherit buffered output */
+	fflush(stdout);
+
+	for (workers = 1; workers <= max_workers; workers *= 2)
+		run(workers);
+	if (workers / 2 != max_workers)
+		run(max_workers);
+
+	return 0;
+}
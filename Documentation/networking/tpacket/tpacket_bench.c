@@ -0,0 +1,311 @@
+/*
+ * AF_PACKET receive ring benchmark
+ *
+ * Captures from an interface through a TPACKET_V2 frame ring or a
+ * TPACKET_V3 block ring while, optionally, a number of child processes
+ * flood the loopback interface with small UDP datagrams.  At the end it
+ * prints how many packets were captured and dropped, and how often the
+ * capture process had to be woken up to get them:
+ *
+ *	tpacket_bench [-v 2|3] [-i ifname] [-t seconds] [-f flooders]
+ *		      [-l payload_len] [-b block_size] [-n block_nr]
+ *		      [-s frame_size] [-T retire_tmo_msec]
+ *
+ * The defaults capture on lo with a 4 MB ring.  Note that on lo every
+ * datagram is seen twice, once on the way out and once on the way in.
+ * Needs CAP_NET_RAW.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+
+#define MAX_FLOODERS	64
+#define FLOOD_PORT	9999
+
+static int version = TPACKET_V3;
+static const char *ifname = "lo";
+static int seconds = 5;
+static int nr_flooders = 2;
+static int payload_len = 64;
+static unsigned int block_size = 1 << 18;
+static unsigned int block_nr = 16;
+static unsigned int frame_size = 2048;
+static unsigned int retire_tmo = 60;
+
+static volatile sig_atomic_t done;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-v 2|3] [-i ifname] [-t seconds] [-f flooders]\n"
+		"       [-l payload_len] [-b block_size] [-n block_nr]\n"
+		"       [-s frame_size] [-T retire_tmo_msec]\n", prog);
+	exit(1);
+}
+
+static void bail(const char *error)
+{
+	perror(error);
+	exit(1);
+}
+
+static void stop(int sig)
+{
+	done = 1;
+}
+
+/* send datagrams to a socket that never reads them, until killed */
+static void flood(void)
+{
+	struct sockaddr_in sin;
+	char buf[65536];
+	int rcvbuf = 4096;
+	int rx, tx;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(FLOOD_PORT);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	/* the sink is shared between all flooders, only one needs to bind */
+	rx = socket(AF_INET, SOCK_DGRAM, 0);
+	setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	bind(rx, (struct sockaddr *)&sin, sizeof(sin));
+
+	tx = socket(AF_INET, SOCK_DGRAM, 0);
+	if (tx < 0)
+		bail("socket");
+	memset(buf, 0x5a, payload_len);
+	for (;;)
+		sendto(tx, buf, payload_len, 0, (struct sockaddr *)&sin,
+		       sizeof(sin));
+}
+
+static int setup_socket(void **ring, size_t *ring_len)
+{
+	struct sockaddr_ll sll;
+	union {
+		struct tpacket_req req;
+		struct tpacket_req3 req3;
+	} r;
+	int fd, v = version;
+
+	fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+	if (fd < 0)
+		bail("socket AF_PACKET");
+	if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &v, sizeof(v)) < 0)
+		bail("setsockopt PACKET_VERSION");
+
+	memset(&r, 0, sizeof(r));
+	r.req.tp_block_size = block_size;
+	r.req.tp_block_nr = block_nr;
+	r.req.tp_frame_size = frame_size;
+	r.req.tp_frame_nr = block_size / frame_size * block_nr;
+	if (version == TPACKET_V3) {
+		r.req3.tp_retire_blk_tov = retire_tmo;
+		r.req3.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+	}
+	if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &r,
+		       version == TPACKET_V3 ? sizeof(r.req3) : sizeof(r.req)) < 0)
+		bail("setsockopt PACKET_RX_RING");
+
+	*ring_len = (size_t)block_size * block_nr;
+	*ring = mmap(NULL, *ring_len, PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_LOCKED, fd, 0);
+	if (*ring == MAP_FAILED)
+		bail("mmap");
+
+	memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = htons(ETH_P_ALL);
+	sll.sll_ifindex = if_nametoindex(ifname);
+	if (!sll.sll_ifindex)
+		bail(ifname);
+	if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0)
+		bail("bind");
+
+	return fd;
+}
+
+struct counts {
+	unsigned long long packets, bytes, wakeups, blocks;
+};
+
+static void walk_v2(void *ring, struct counts *c, unsigned int *pos)
+{
+	unsigned int frame_nr = block_size / frame_size * block_nr;
+	unsigned int per_block = block_size / frame_size;
+	struct tpacket2_hdr *h;
+
+	for (;;) {
+		h = ring + (*pos / per_block) * block_size +
+		    (*pos % per_block) * frame_size;
+		if (!(h->tp_status & TP_STATUS_USER))
+			return;
+		c->packets++;
+		c->bytes += h->tp_len;
+		__sync_synchronize();
+		h->tp_status = TP_STATUS_KERNEL;
+		*pos = (*pos + 1) % frame_nr;
+	}
+}
+
+static void walk_v3(void *ring, struct counts *c, unsigned int *pos)
+{
+	struct tpacket_block_desc *bd;
+	struct tpacket3_hdr *h;
+	unsigned int i;
+
+	for (;;) {
+		bd = ring + (size_t)*pos * block_size;
+		if (!(bd->hdr.bh1.block_status & TP_STATUS_USER))
+			return;
+		h = (void *)bd + bd->hdr.bh1.offset_to_first_pkt;
+		for (i = 0; i < bd->hdr.bh1.num_pkts; i++) {
+			c->bytes += h->tp_len;
+			h = (void *)h + h->tp_next_offset;
+		}
+		c->packets += bd->hdr.bh1.num_pkts;
+		c->blocks++;
+		__sync_synchronize();
+		bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+		*pos = (*pos + 1) % block_nr;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	pid_t flooders[MAX_FLOODERS];
+	struct tpacket_stats_v3 st;
+	socklen_t st_len = sizeof(st);
+	struct counts c = { 0 };
+	struct timeval t0, t1;
+	struct pollfd pfd;
+	unsigned int pos = 0;
+	size_t ring_len;
+	double elapsed;
+	void *ring;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "v:i:t:f:l:b:n:s:T:")) != -1) {
+		switch (opt) {
+		case 'v':
+			version = atoi(optarg) == 2 ? TPACKET_V2 : TPACKET_V3;
+			break;
+		case 'i':
+			ifname = optarg;
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'f':
+			nr_flooders = atoi(optarg);
+			break;
+		case 'l':
+			payload_len = atoi(optarg);
+			break;
+		case 'b':
+			block_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			block_nr = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			frame_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'T':
+			retire_tmo = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (seconds < 1 || nr_flooders < 0 || nr_flooders > MAX_FLOODERS ||
+	    payload_len < 0 || payload_len > 65000 ||
+	    !block_size || !block_nr || !frame_size)
+		usage(argv[0]);
+
+	pfd.fd = setup_socket(&ring, &ring_len);
+	pfd.events = POLLIN | POLLERR;
+
+	printf("TPACKET_V%d on %s, %u blocks of %u bytes", version + 1,
+	       ifname, block_nr, block_size);
+	if (version == TPACKET_V3)
+		printf(", retire timeout %u ms", retire_tmo);
+	else
+		printf(", %u byte frames", frame_size);
+	printf(", %d flooders, %d byte payload\n", nr_flooders, payload_len);
+	/* don't let the children inherit buffered output */
+	fflush(stdout);
+
+	for (i = 0; i < nr_flooders; i++) {
+		flooders[i] = fork();
+		if (flooders[i] < 0)
+			bail("fork");
+		if (!flooders[i])
+			flood();
+	}
+
+	signal(SIGALRM, stop);
+	alarm(seconds);
+	gettimeofday(&t0, NULL);
+	while (!done) {
+		if (version == TPACKET_V3)
+			walk_v3(ring, &c, &pos);
+		else
+			walk_v2(ring, &c, &pos);
+		if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+			bail("poll");
+		c.wakeups++;
+	}
+	gettimeofday(&t1, NULL);
+
+	for (i = 0; i < nr_flooders; i++)
+		kill(flooders[i], SIGKILL);
+	for (i = 0; i < nr_flooders; i++)
+		waitpid(flooders[i], NULL, 0);
+
+	memset(&st, 0, sizeof(st));
+	if (getsockopt(pfd.fd, SOL_PACKET, PACKET_STATISTICS, &st, &st_len) < 0)
+		bail("getsockopt PACKET_STATISTICS");
+
+	elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1e6;
+	printf("captured   %12.0f packets/s %10.1f MB/s\n",
+	       c.packets / elapsed, c.bytes / elapsed / 1e6);
+	printf("dropped    %12u packets", st.tp_drops);
+	if (version == TPACKET_V3)
+		printf(", queue frozen %u times", st.tp_freeze_q_cnt);
+	printf("\n");
+	printf("wakeups    %12.0f /s, %.1f packets per wakeup\n",
+	       c.wakeups / elapsed,
+	       c.wakeups ? (double)c.packets / c.wakeups : 0.0);
+	if (version == TPACKET_V3)
+		printf("blocks     %12.0f /s, %.1f packets per block\n",
+		       c.blocks / elapsed,
+		       c.blocks ? (double)c.packets / c.blocks : 0.0);
+
+	munmap(ring, ring_len);
+	close(pfd.fd);
+	return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef _ARM_CRYPTO_SHA_H
+#define _ARM_CRYPTO_SHA_H
+
+#include <crypto/hash.h>
+
+/*
+ * Scalar update routines of the sha1-arm and sha256-arm modules.  The NEON
+ * drivers fall back to these when they are called from a context in which
+ * the NEON unit cannot be used.
+ */
+extern int sha1_update_arm(struct shash_desc *desc, const u8 *data,
+			   unsigned int len);
+extern int sha256_update_arm(struct shash_desc *desc, const u8 *data,
+			     unsigned int len);
+
+#endif /* _ARM_CRYPTO_SHA_H */
@@ -0,0 +1,35 @@
+/*
+ * linux/arch/arm/include/asm/neon.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+#ifdef __ARM_NEON__
+/*
+ * The NEON code must live in a separate compilation unit (normally an
+ * assembler file): GCC is free to allocate NEON registers in any code
+ * built with NEON enabled, including outside kernel_neon_begin/end.
+ */
+#error "kernel_neon_begin() must not be called from NEON-enabled C code"
+#endif
+
+/*
+ * kernel_neon_begin() and kernel_neon_end() bracket any use of the NEON
+ * register file by kernel code.  The register contents belonging to
+ * whichever task currently owns the VFP/NEON unit are saved first, and
+ * preemption stays disabled until kernel_neon_end() is called.  They may
+ * only be used in process context.
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+
+#endif /* __ASM_ARM_NEON_H */
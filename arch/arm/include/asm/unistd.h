@@ -402,6 +402,7 @@
 #define __NR_syncfs			(__NR_SYSCALL_BASE+373)
 #define __NR_sendmmsg			(__NR_SYSCALL_BASE+374)
 #define __NR_setns			(__NR_SYSCALL_BASE+375)
+#define __NR_epoll_ctl_batch		(__NR_SYSCALL_BASE+376)
 
 /*
  * The following SWIs are ARM private.
@@ -0,0 +1,179 @@
+/*
+ *  linux/arch/arm/lib/copy_neon_glue.c
+ *
+ *  Use NEON for copy_page(), __copy_to_user() and __copy_from_user()
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Large copies are done with 64 byte NEON loads and stores instead of
+ * the integer LDM/STM loops, which is significantly faster on ARMv7
+ * cores whose NEON unit has a wider path to the L1 cache.
+ *
+ * The NEON code is only used on CPUs that have it (this is decided once
+ * at boot, after the VFP support code has probed the hardware) and only
+ * outside of interrupt context, as required by kernel_neon_begin().
+ * Since preemption is disabled while the NEON unit is in use, user
+ * accesses are done with page faults disabled: whenever the NEON loop
+ * hits a fault, the standard code is used to copy up to the end of the
+ * faulting page, which may sleep to fault the page in or report a
+ * genuine fault, after which the NEON loop takes over again.
+ */
+
+#include <linux/kernel.h>
+#include <linux/hardirq.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/moduleparam.h>
+#include <linux/uaccess.h>
+#include <asm/neon.h>
+#include <asm/page.h>
+
+/*
+ * Below this size, saving the user NEON state and the fault handling
+ * setup cost more than they buy.
+ */
+#define NEON_COPY_THRESHOLD	256
+
+/*
+ * Preemption is disabled while the NEON unit is in use, so don't keep
+ * it for more than this many bytes at a time.
+ */
+#define NEON_COPY_MAX_BURST	(4 * PAGE_SIZE)
+
+extern void copy_page_neon(void *to, const void *from);
+extern void __copy_page_std(void *to, const void *from);
+extern unsigned long __copy_to_user_neon(void __user *to, const void *from,
+					 unsigned long n);
+extern unsigned long __copy_from_user_neon(void *to, const void __user *from,
+					   unsigned long n);
+
+/* set once the CPU is known to have NEON */
+static bool neon_copy_usable __read_mostly;
+
+/* can be cleared on the command line or at run time to compare */
+static bool neon_copy = true;
+core_param(neon_copy, neon_copy, bool, 0644);
+
+static inline bool neon_copy_ok(void)
+{
+	return neon_copy_usable && neon_copy && !in_interrupt();
+}
+
+void copy_page(void *to, const void *from)
+{
+	if (!neon_copy_ok()) {
+		__copy_page_std(to, from);
+		return;
+	}
+
+	kernel_neon_begin();
+	copy_page_neon(to, from);
+	kernel_neon_end();
+}
+
+static unsigned long noinline
+__copy_to_user_neon_loop(void __user *to, const void *from, unsigned long n)
+{
+	while (n >= NEON_COPY_THRESHOLD) {
+		unsigned long chunk, left;
+
+		chunk = min_t(unsigned long, n, NEON_COPY_MAX_BURST) & ~63UL;
+
+		kernel_neon_begin();
+		pagefault_disable();
+		left = __copy_to_user_neon(to, from, chunk);
+		pagefault_enable();
+		kernel_neon_end();
+
+		chunk -= left;
+		to += chunk;
+		from += chunk;
+		n -= chunk;
+
+		if (left) {
+			/* fault the page in, or find out that we can't */
+			chunk = min_t(unsigned long, n,
+				      PAGE_SIZE - offset_in_page(to));
+			left = __copy_to_user_std(to, from, chunk);
+			if (left)
+				return n - chunk + left;
+			to += chunk;
+			from += chunk;
+			n -= chunk;
+		}
+	}
+
+	return n ? __copy_to_user_std(to, from, n) : 0;
+}
+
+unsigned long
+__copy_to_user(void __user *to, const void *from, unsigned long n)
+{
+	/*
+	 * As in uaccess_with_memcpy.c, keep the test for small copies
+	 * separate from the main function to avoid its setup cost.
+	 */
+	if (n < NEON_COPY_THRESHOLD || !neon_copy_ok())
+		return __copy_to_user_std(to, from, n);
+	return __copy_to_user_neon_loop(to, from, n);
+}
+
+static unsigned long noinline
+__copy_from_user_neon_loop(void *to, const void __user *from, unsigned long n)
+{
+	while (n >= NEON_COPY_THRESHOLD) {
+		unsigned long chunk, left;
+
+		chunk = min_t(unsigned long, n, NEON_COPY_MAX_BURST) & ~63UL;
+
+		kernel_neon_begin();
+		pagefault_disable();
+		left = __copy_from_user_neon(to, from, chunk);
+		pagefault_enable();
+		kernel_neon_end();
+
+		chunk -= left;
+		to += chunk;
+		from += chunk;
+		n -= chunk;
+
+		if (left) {
+			chunk = min_t(unsigned long, n,
+				      PAGE_SIZE - offset_in_page(from));
+			left = __copy_from_user_std(to, from, chunk);
+			if (left) {
+				/*
+				 * The standard code cleared the rest of its
+				 * chunk, clear whatever is beyond it too.
+				 */
+				memset(to + chunk, 0, n - chunk);
+				return n - chunk + left;
+			}
+			to += chunk;
+			from += chunk;
+			n -= chunk;
+		}
+	}
+
+	return n ? __copy_from_user_std(to, from, n) : 0;
+}
+
+unsigned long
+__copy_from_user(void *to, const void __user *from, unsigned long n)
+{
+	if (n < NEON_COPY_THRESHOLD || !neon_copy_ok())
+		return __copy_from_user_std(to, from, n);
+	return __copy_from_user_neon_loop(to, from, n);
+}
+
+static int __init neon_copy_init(void)
+{
+	if (cpu_has_neon()) {
+		neon_copy_usable = true;
+		pr_info("Using NEON for page and user copies\n");
+	}
+	return 0;
+}
+arch_initcall(neon_copy_init);
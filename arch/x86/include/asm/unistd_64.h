@@ -683,6 +683,8 @@ __SYSCALL(__NR_sendmmsg, sys_sendmmsg)
 __SYSCALL(__NR_setns, sys_setns)
 #define __NR_getcpu				309
 __SYSCALL(__NR_getcpu, sys_getcpu)
+#define __NR_epoll_ctl_batch			310
+__SYSCALL(__NR_epoll_ctl_batch, sys_epoll_ctl_batch)
 
 #ifndef __NO_STUBS
 #define __ARCH_WANT_OLD_READDIR
@@ -0,0 +1,126 @@
+/*
+ * Tag allocation for the multi-queue block layer.
+ *
+ * A tag is a bit in a bitmap, one bitmap per hardware queue, and names
+ * one of the requests preallocated for that queue.  Each CPU starts its
+ * search after the last tag it got, which spreads the CPUs over the
+ * bitmap instead of having all of them fight over its first word.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
+#include <linux/bitops.h>
+
+#include <linux/blk-mq.h>
+#include "blk-mq.h"
+
+struct blk_mq_tags {
+	unsigned int		nr_tags;
+	unsigned int __percpu	*hint;
+	wait_queue_head_t	wait;
+	unsigned long		map[];
+};
+
+static unsigned int __blk_mq_get_tag(struct blk_mq_tags *tags)
+{
+	unsigned int *hint, start, tag;
+
+	hint = get_cpu_ptr(tags->hint);
+	start = *hint;
+	if (start >= tags->nr_tags)
+		start = 0;
+
+	tag = start;
+	do {
+		tag = find_next_zero_bit(tags->map, tags->nr_tags, tag);
+		if (tag >= tags->nr_tags) {
+			/* wrap around once, up to where we started */
+			if (!start)
+				break;
+			tag = find_first_zero_bit(tags->map, start);
+			if (tag >= start)
+				break;
+			start = 0;
+		}
+		if (!test_and_set_bit_lock(tag, tags->map)) {
+			*hint = tag + 1;
+			put_cpu_ptr(tags->hint);
+			return tag;
+		}
+	} while (1);
+
+	put_cpu_ptr(tags->hint);
+	return BLK_MQ_TAG_FAIL;
+}
+
+/*
+ * Get a free tag.  Without __GFP_WAIT in @gfp this fails right away when
+ * all of them are in use, otherwise it sleeps until one is put back.
+ */
+unsigned int blk_mq_get_tag(struct blk_mq_tags *tags, gfp_t gfp)
+{
+	unsigned int tag;
+	DEFINE_WAIT(wait);
+
+	tag = __blk_mq_get_tag(tags);
+	if (tag != BLK_MQ_TAG_FAIL || !(gfp & __GFP_WAIT))
+		return tag;
+
+	do {
+		prepare_to_wait_exclusive(&tags->wait, &wait,
+					  TASK_UNINTERRUPTIBLE);
+		tag = __blk_mq_get_tag(tags);
+		if (tag != BLK_MQ_TAG_FAIL)
+			break;
+		/* this also flushes any requests we have plugged */
+		io_schedule();
+	} while (1);
+	finish_wait(&tags->wait, &wait);
+
+	return tag;
+}
+
+void blk_mq_put_tag(struct blk_mq_tags *tags, unsigned int tag)
+{
+	BUG_ON(tag >= tags->nr_tags);
+
+	clear_bit_unlock(tag, tags->map);
+	smp_mb__after_clear_bit();
+	if (waitqueue_active(&tags->wait))
+		wake_up(&tags->wait);
+}
+
+bool blk_mq_tags_busy(struct blk_mq_tags *tags)
+{
+	return find_first_bit(tags->map, tags->nr_tags) < tags->nr_tags;
+}
+
+struct blk_mq_tags *blk_mq_init_tags(unsigned int nr_tags, int node)
+{
+	struct blk_mq_tags *tags;
+
+	tags = kzalloc_node(sizeof(*tags) +
+			    BITS_TO_LONGS(nr_tags) * sizeof(unsigned long),
+			    GFP_KERNEL, node);
+	if (!tags)
+		return NULL;
+
+	tags->hint = alloc_percpu(unsigned int);
+	if (!tags->hint) {
+		kfree(tags);
+		return NULL;
+	}
+
+	tags->nr_tags = nr_tags;
+	init_waitqueue_head(&tags->wait);
+	return tags;
+}
+
+void blk_mq_free_tags(struct blk_mq_tags *tags)
+{
+	free_percpu(tags->hint);
+	kfree(tags);
+}
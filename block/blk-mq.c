@@ -0,0 +1,835 @@
+/*
+ * Block multi-queue core code
+ *
+ * Bios are turned into requests on the submitting CPU and staged on that
+ * CPU's software queue (struct blk_mq_ctx).  Running a hardware queue
+ * pulls the requests off every software queue mapped to it and hands
+ * them to the driver's ->queue_rq().  The queue_lock is never taken on
+ * this path, and the only shared state is the hardware queue itself, so
+ * devices with one hardware queue per CPU (or per few CPUs) never bounce
+ * a lock between CPUs.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/delay.h>
+#include <linux/smp.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
+#include <linux/writeback.h>
+#include <linux/completion.h>
+#include <linux/blk-mq.h>
+
+#include <trace/events/block.h>
+
+#include "blk.h"
+#include "blk-mq.h"
+
+static struct blk_mq_ctx *__blk_mq_get_ctx(struct request_queue *q,
+					   unsigned int cpu)
+{
+	return per_cpu_ptr(q->queue_ctx, cpu);
+}
+
+/*
+ * This assumes per-cpu software queueing queues. They could be per-node
+ * as well, for instance. For now this is hardcoded as-is. Note that we don't
+ * care about preemption, since we know the ctx's are persistent. This does
+ * mean that we can't rely on ctx always matching the currently running CPU.
+ */
+static struct blk_mq_ctx *blk_mq_get_ctx(struct request_queue *q)
+{
+	return __blk_mq_get_ctx(q, get_cpu());
+}
+
+static void blk_mq_put_ctx(struct blk_mq_ctx *ctx)
+{
+	put_cpu();
+}
+
+struct blk_mq_hw_ctx *blk_mq_map_queue(struct request_queue *q, const int cpu)
+{
+	return q->queue_hw_ctx[q->mq_map[cpu]];
+}
+EXPORT_SYMBOL(blk_mq_map_queue);
+
+void blk_mq_map_queues(unsigned int *map, unsigned int nr_queues)
+{
+	unsigned int nr_cpus = num_possible_cpus();
+	unsigned int cpu, i = 0;
+
+	/* neighbouring CPUs share a queue, they are likely to share caches */
+	for_each_possible_cpu(cpu)
+		map[cpu] = i++ * nr_queues / nr_cpus;
+}
+
+static struct blk_mq_hw_ctx *blk_mq_rq_hctx(struct request *rq)
+{
+	return rq->q->mq_ops->map_queue(rq->q, rq->mq_ctx->cpu);
+}
+
+/*
+ * Check if any of the ctx's have pending work in this hardware queue
+ */
+static bool blk_mq_hctx_has_pending(struct blk_mq_hw_ctx *hctx)
+{
+	return !list_empty_careful(&hctx->dispatch) ||
+		find_first_bit(hctx->ctx_map, hctx->nr_ctx) < hctx->nr_ctx;
+}
+
+/*
+ * Mark this ctx as having pending work in this hardware queue
+ */
+static void blk_mq_hctx_mark_pending(struct blk_mq_hw_ctx *hctx,
+				     struct blk_mq_ctx *ctx)
+{
+	if (!test_bit(ctx->index_hw, hctx->ctx_map))
+		set_bit(ctx->index_hw, hctx->ctx_map);
+}
+
+struct request *blk_mq_tag_to_rq(struct blk_mq_hw_ctx *hctx, unsigned int tag)
+{
+	return hctx->rqs[tag];
+}
+EXPORT_SYMBOL(blk_mq_tag_to_rq);
+
+static struct request *__blk_mq_alloc_request(struct blk_mq_hw_ctx *hctx,
+					      struct blk_mq_ctx *ctx,
+					      int rw, gfp_t gfp)
+{
+	struct request_queue *q = hctx->queue;
+	struct request *rq;
+	unsigned int tag;
+
+	tag = blk_mq_get_tag(hctx->tags, gfp);
+	if (tag == BLK_MQ_TAG_FAIL)
+		return NULL;
+
+	rq = hctx->rqs[tag];
+	blk_rq_init(q, rq);
+	rq->tag = tag;
+	rq->mq_ctx = ctx;
+	rq->cmd_flags = rw;
+	if (blk_queue_io_stat(q))
+		rq->cmd_flags |= REQ_IO_STAT;
+
+	return rq;
+}
+
+static struct request *blk_mq_get_request(struct request_queue *q, int rw,
+					  gfp_t gfp)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+
+	ctx = blk_mq_get_ctx(q);
+	hctx = q->mq_ops->map_queue(q, ctx->cpu);
+	rq = __blk_mq_alloc_request(hctx, ctx, rw, gfp & ~__GFP_WAIT);
+	blk_mq_put_ctx(ctx);
+
+	if (rq || !(gfp & __GFP_WAIT))
+		return rq;
+
+	/*
+	 * All tags of this CPU's hardware queue are in use.  Sleep for one
+	 * on whatever CPU we are on now, we may get migrated meanwhile but
+	 * the ctx stays valid.
+	 */
+	ctx = __blk_mq_get_ctx(q, raw_smp_processor_id());
+	hctx = q->mq_ops->map_queue(q, ctx->cpu);
+	return __blk_mq_alloc_request(hctx, ctx, rw, gfp);
+}
+
+/**
+ * blk_mq_alloc_request - allocate a request on a multi-queue device
+ * @q:		the queue
+ * @rw:		READ or WRITE, plus any REQ_* flags
+ * @gfp:	allocation mask, with __GFP_WAIT this cannot fail
+ *
+ * Description:
+ *    Backs blk_get_request() for multi-queue devices.  The request comes
+ *    with a tag from the hardware queue of the current CPU.
+ */
+struct request *blk_mq_alloc_request(struct request_queue *q, int rw,
+				     gfp_t gfp)
+{
+	return blk_mq_get_request(q, rw, gfp);
+}
+EXPORT_SYMBOL(blk_mq_alloc_request);
+
+void blk_mq_free_request(struct request *rq)
+{
+	struct blk_mq_hw_ctx *hctx = blk_mq_rq_hctx(rq);
+
+	/* this is a bio leak */
+	WARN_ON(rq->bio != NULL);
+
+	rq->cmd_flags = 0;
+	blk_mq_put_tag(hctx->tags, rq->tag);
+}
+EXPORT_SYMBOL(blk_mq_free_request);
+
+/**
+ * blk_mq_end_io - complete a request on a multi-queue device
+ * @rq:		the request being completed
+ * @error:	0 for success, < 0 for error
+ *
+ * Description:
+ *    Ends all of @rq's bios and frees it, or hands it to its ->end_io
+ *    if it has one.  Can be called from any context.
+ */
+void blk_mq_end_io(struct request *rq, int error)
+{
+	if (blk_update_request(rq, error, blk_rq_bytes(rq)))
+		BUG();
+
+	if (unlikely(laptop_mode) && rq->cmd_type == REQ_TYPE_FS)
+		laptop_io_completion(&rq->q->backing_dev_info);
+
+	blk_account_io_done(rq);
+
+	if (rq->end_io)
+		rq->end_io(rq, error);
+	else
+		blk_mq_free_request(rq);
+}
+EXPORT_SYMBOL(blk_mq_end_io);
+
+static void blk_mq_start_request(struct request *rq)
+{
+	trace_block_rq_issue(rq->q, rq);
+
+	rq->cmd_flags |= REQ_STARTED;
+	rq->resid_len = blk_rq_bytes(rq);
+}
+
+static void blk_mq_requeue_request(struct request *rq)
+{
+	trace_block_rq_requeue(rq->q, rq);
+
+	rq->cmd_flags &= ~REQ_STARTED;
+}
+
+static void __blk_mq_insert_request(struct blk_mq_hw_ctx *hctx,
+				    struct request *rq, bool at_head)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+
+	trace_block_rq_insert(hctx->queue, rq);
+
+	spin_lock(&ctx->lock);
+	if (at_head)
+		list_add(&rq->queuelist, &ctx->rq_list);
+	else
+		list_add_tail(&rq->queuelist, &ctx->rq_list);
+	blk_mq_hctx_mark_pending(hctx, ctx);
+	spin_unlock(&ctx->lock);
+}
+
+/*
+ * Run this hardware queue, pulling any software queues mapped to it in.
+ * Note that this function currently has various problems around ordering
+ * of IO. In particular, we'd like FIFO behaviour on handling existing
+ * items on the hctx->dispatch list. Ignore that for now.
+ */
+static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	struct request_queue *q = hctx->queue;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+	LIST_HEAD(rq_list);
+	int bit, ret;
+
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	/*
+	 * Touch any software queue that has pending entries.  The bit is
+	 * cleared before the list is emptied, so a request queued meanwhile
+	 * sets it again and gets picked up by the next run.
+	 */
+	for_each_set_bit(bit, hctx->ctx_map, hctx->nr_ctx) {
+		clear_bit(bit, hctx->ctx_map);
+		ctx = hctx->ctxs[bit];
+
+		spin_lock(&ctx->lock);
+		list_splice_tail_init(&ctx->rq_list, &rq_list);
+		spin_unlock(&ctx->lock);
+	}
+
+	/*
+	 * If we have previous entries on our dispatch list, grab them
+	 * and stuff them at the front for more fair dispatch.
+	 */
+	if (!list_empty_careful(&hctx->dispatch)) {
+		spin_lock(&hctx->lock);
+		list_splice_init(&hctx->dispatch, &rq_list);
+		spin_unlock(&hctx->lock);
+	}
+
+	/*
+	 * Now process all the entries, sending them to the driver.
+	 */
+	while (!list_empty(&rq_list)) {
+		rq = list_first_entry(&rq_list, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+
+		blk_mq_start_request(rq);
+
+		ret = q->mq_ops->queue_rq(hctx, rq, list_empty(&rq_list));
+		if (ret == BLK_MQ_RQ_QUEUE_OK)
+			continue;
+
+		if (ret == BLK_MQ_RQ_QUEUE_BUSY) {
+			/* the driver is out of room, retry on the next run */
+			blk_mq_requeue_request(rq);
+			list_add(&rq->queuelist, &rq_list);
+			break;
+		}
+
+		if (ret != BLK_MQ_RQ_QUEUE_ERROR)
+			pr_err("blk-mq: bad return on queue: %d\n", ret);
+		rq->errors = -EIO;
+		blk_mq_end_io(rq, rq->errors);
+	}
+
+	/*
+	 * Any items that need requeuing? Stuff them into hctx->dispatch,
+	 * that is where we will continue on next queue run.
+	 */
+	if (!list_empty(&rq_list)) {
+		spin_lock(&hctx->lock);
+		list_splice(&rq_list, &hctx->dispatch);
+		spin_unlock(&hctx->lock);
+	}
+}
+
+static void blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx, bool async)
+{
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	if (!async)
+		__blk_mq_run_hw_queue(hctx);
+	else
+		kblockd_schedule_delayed_work(hctx->queue, &hctx->run_work, 0);
+}
+
+void blk_mq_run_queues(struct request_queue *q, bool async)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!blk_mq_hctx_has_pending(hctx))
+			continue;
+
+		blk_mq_run_hw_queue(hctx, async);
+	}
+}
+EXPORT_SYMBOL(blk_mq_run_queues);
+
+static void blk_mq_work_fn(struct work_struct *work)
+{
+	struct blk_mq_hw_ctx *hctx;
+
+	hctx = container_of(work, struct blk_mq_hw_ctx, run_work.work);
+	__blk_mq_run_hw_queue(hctx);
+}
+
+/*
+ * Stopping a hardware queue keeps requests staged until it is started
+ * again; drivers do this when they are out of room in the hardware.
+ */
+void blk_mq_stop_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	cancel_delayed_work(&hctx->run_work);
+	set_bit(BLK_MQ_S_STOPPED, &hctx->state);
+}
+EXPORT_SYMBOL(blk_mq_stop_hw_queue);
+
+void blk_mq_start_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	clear_bit(BLK_MQ_S_STOPPED, &hctx->state);
+	__blk_mq_run_hw_queue(hctx);
+}
+EXPORT_SYMBOL(blk_mq_start_hw_queue);
+
+void blk_mq_stop_hw_queues(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i)
+		blk_mq_stop_hw_queue(hctx);
+}
+EXPORT_SYMBOL(blk_mq_stop_hw_queues);
+
+/*
+ * Restart the stopped hardware queues.  From interrupt context @async
+ * must be set, the queues are then run from kblockd.
+ */
+void blk_mq_start_stopped_hw_queues(struct request_queue *q, bool async)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!test_bit(BLK_MQ_S_STOPPED, &hctx->state))
+			continue;
+
+		clear_bit(BLK_MQ_S_STOPPED, &hctx->state);
+		blk_mq_run_hw_queue(hctx, async);
+	}
+}
+EXPORT_SYMBOL(blk_mq_start_stopped_hw_queues);
+
+/**
+ * blk_mq_insert_request - queue a prepared request on a multi-queue device
+ * @rq:		the request, from blk_mq_alloc_request()
+ * @at_head:	queue it in front of the staged requests
+ * @run_queue:	run the hardware queue right away
+ * @async:	run it from kblockd rather than the caller's context
+ */
+void blk_mq_insert_request(struct request *rq, bool at_head, bool run_queue,
+			   bool async)
+{
+	struct blk_mq_hw_ctx *hctx = blk_mq_rq_hctx(rq);
+
+	__blk_mq_insert_request(hctx, rq, at_head);
+
+	if (run_queue)
+		blk_mq_run_hw_queue(hctx, async);
+}
+EXPORT_SYMBOL(blk_mq_insert_request);
+
+void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule)
+{
+	struct blk_mq_hw_ctx *hctx, *next_hctx;
+	struct request *rq;
+	unsigned int depth = 0;
+	LIST_HEAD(list);
+
+	list_splice_init(&plug->mq_list, &list);
+
+	/*
+	 * Stage the requests, and run each hardware queue once after its
+	 * run of requests.  If we are called from schedule(), punt the
+	 * dispatch to kblockd to keep driver code off this stack.
+	 */
+	while (!list_empty(&list)) {
+		rq = list_entry_rq(list.next);
+		list_del_init(&rq->queuelist);
+		hctx = blk_mq_rq_hctx(rq);
+		__blk_mq_insert_request(hctx, rq, false);
+		depth++;
+
+		next_hctx = NULL;
+		if (!list_empty(&list))
+			next_hctx = blk_mq_rq_hctx(list_entry_rq(list.next));
+		if (next_hctx != hctx) {
+			trace_block_unplug(hctx->queue, depth, !from_schedule);
+			blk_mq_run_hw_queue(hctx, from_schedule);
+			depth = 0;
+		}
+	}
+}
+
+struct blk_mq_wait {
+	struct completion	done;
+	int			error;
+};
+
+static void blk_mq_wait_end_io(struct request *rq, int error)
+{
+	struct blk_mq_wait *wait = rq->end_io_data;
+
+	wait->error = error;
+	blk_mq_free_request(rq);
+	complete(&wait->done);
+}
+
+static void blk_mq_wait_bio_end_io(struct bio *bio, int error)
+{
+	struct blk_mq_wait *wait = bio->bi_private;
+
+	wait->error = error;
+	complete(&wait->done);
+}
+
+static int blk_mq_issue_flush(struct request_queue *q)
+{
+	struct blk_mq_wait wait;
+	struct request *rq;
+
+	rq = blk_mq_get_request(q, WRITE_FLUSH, GFP_NOIO);
+	rq->cmd_type = REQ_TYPE_FS;
+	rq->end_io = blk_mq_wait_end_io;
+	rq->end_io_data = &wait;
+
+	init_completion(&wait.done);
+	wait.error = 0;
+	blk_mq_insert_request(rq, false, true, false);
+	wait_for_completion(&wait.done);
+
+	return wait.error;
+}
+
+/*
+ * There is no elevator to sequence flushes and FUA writes, so do it in the
+ * submitter's context: issue the preflush and wait for it, then the data,
+ * and if the device can't do FUA, wait for the data and issue a postflush.
+ */
+static void blk_mq_flush_bio(struct request_queue *q, struct bio *bio)
+{
+	bool postflush = (bio->bi_rw & REQ_FUA) && !(q->flush_flags & REQ_FUA);
+	bio_end_io_t *end_io = bio->bi_end_io;
+	void *private = bio->bi_private;
+	struct blk_mq_wait wait;
+	struct request *rq;
+	int error = 0;
+
+	if (bio->bi_rw & REQ_FLUSH)
+		error = blk_mq_issue_flush(q);
+
+	bio->bi_rw &= ~REQ_FLUSH;
+	if (postflush)
+		bio->bi_rw &= ~REQ_FUA;
+
+	if (error || !bio_has_data(bio))
+		goto out;
+
+	if (postflush) {
+		init_completion(&wait.done);
+		wait.error = 0;
+		bio->bi_end_io = blk_mq_wait_bio_end_io;
+		bio->bi_private = &wait;
+	}
+
+	rq = blk_mq_get_request(q, bio_data_dir(bio) | REQ_SYNC, GFP_NOIO);
+	init_request_from_bio(rq, bio);
+	drive_stat_acct(rq, 1);
+	blk_mq_insert_request(rq, false, true, false);
+
+	if (!postflush)
+		return;
+
+	wait_for_completion(&wait.done);
+	bio->bi_end_io = end_io;
+	bio->bi_private = private;
+
+	error = wait.error;
+	if (!error)
+		error = blk_mq_issue_flush(q);
+out:
+	bio_endio(bio, error);
+}
+
+static int blk_mq_make_request(struct request_queue *q, struct bio *bio)
+{
+	const int is_sync = rw_is_sync(bio->bi_rw);
+	unsigned int request_count = 0;
+	struct blk_plug *plug;
+	struct request *rq;
+	int rw = bio_data_dir(bio);
+
+	blk_queue_bounce(q, &bio);
+
+	if (bio->bi_rw & (REQ_FLUSH | REQ_FUA)) {
+		blk_mq_flush_bio(q, bio);
+		return 0;
+	}
+
+	if (!blk_queue_nomerges(q) &&
+	    blk_attempt_plug_merge(q, bio, &request_count))
+		return 0;
+
+	if (is_sync)
+		rw |= REQ_SYNC;
+
+	rq = blk_mq_get_request(q, rw, GFP_NOIO);
+	init_request_from_bio(rq, bio);
+	drive_stat_acct(rq, 1);
+
+	/*
+	 * If we have a plug, stage the request there so that more bios can
+	 * be merged into it and the hardware queue is run once for the
+	 * whole batch.
+	 */
+	plug = current->plug;
+	if (plug) {
+		if (list_empty(&plug->mq_list))
+			trace_block_plug(q);
+		else if (request_count >= BLK_MAX_REQUEST_COUNT)
+			blk_flush_plug_list(plug, false);
+		list_add_tail(&rq->queuelist, &plug->mq_list);
+		return 0;
+	}
+
+	blk_mq_insert_request(rq, false, true, false);
+	return 0;
+}
+
+static void blk_mq_init_cpu_queues(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_ctx *ctx;
+	unsigned int i;
+
+	for_each_possible_cpu(i) {
+		ctx = __blk_mq_get_ctx(q, i);
+		memset(ctx, 0, sizeof(*ctx));
+		spin_lock_init(&ctx->lock);
+		INIT_LIST_HEAD(&ctx->rq_list);
+		ctx->cpu = i;
+		ctx->queue = q;
+
+		hctx = q->mq_ops->map_queue(q, i);
+		cpumask_set_cpu(i, hctx->cpumask);
+		ctx->index_hw = hctx->nr_ctx;
+		hctx->ctxs[hctx->nr_ctx++] = ctx;
+	}
+}
+
+static void blk_mq_free_rqs(struct blk_mq_hw_ctx *hctx)
+{
+	unsigned int i;
+
+	if (hctx->rqs) {
+		for (i = 0; i < hctx->queue_depth; i++)
+			kfree(hctx->rqs[i]);
+		kfree(hctx->rqs);
+	}
+}
+
+static int blk_mq_alloc_rqs(struct blk_mq_hw_ctx *hctx,
+			    struct blk_mq_reg *reg)
+{
+	size_t rq_size = sizeof(struct request) + reg->cmd_size;
+	unsigned int i;
+
+	hctx->rqs = kzalloc_node(hctx->queue_depth * sizeof(struct request *),
+				 GFP_KERNEL, reg->numa_node);
+	if (!hctx->rqs)
+		return -ENOMEM;
+
+	for (i = 0; i < hctx->queue_depth; i++) {
+		hctx->rqs[i] = kzalloc_node(rq_size, GFP_KERNEL,
+					    reg->numa_node);
+		if (!hctx->rqs[i])
+			return -ENOMEM;
+	}
+
+	hctx->tags = blk_mq_init_tags(hctx->queue_depth, reg->numa_node);
+	if (!hctx->tags)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void blk_mq_free_hw_queues(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!hctx)
+			continue;
+		blk_mq_free_rqs(hctx);
+		if (hctx->tags)
+			blk_mq_free_tags(hctx->tags);
+		kfree(hctx->ctxs);
+		kfree(hctx->ctx_map);
+		free_cpumask_var(hctx->cpumask);
+		kfree(hctx);
+	}
+}
+
+static int blk_mq_init_hw_queues(struct request_queue *q,
+				 struct blk_mq_reg *reg, void *driver_data)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i, j;
+
+	for (i = 0; i < reg->nr_hw_queues; i++) {
+		hctx = kzalloc_node(sizeof(*hctx), GFP_KERNEL, reg->numa_node);
+		if (!hctx)
+			return -ENOMEM;
+		q->queue_hw_ctx[i] = hctx;
+
+		spin_lock_init(&hctx->lock);
+		INIT_LIST_HEAD(&hctx->dispatch);
+		INIT_DELAYED_WORK(&hctx->run_work, blk_mq_work_fn);
+		hctx->queue = q;
+		hctx->queue_num = i;
+		hctx->queue_depth = reg->queue_depth;
+		hctx->numa_node = reg->numa_node;
+		hctx->flags = reg->flags;
+		hctx->driver_data = driver_data;
+
+		if (!zalloc_cpumask_var(&hctx->cpumask, GFP_KERNEL))
+			return -ENOMEM;
+
+		hctx->ctxs = kmalloc_node(nr_cpu_ids * sizeof(void *),
+					  GFP_KERNEL, reg->numa_node);
+		hctx->ctx_map = kzalloc_node(BITS_TO_LONGS(nr_cpu_ids) *
+					     sizeof(unsigned long),
+					     GFP_KERNEL, reg->numa_node);
+		if (!hctx->ctxs || !hctx->ctx_map)
+			return -ENOMEM;
+
+		if (blk_mq_alloc_rqs(hctx, reg))
+			return -ENOMEM;
+	}
+
+	if (!reg->ops->init_hctx)
+		return 0;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (reg->ops->init_hctx(hctx, driver_data, i)) {
+			if (reg->ops->exit_hctx)
+				for (j = 0; j < i; j++)
+					reg->ops->exit_hctx(q->queue_hw_ctx[j], j);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * blk_mq_init_queue - set up a multi-queue request queue
+ * @reg:	hardware queues, their depth and the driver's operations
+ * @driver_data: passed to ->init_hctx(), and the default hctx->driver_data
+ *
+ * Description:
+ *    The multi-queue counterpart of blk_init_queue().  Every request
+ *    carries @reg->cmd_size bytes of driver data behind it, see
+ *    blk_mq_rq_to_pdu().  Returns an ERR_PTR() on failure.
+ */
+struct request_queue *blk_mq_init_queue(struct blk_mq_reg *reg,
+					void *driver_data)
+{
+	struct request_queue *q;
+
+	if (!reg->nr_hw_queues || !reg->queue_depth ||
+	    !reg->ops->queue_rq || !reg->ops->map_queue)
+		return ERR_PTR(-EINVAL);
+
+	if (reg->queue_depth > BLK_MQ_MAX_DEPTH) {
+		pr_err("blk-mq: queuedepth too large (%u)\n",
+		       reg->queue_depth);
+		reg->queue_depth = BLK_MQ_MAX_DEPTH;
+	}
+	if (reg->nr_hw_queues > nr_cpu_ids)
+		reg->nr_hw_queues = nr_cpu_ids;
+
+	q = blk_alloc_queue_node(GFP_KERNEL, reg->numa_node);
+	if (!q)
+		return ERR_PTR(-ENOMEM);
+
+	q->queue_ctx = alloc_percpu(struct blk_mq_ctx);
+	q->mq_map = kzalloc_node(nr_cpu_ids * sizeof(unsigned int),
+				 GFP_KERNEL, reg->numa_node);
+	q->queue_hw_ctx = kzalloc_node(reg->nr_hw_queues *
+				       sizeof(struct blk_mq_hw_ctx *),
+				       GFP_KERNEL, reg->numa_node);
+	if (!q->queue_ctx || !q->mq_map || !q->queue_hw_ctx)
+		goto err_map;
+
+	q->nr_queues = nr_cpu_ids;
+	q->nr_hw_queues = reg->nr_hw_queues;
+	blk_mq_map_queues(q->mq_map, reg->nr_hw_queues);
+
+	if (blk_mq_init_hw_queues(q, reg, driver_data))
+		goto err_hw;
+
+	q->mq_ops = reg->ops;
+	blk_mq_init_cpu_queues(q);
+
+	blk_queue_make_request(q, blk_mq_make_request);
+	q->queue_flags |= QUEUE_FLAG_DEFAULT;
+	if (!(reg->flags & BLK_MQ_F_SHOULD_MERGE))
+		queue_flag_set_unlocked(QUEUE_FLAG_NOMERGES, q);
+	q->nr_requests = reg->queue_depth;
+	q->sg_reserved_size = INT_MAX;
+
+	return q;
+
+err_hw:
+	blk_mq_free_hw_queues(q);
+err_map:
+	free_percpu(q->queue_ctx);
+	kfree(q->queue_hw_ctx);
+	kfree(q->mq_map);
+	q->queue_ctx = NULL;
+	q->nr_hw_queues = 0;
+	blk_cleanup_queue(q);
+	return ERR_PTR(-ENOMEM);
+}
+EXPORT_SYMBOL(blk_mq_init_queue);
+
+/*
+ * Called from blk_sync_queue(), stop any pending queue runs.
+ */
+void blk_mq_sync_queue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i)
+		cancel_delayed_work_sync(&hctx->run_work);
+}
+
+/*
+ * Called from blk_cleanup_queue() once the queue is dead.  Wait for all
+ * requests to complete and let the driver tear down its side of the
+ * hardware queues while it is still around.
+ */
+void blk_mq_cleanup_queue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	bool busy;
+	int i;
+
+	do {
+		busy = false;
+		queue_for_each_hw_ctx(q, hctx, i) {
+			if (blk_mq_hctx_has_pending(hctx))
+				blk_mq_run_hw_queue(hctx, false);
+			if (blk_mq_tags_busy(hctx->tags))
+				busy = true;
+		}
+		if (busy)
+			msleep(10);
+	} while (busy);
+
+	blk_mq_sync_queue(q);
+
+	if (q->mq_ops->exit_hctx) {
+		queue_for_each_hw_ctx(q, hctx, i)
+			q->mq_ops->exit_hctx(hctx, i);
+	}
+}
+
+/*
+ * Called when the last reference to the queue is dropped.
+ */
+void blk_mq_free_queue(struct request_queue *q)
+{
+	blk_mq_free_hw_queues(q);
+
+	free_percpu(q->queue_ctx);
+	kfree(q->queue_hw_ctx);
+	kfree(q->mq_map);
+
+	q->queue_ctx = NULL;
+	q->queue_hw_ctx = NULL;
+	q->mq_map = NULL;
+	q->nr_hw_queues = 0;
+}
+EXPORT_SYMBOL(blk_mq_free_queue);
@@ -0,0 +1,38 @@
+#ifndef INT_BLK_MQ_H
+#define INT_BLK_MQ_H
+
+struct blk_mq_ctx {
+	struct {
+		spinlock_t		lock;
+		struct list_head	rq_list;
+	}  ____cacheline_aligned_in_smp;
+
+	unsigned int		cpu;
+	unsigned int		index_hw;	/* bit in hctx->ctx_map */
+
+	struct request_queue	*queue;
+} ____cacheline_aligned_in_smp;
+
+void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule);
+void blk_mq_cleanup_queue(struct request_queue *q);
+void blk_mq_sync_queue(struct request_queue *q);
+
+/*
+ * Tags
+ */
+#define BLK_MQ_TAG_FAIL		((unsigned int) -1)
+
+struct blk_mq_tags;
+
+struct blk_mq_tags *blk_mq_init_tags(unsigned int nr_tags, int node);
+void blk_mq_free_tags(struct blk_mq_tags *tags);
+unsigned int blk_mq_get_tag(struct blk_mq_tags *tags, gfp_t gfp);
+void blk_mq_put_tag(struct blk_mq_tags *tags, unsigned int tag);
+bool blk_mq_tags_busy(struct blk_mq_tags *tags);
+
+/*
+ * CPU -> hardware queue mapping
+ */
+void blk_mq_map_queues(unsigned int *map, unsigned int nr_queues);
+
+#endif
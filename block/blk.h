@@ -11,6 +11,10 @@ extern struct kmem_cache *blk_requestq_cachep;
 extern struct kobj_type blk_queue_ktype;
 
 void init_request_from_bio(struct request *req, struct bio *bio);
+void drive_stat_acct(struct request *rq, int new_io);
+void blk_account_io_done(struct request *req);
+bool blk_attempt_plug_merge(struct request_queue *q, struct bio *bio,
+			    unsigned int *request_count);
 void blk_rq_bio_prep(struct request_queue *q, struct request *rq,
 			struct bio *bio);
 int blk_rq_append_bio(struct request_queue *q, struct request *rq,
@@ -0,0 +1,516 @@
+/*
+ * Null block device driver
+ *
+ * Completes every I/O without transferring any data, so that what is left
+ * when benchmarking it is the cost of the block layer itself.  Bios can be
+ * taken straight from ->make_request_fn, or go through a request_fn queue
+ * and its I/O scheduler, or through a multi-queue request queue, and be
+ * completed inline, from the block softirq or from a timer.
+ */
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/log2.h>
+#include <linux/percpu.h>
+#include <linux/hrtimer.h>
+
+struct nullb_cmd {
+	struct list_head list;
+	struct request *rq;
+	struct bio *bio;
+	unsigned int tag;
+	struct nullb_queue *nq;
+};
+
+/*
+ * The bio and request_fn modes have no tags of their own, so they get
+ * their commands from here.
+ */
+struct nullb_queue {
+	unsigned long *tag_map;
+	wait_queue_head_t wait;
+	unsigned int queue_depth;
+	struct nullb_cmd *cmds;
+};
+
+struct nullb {
+	struct list_head list;
+	unsigned int index;
+	struct request_queue *q;
+	struct gendisk *disk;
+	struct nullb_queue nq;
+};
+
+static LIST_HEAD(nullb_list);
+static DEFINE_MUTEX(lock);
+static int null_major;
+static int nullb_indexes;
+
+struct completion_queue {
+	struct list_head list;
+	struct hrtimer timer;
+};
+
+/* irqmode=2: commands wait here for the timer of the submitting CPU */
+static DEFINE_PER_CPU(struct completion_queue, completion_queues);
+
+enum {
+	NULL_IRQ_NONE		= 0,
+	NULL_IRQ_SOFTIRQ	= 1,
+	NULL_IRQ_TIMER		= 2,
+
+	NULL_Q_BIO		= 0,
+	NULL_Q_RQ		= 1,
+	NULL_Q_MQ		= 2,
+};
+
+static int submit_queues = 1;
+module_param(submit_queues, int, S_IRUGO);
+MODULE_PARM_DESC(submit_queues, "Number of hardware queues (queue_mode=2)");
+
+static int queue_mode = NULL_Q_MQ;
+module_param(queue_mode, int, S_IRUGO);
+MODULE_PARM_DESC(queue_mode, "Block interface to use (0=bio,1=rq,2=multiqueue)");
+
+static int gb = 250;
+module_param(gb, int, S_IRUGO);
+MODULE_PARM_DESC(gb, "Size in GB");
+
+static int bs = 512;
+module_param(bs, int, S_IRUGO);
+MODULE_PARM_DESC(bs, "Block size (in bytes)");
+
+static int nr_devices = 2;
+module_param(nr_devices, int, S_IRUGO);
+MODULE_PARM_DESC(nr_devices, "Number of devices to register");
+
+static int irqmode = NULL_IRQ_SOFTIRQ;
+module_param(irqmode, int, S_IRUGO);
+MODULE_PARM_DESC(irqmode, "IRQ completion handler. 0-none, 1-softirq, 2-timer");
+
+static int completion_nsec = 10000;
+module_param(completion_nsec, int, S_IRUGO);
+MODULE_PARM_DESC(completion_nsec, "Time in ns to complete a request in hardware. Default: 10,000ns");
+
+static int hw_queue_depth = 64;
+module_param(hw_queue_depth, int, S_IRUGO);
+MODULE_PARM_DESC(hw_queue_depth, "Queue depth for each hardware queue. Default: 64");
+
+static unsigned int get_tag(struct nullb_queue *nq)
+{
+	unsigned int tag;
+
+	do {
+		tag = find_first_zero_bit(nq->tag_map, nq->queue_depth);
+		if (tag >= nq->queue_depth)
+			return -1U;
+	} while (test_and_set_bit_lock(tag, nq->tag_map));
+
+	return tag;
+}
+
+static void free_cmd(struct nullb_cmd *cmd)
+{
+	struct nullb_queue *nq = cmd->nq;
+
+	clear_bit_unlock(cmd->tag, nq->tag_map);
+	smp_mb__after_clear_bit();
+	if (waitqueue_active(&nq->wait))
+		wake_up(&nq->wait);
+}
+
+static struct nullb_cmd *__alloc_cmd(struct nullb_queue *nq)
+{
+	struct nullb_cmd *cmd;
+	unsigned int tag;
+
+	tag = get_tag(nq);
+	if (tag == -1U)
+		return NULL;
+
+	cmd = &nq->cmds[tag];
+	cmd->tag = tag;
+	cmd->nq = nq;
+	return cmd;
+}
+
+static struct nullb_cmd *alloc_cmd(struct nullb_queue *nq, bool can_wait)
+{
+	struct nullb_cmd *cmd;
+	DEFINE_WAIT(wait);
+
+	cmd = __alloc_cmd(nq);
+	if (cmd || !can_wait)
+		return cmd;
+
+	do {
+		prepare_to_wait(&nq->wait, &wait, TASK_UNINTERRUPTIBLE);
+		cmd = __alloc_cmd(nq);
+		if (cmd)
+			break;
+
+		io_schedule();
+	} while (1);
+
+	finish_wait(&nq->wait, &wait);
+	return cmd;
+}
+
+/*
+ * A request_fn queue that ran out of commands stopped itself, start it
+ * again now that one is free.  The check is done under the queue_lock,
+ * which null_request_fn() holds while it allocates and stops, so the
+ * wakeup can't be missed.
+ */
+static void null_restart_queue(struct request_queue *q)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	if (blk_queue_stopped(q)) {
+		queue_flag_clear(QUEUE_FLAG_STOPPED, q);
+		blk_run_queue_async(q);
+	}
+	spin_unlock_irqrestore(q->queue_lock, flags);
+}
+
+static void end_cmd(struct nullb_cmd *cmd)
+{
+	struct request_queue *q;
+
+	switch (queue_mode) {
+	case NULL_Q_MQ:
+		blk_mq_end_io(cmd->rq, 0);
+		return;
+	case NULL_Q_RQ:
+		q = cmd->rq->q;
+		blk_end_request_all(cmd->rq, 0);
+		free_cmd(cmd);
+		null_restart_queue(q);
+		return;
+	case NULL_Q_BIO:
+		bio_endio(cmd->bio, 0);
+		free_cmd(cmd);
+		return;
+	}
+}
+
+static enum hrtimer_restart null_cmd_timer_expired(struct hrtimer *timer)
+{
+	struct completion_queue *cq;
+	struct nullb_cmd *cmd, *tmp;
+	LIST_HEAD(list);
+
+	cq = container_of(timer, struct completion_queue, timer);
+	list_splice_init(&cq->list, &list);
+
+	list_for_each_entry_safe(cmd, tmp, &list, list)
+		end_cmd(cmd);
+
+	return HRTIMER_NORESTART;
+}
+
+static void null_cmd_end_timer(struct nullb_cmd *cmd)
+{
+	struct completion_queue *cq;
+	unsigned long flags;
+
+	/* the timer runs on this CPU with interrupts off, so this is enough */
+	local_irq_save(flags);
+	cq = &__get_cpu_var(completion_queues);
+	if (list_empty(&cq->list))
+		hrtimer_start(&cq->timer, ktime_set(0, completion_nsec),
+			      HRTIMER_MODE_REL_PINNED);
+	list_add_tail(&cmd->list, &cq->list);
+	local_irq_restore(flags);
+}
+
+static void null_softirq_done_fn(struct request *rq)
+{
+	if (queue_mode == NULL_Q_MQ)
+		end_cmd(blk_mq_rq_to_pdu(rq));
+	else
+		end_cmd(rq->special);
+}
+
+static void null_handle_cmd(struct nullb_cmd *cmd)
+{
+	switch (irqmode) {
+	case NULL_IRQ_SOFTIRQ:
+		/* bios don't go through the block softirq, end them inline */
+		if (queue_mode != NULL_Q_BIO) {
+			blk_complete_request(cmd->rq);
+			break;
+		}
+		/* fall through */
+	case NULL_IRQ_NONE:
+		end_cmd(cmd);
+		break;
+	case NULL_IRQ_TIMER:
+		null_cmd_end_timer(cmd);
+		break;
+	}
+}
+
+static int null_queue_bio(struct request_queue *q, struct bio *bio)
+{
+	struct nullb *nullb = q->queuedata;
+	struct nullb_cmd *cmd;
+
+	cmd = alloc_cmd(&nullb->nq, true);
+	cmd->bio = bio;
+
+	null_handle_cmd(cmd);
+	return 0;
+}
+
+static void null_request_fn(struct request_queue *q)
+{
+	struct nullb *nullb = q->queuedata;
+	struct nullb_cmd *cmd;
+	struct request *rq;
+
+	while ((rq = blk_peek_request(q)) != NULL) {
+		cmd = alloc_cmd(&nullb->nq, false);
+		if (!cmd) {
+			/* restarted from null_restart_queue() */
+			blk_stop_queue(q);
+			break;
+		}
+
+		blk_start_request(rq);
+		cmd->rq = rq;
+		rq->special = cmd;
+
+		spin_unlock_irq(q->queue_lock);
+		null_handle_cmd(cmd);
+		spin_lock_irq(q->queue_lock);
+	}
+}
+
+static int null_queue_rq(struct blk_mq_hw_ctx *hctx, struct request *rq,
+			 bool last)
+{
+	struct nullb_cmd *cmd = blk_mq_rq_to_pdu(rq);
+
+	cmd->rq = rq;
+	null_handle_cmd(cmd);
+
+	return BLK_MQ_RQ_QUEUE_OK;
+}
+
+static struct blk_mq_ops null_mq_ops = {
+	.queue_rq	= null_queue_rq,
+	.map_queue	= blk_mq_map_queue,
+};
+
+static struct blk_mq_reg null_mq_reg = {
+	.ops		= &null_mq_ops,
+	.cmd_size	= sizeof(struct nullb_cmd),
+	.numa_node	= -1,
+	.flags		= BLK_MQ_F_SHOULD_MERGE,
+};
+
+static int setup_queue(struct nullb_queue *nq)
+{
+	nq->queue_depth = hw_queue_depth;
+	init_waitqueue_head(&nq->wait);
+
+	nq->cmds = kzalloc(nq->queue_depth * sizeof(struct nullb_cmd),
+			   GFP_KERNEL);
+	if (!nq->cmds)
+		return -ENOMEM;
+
+	nq->tag_map = kzalloc(BITS_TO_LONGS(nq->queue_depth) *
+			      sizeof(unsigned long), GFP_KERNEL);
+	if (!nq->tag_map) {
+		kfree(nq->cmds);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void cleanup_queue(struct nullb_queue *nq)
+{
+	kfree(nq->tag_map);
+	kfree(nq->cmds);
+}
+
+static void null_del_dev(struct nullb *nullb)
+{
+	list_del_init(&nullb->list);
+
+	del_gendisk(nullb->disk);
+	blk_cleanup_queue(nullb->q);
+	put_disk(nullb->disk);
+	if (queue_mode != NULL_Q_MQ)
+		cleanup_queue(&nullb->nq);
+	kfree(nullb);
+}
+
+static const struct block_device_operations null_fops = {
+	.owner		= THIS_MODULE,
+};
+
+static int null_add_dev(void)
+{
+	struct gendisk *disk;
+	struct nullb *nullb;
+	sector_t size;
+
+	nullb = kzalloc(sizeof(*nullb), GFP_KERNEL);
+	if (!nullb)
+		return -ENOMEM;
+
+	if (queue_mode != NULL_Q_MQ && setup_queue(&nullb->nq))
+		goto out_free_nullb;
+
+	switch (queue_mode) {
+	case NULL_Q_MQ:
+		null_mq_reg.nr_hw_queues = submit_queues;
+		null_mq_reg.queue_depth = hw_queue_depth;
+
+		nullb->q = blk_mq_init_queue(&null_mq_reg, nullb);
+		if (IS_ERR(nullb->q))
+			goto out_free_nullb;
+		break;
+	case NULL_Q_BIO:
+		nullb->q = blk_alloc_queue_node(GFP_KERNEL, -1);
+		if (!nullb->q)
+			goto out_cleanup_nq;
+		blk_queue_make_request(nullb->q, null_queue_bio);
+		break;
+	case NULL_Q_RQ:
+		nullb->q = blk_init_queue_node(null_request_fn, NULL, -1);
+		if (!nullb->q)
+			goto out_cleanup_nq;
+		break;
+	}
+
+	nullb->q->queuedata = nullb;
+	blk_queue_softirq_done(nullb->q, null_softirq_done_fn);
+	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, nullb->q);
+	queue_flag_clear_unlocked(QUEUE_FLAG_ADD_RANDOM, nullb->q);
+
+	disk = nullb->disk = alloc_disk(1);
+	if (!disk)
+		goto out_cleanup_blk_queue;
+
+	mutex_lock(&lock);
+	list_add_tail(&nullb->list, &nullb_list);
+	nullb->index = nullb_indexes++;
+	mutex_unlock(&lock);
+
+	blk_queue_logical_block_size(nullb->q, bs);
+	blk_queue_physical_block_size(nullb->q, bs);
+
+	size = gb * 1024 * 1024 * 1024ULL;
+	sector_div(size, bs);
+	set_capacity(disk, size * (bs >> 9));
+
+	disk->flags |= GENHD_FL_EXT_DEVT;
+	disk->major		= null_major;
+	disk->first_minor	= nullb->index;
+	disk->fops		= &null_fops;
+	disk->private_data	= nullb;
+	disk->queue		= nullb->q;
+	sprintf(disk->disk_name, "nullb%d", nullb->index);
+	add_disk(disk);
+	return 0;
+
+out_cleanup_blk_queue:
+	blk_cleanup_queue(nullb->q);
+out_cleanup_nq:
+	if (queue_mode != NULL_Q_MQ)
+		cleanup_queue(&nullb->nq);
+out_free_nullb:
+	kfree(nullb);
+	return -ENOMEM;
+}
+
+static void null_del_devs(void)
+{
+	struct nullb *nullb;
+
+	mutex_lock(&lock);
+	while (!list_empty(&nullb_list)) {
+		nullb = list_entry(nullb_list.next, struct nullb, list);
+		null_del_dev(nullb);
+	}
+	mutex_unlock(&lock);
+}
+
+static int __init null_init(void)
+{
+	unsigned int i;
+
+	if (bs > PAGE_SIZE || bs < 512 || !is_power_of_2(bs)) {
+		pr_warn("null_blk: invalid block size %d, using 512\n", bs);
+		bs = 512;
+	}
+
+	if (queue_mode < NULL_Q_BIO || queue_mode > NULL_Q_MQ) {
+		pr_warn("null_blk: invalid queue_mode %d, using %d\n",
+			queue_mode, NULL_Q_MQ);
+		queue_mode = NULL_Q_MQ;
+	}
+
+	if (irqmode < NULL_IRQ_NONE || irqmode > NULL_IRQ_TIMER) {
+		pr_warn("null_blk: invalid irqmode %d, using %d\n",
+			irqmode, NULL_IRQ_SOFTIRQ);
+		irqmode = NULL_IRQ_SOFTIRQ;
+	}
+
+	if (submit_queues < 1)
+		submit_queues = 1;
+	else if (submit_queues > nr_cpu_ids)
+		submit_queues = nr_cpu_ids;
+
+	if (hw_queue_depth < 1)
+		hw_queue_depth = 1;
+
+	for_each_possible_cpu(i) {
+		struct completion_queue *cq = &per_cpu(completion_queues, i);
+
+		INIT_LIST_HEAD(&cq->list);
+		hrtimer_init(&cq->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		cq->timer.function = null_cmd_timer_expired;
+	}
+
+	null_major = register_blkdev(0, "nullb");
+	if (null_major < 0)
+		return null_major;
+
+	for (i = 0; i < nr_devices; i++) {
+		if (null_add_dev()) {
+			null_del_devs();
+			unregister_blkdev(null_major, "nullb");
+			return -ENOMEM;
+		}
+	}
+
+	pr_info("null: module loaded\n");
+	return 0;
+}
+
+static void __exit null_exit(void)
+{
+	unsigned int cpu;
+
+	null_del_devs();
+	unregister_blkdev(null_major, "nullb");
+
+	for_each_possible_cpu(cpu)
+		hrtimer_cancel(&per_cpu(completion_queues, cpu).timer);
+}
+
+module_init(null_init);
+module_exit(null_exit);
+
+MODULE_LICENSE("GPL");
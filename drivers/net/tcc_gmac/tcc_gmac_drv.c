@@ -509,6 +509,7 @@ static void dma_free_tx_skbufs(struct tcc_gmac_priv *priv)
 			priv->tx_skbuff[i] = NULL;
 		}
 	}
+	netdev_reset_queue(priv->dev);
 	return;
 }
 
@@ -584,6 +585,7 @@ static void tcc_gmac_tx(struct tcc_gmac_priv *priv)
 {
     unsigned int txsize = priv->dma_tx_size;
     unsigned long ioaddr = priv->dev->base_addr;
+	unsigned int pkts_compl = 0, bytes_compl = 0;
 	unsigned long flags;
 
 	//spin_lock_irqsave(&priv->lock, flags);
@@ -626,6 +628,9 @@ static void tcc_gmac_tx(struct tcc_gmac_priv *priv)
 				p->des3 = 0;
 
 		if (likely(skb != NULL)) {
+			pkts_compl++;
+			bytes_compl += skb->len;
+
 			/*
 			 * If there's room in the queue (limit it to size)
 			 * we add this skb back into the pool,
@@ -643,7 +648,9 @@ static void tcc_gmac_tx(struct tcc_gmac_priv *priv)
 		priv->hw->desc->release_tx_desc(p);
 		entry = (++priv->dirty_tx) % txsize;
 	}
-	
+
+	netdev_completed_queue(priv->dev, pkts_compl, bytes_compl);
+
 	if (unlikely(netif_queue_stopped(priv->dev) &&
 		tcc_gmac_tx_avail(priv) > TCC_GMAC_TX_THRESH(priv))) {
 		netif_tx_lock(priv->dev);
@@ -1574,6 +1581,9 @@ static int tcc_gmac_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	/* Interrupt on completition only for the latest segment */
 	priv->hw->desc->close_tx_desc(desc);
 
+	/* Account the frame before the DMA can complete it */
+	netdev_sent_queue(dev, skb->len);
+
 	/* To avoid raise condition */
 	priv->hw->desc->set_tx_owner(first);
 	priv->cur_tx++;
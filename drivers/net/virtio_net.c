@@ -26,6 +26,7 @@
 #include <linux/scatterlist.h>
 #include <linux/if_vlan.h>
 #include <linux/slab.h>
+#include <linux/interrupt.h>
 
 static int napi_weight = 128;
 module_param(napi_weight, int, 0444);
@@ -71,6 +72,9 @@ struct virtnet_info {
 	/* Work struct for refilling if we run low on memory. */
 	struct delayed_work refill;
 
+	/* Reclaims sent skbs from the tx interrupt, see skb_xmit_done() */
+	struct tasklet_struct tx_reclaim;
+
 	/* Chain pages by the private ptr. */
 	struct page *pages;
 
@@ -136,8 +140,11 @@ static void skb_xmit_done(struct virtqueue *svq)
 	/* Suppress further interrupts. */
 	virtqueue_disable_cb(svq);
 
-	/* We were probably waiting for more output buffers. */
-	netif_wake_queue(vi->dev);
+	/* Sent skbs stay charged to their sockets until they are freed,
+	 * and we may also be waiting for more output buffers or for the
+	 * bytes in flight to drop below the byte queue limit.  Reclaiming
+	 * has to be done under the tx lock. */
+	tasklet_schedule(&vi->tx_reclaim);
 }
 
 static void set_skb_frag(struct sk_buff *skb, struct page *page,
@@ -530,23 +537,43 @@ again:
 static unsigned int free_old_xmit_skbs(struct virtnet_info *vi)
 {
 	struct sk_buff *skb;
-	unsigned int len, tot_sgs = 0;
+	unsigned int len, tot_sgs = 0, packets = 0, bytes = 0;
 	struct virtnet_stats __percpu *stats = this_cpu_ptr(vi->stats);
 
 	while ((skb = virtqueue_get_buf(vi->svq, &len)) != NULL) {
 		pr_debug("Sent skb %p\n", skb);
 
-		u64_stats_update_begin(&stats->syncp);
-		stats->tx_bytes += skb->len;
-		stats->tx_packets++;
-		u64_stats_update_end(&stats->syncp);
-
+		packets++;
+		bytes += skb->len;
 		tot_sgs += skb_vnet_hdr(skb)->num_sg;
 		dev_kfree_skb_any(skb);
 	}
+
+	u64_stats_update_begin(&stats->syncp);
+	stats->tx_bytes += bytes;
+	stats->tx_packets += packets;
+	u64_stats_update_end(&stats->syncp);
+
+	netdev_completed_queue(vi->dev, packets, bytes);
 	return tot_sgs;
 }
 
+static void virtnet_tx_reclaim(unsigned long data)
+{
+	struct virtnet_info *vi = (struct virtnet_info *)data;
+	struct netdev_queue *txq = netdev_get_tx_queue(vi->dev, 0);
+
+	__netif_tx_lock(txq, smp_processor_id());
+	free_old_xmit_skbs(vi);
+	netif_tx_wake_queue(txq);
+	/* Rearm for what is still outstanding; more may already be used. */
+	if (unlikely(!virtqueue_enable_cb_delayed(vi->svq))) {
+		virtqueue_disable_cb(vi->svq);
+		tasklet_schedule(&vi->tx_reclaim);
+	}
+	__netif_tx_unlock(txq);
+}
+
 static int xmit_skb(struct virtnet_info *vi, struct sk_buff *skb)
 {
 	struct skb_vnet_hdr *hdr = skb_vnet_hdr(skb);
@@ -597,6 +624,7 @@ static int xmit_skb(struct virtnet_info *vi, struct sk_buff *skb)
 static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct virtnet_info *vi = netdev_priv(dev);
+	unsigned int len = skb->len;
 	int capacity;
 
 	/* Free up any pending old buffers before queueing new ones. */
@@ -622,24 +650,28 @@ static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 		kfree_skb(skb);
 		return NETDEV_TX_OK;
 	}
+	netdev_sent_queue(dev, len);
 	virtqueue_kick(vi->svq);
 
-	/* Don't wait up for transmitted skbs to be freed. */
-	skb_orphan(skb);
+	/* The skb stays charged to its socket until the host has used it,
+	 * which is what TCP Small Queues measures, so it is not orphaned
+	 * here; just drop the conntrack reference. */
 	nf_reset(skb);
 
 	/* Apparently nice girls don't return TX_BUSY; stop the queue
 	 * before it gets out of hand.  Naturally, this wastes entries. */
-	if (capacity < 2+MAX_SKB_FRAGS) {
+	if (capacity < 2+MAX_SKB_FRAGS)
 		netif_stop_queue(dev);
-		if (unlikely(!virtqueue_enable_cb_delayed(vi->svq))) {
-			/* More just got used, free them then recheck. */
-			capacity += free_old_xmit_skbs(vi);
-			if (capacity >= 2+MAX_SKB_FRAGS) {
-				netif_start_queue(dev);
-				virtqueue_disable_cb(vi->svq);
-			}
-		}
+
+	/* Sent skbs must be freed even if nothing else is transmitted, so
+	 * always ask for an interrupt once most of them have been used. */
+	if (unlikely(!virtqueue_enable_cb_delayed(vi->svq))) {
+		/* More just got used, free them then recheck. */
+		capacity += free_old_xmit_skbs(vi);
+		if (capacity >= 2+MAX_SKB_FRAGS)
+			netif_start_queue(dev);
+		virtqueue_disable_cb(vi->svq);
+		tasklet_schedule(&vi->tx_reclaim);
 	}
 
 	return NETDEV_TX_OK;
@@ -1002,6 +1034,7 @@ static int virtnet_probe(struct virtio_device *vdev)
 		goto free;
 
 	INIT_DELAYED_WORK(&vi->refill, refill_work);
+	tasklet_init(&vi->tx_reclaim, virtnet_tx_reclaim, (unsigned long)vi);
 	sg_init_table(vi->rx_sg, ARRAY_SIZE(vi->rx_sg));
 	sg_init_table(vi->tx_sg, ARRAY_SIZE(vi->tx_sg));
 
@@ -1063,6 +1096,7 @@ static int virtnet_probe(struct virtio_device *vdev)
 unregister:
 	unregister_netdev(dev);
 	cancel_delayed_work_sync(&vi->refill);
+	tasklet_kill(&vi->tx_reclaim);
 free_vqs:
 	vdev->config->del_vqs(vdev);
 free_stats:
@@ -1104,6 +1138,7 @@ static void __devexit virtnet_remove(struct virtio_device *vdev)
 
 	unregister_netdev(vi->dev);
 	cancel_delayed_work_sync(&vi->refill);
+	tasklet_kill(&vi->tx_reclaim);
 
 	/* Free unused buffers in both send and recv, if any. */
 	free_unused_bufs(vi);
@@ -74,6 +74,10 @@
  *				being a CD-ROM.
  *	->nofua		Flag specifying that FUA flag in SCSI WRITE(10,12)
  *				commands for this LUN shall be ignored.
+ *	->nocache	Flag specifying that data written to this LUN
+ *				shall be sent to the medium right away
+ *				and that the page cache of data already
+ *				transferred shall be dropped.
  *
  *	lun_name_format	A printf-like format for names of the LUN
  *				devices.  This determines how the
@@ -130,6 +134,8 @@
  *				a CD-ROM drive.
  *	nofua=b[,b...]	Default false, booleans for ignore FUA flag
  *				in SCSI WRITE(10,12) commands
+ *	nocache=b[,b...] Default false, booleans for streaming the
+ *				data past the page cache
  *	luns=N		Default N = number of filenames, number of
  *				LUNs to support.
  *	stall		Default determined according to the type of
@@ -145,9 +151,10 @@
  *
  *
  * Requirements are modest; only a bulk-in and a bulk-out endpoint are
- * needed.  The memory requirement amounts to two 16K buffers, size
- * configurable by a parameter.  Support is included for both
- * full-speed and high-speed operation.
+ * needed.  The memory requirement amounts to a ring of 16K buffers
+ * (CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS of them, or the "num_buffers"
+ * module parameter).  Support is included for both full-speed and
+ * high-speed operation.
  *
  * Note that the driver is slightly non-portable in that it assumes a
  * single memory/DMA buffer will be useable for bulk-in, bulk-out, and
@@ -164,7 +171,8 @@
  * files will simulate ejecting/loading the medium (writing an empty
  * line means eject) and adjusting a write-enable tab.  Changes to the
  * ro setting are not allowed when the medium is loaded or if CD-ROM
- * emulation is being used.
+ * emulation is being used.  The "nofua" and "nocache" flags can be
+ * changed through attribute files of the same names at any time.
  *
  * When a LUN receive an "eject" SCSI request (Start/Stop Unit),
  * if the LUN is removable, the backing file is released to simulate
@@ -321,6 +329,17 @@ static const char fsg_string_interface[] = "Mass Storage";
 
 #include "storage_common.c"
 
+/*
+ * Every buffer of the ring can have a bulk transfer in flight while the
+ * thread reads or writes the backing file through another one, so a
+ * deeper ring keeps the bus busy across slow or bursty file I/O.
+ */
+#define FSG_MAX_NUM_BUFFERS	32
+
+static unsigned int fsg_num_buffers = CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS;
+module_param_named(num_buffers, fsg_num_buffers, uint, S_IRUGO);
+MODULE_PARM_DESC(num_buffers, "number of pipeline buffers (2-32)");
+
 
 /*-------------------------------------------------------------------------*/
 
@@ -372,7 +391,8 @@ struct fsg_common {
 
 	struct fsg_buffhd	*next_buffhd_to_fill;
 	struct fsg_buffhd	*next_buffhd_to_drain;
-	struct fsg_buffhd	buffhds[FSG_NUM_BUFFERS];
+	struct fsg_buffhd	*buffhds;
+	unsigned int		num_buffers;
 
 	int			cmnd_size;
 	u8			cmnd[MAX_COMMAND_SIZE];
@@ -426,6 +446,7 @@ struct fsg_config {
 		char removable;
 		char cdrom;
 		char nofua;
+		char nocache;
 	} luns[FSG_MAX_LUNS];
 
 	const char		*lun_name_format;
@@ -747,6 +768,30 @@ static int sleep_thread(struct fsg_common *common)
 
 /*-------------------------------------------------------------------------*/
 
+/*
+ * Keep the page cache footprint of a "nocache" LUN down to about one
+ * command.  What a WRITE left dirty is handed to the block layer right
+ * away instead of whenever the flusher threads get to it, so the medium
+ * is busy while the host is still sending the next command's data, and
+ * the pages the previous command of a sequential stream went through are
+ * dropped.  Pages still dirty or under writeback are left alone.
+ */
+static void fsg_lun_cache_behind(struct fsg_lun *curlun, loff_t start,
+				 loff_t end, int write)
+{
+	struct address_space *mapping = curlun->filp->f_mapping;
+	loff_t behind = max_t(loff_t, 2 * start - end, 0);
+
+	if (!curlun->nocache || curlun->can_ioctl || end <= start)
+		return;
+
+	if (write)
+		filemap_fdatawrite_range(mapping, start, end - 1);
+	if (start > behind)
+		invalidate_mapping_pages(mapping, behind >> PAGE_CACHE_SHIFT,
+					 (start - 1) >> PAGE_CACHE_SHIFT);
+}
+
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
@@ -754,6 +799,7 @@ static int do_read(struct fsg_common *common)
 	struct fsg_buffhd	*bh;
 	int			rc;
 	u32			amount_left;
+	loff_t			start_offset;
 	loff_t			file_offset, file_offset_tmp;
 	unsigned int		amount;
 	unsigned int		partial_page;
@@ -782,7 +828,7 @@ static int do_read(struct fsg_common *common)
 		curlun->sense_data = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
 		return -EINVAL;
 	}
-	file_offset = ((loff_t) lba) << 9;
+	start_offset = file_offset = ((loff_t) lba) << 9;
 
 	/* Carry out the file reads */
 	amount_left = common->data_size_from_cmnd;
@@ -887,6 +933,7 @@ static int do_read(struct fsg_common *common)
 		common->next_buffhd_to_fill = bh->next;
 	}
 
+	fsg_lun_cache_behind(curlun, start_offset, file_offset, 0);
 	return -EIO;		/* No default reply */
 }
 
@@ -900,7 +947,8 @@ static int do_write(struct fsg_common *common)
 	struct fsg_buffhd	*bh;
 	int			get_some_more;
 	u32			amount_left_to_req, amount_left_to_write;
-	loff_t			usb_offset, file_offset, file_offset_tmp;
+	loff_t			start_offset, usb_offset;
+	loff_t			file_offset, file_offset_tmp;
 	unsigned int		amount;
 	unsigned int		partial_page;
 	ssize_t			nwritten;
@@ -948,7 +996,7 @@ static int do_write(struct fsg_common *common)
 
 	/* Carry out the file writes */
 	get_some_more = 1;
-	file_offset = usb_offset = ((loff_t) lba) << 9;
+	start_offset = file_offset = usb_offset = ((loff_t) lba) << 9;
 	amount_left_to_req = common->data_size_from_cmnd;
 	amount_left_to_write = common->data_size_from_cmnd;
 
@@ -1103,6 +1151,7 @@ static int do_write(struct fsg_common *common)
 			return rc;
 	}
 
+	fsg_lun_cache_behind(curlun, start_offset, file_offset, 1);
 	return -EIO;		/* No default reply */
 }
 
@@ -2402,7 +2451,7 @@ reset:
 	if (common->fsg) {
 		fsg = common->fsg;
 
-		for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+		for (i = 0; i < common->num_buffers; ++i) {
 			struct fsg_buffhd *bh = &common->buffhds[i];
 
 			if (bh->inreq) {
@@ -2460,7 +2509,7 @@ reset:
 	clear_bit(IGNORE_BULK_OUT, &fsg->atomic_bitflags);
 
 	/* Allocate the requests */
-	for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+	for (i = 0; i < common->num_buffers; ++i) {
 		struct fsg_buffhd	*bh = &common->buffhds[i];
 
 		rc = alloc_request(common, fsg->bulk_in, &bh->inreq);
@@ -2532,7 +2581,7 @@ static void handle_exception(struct fsg_common *common)
 
 	/* Cancel all the pending transfers */
 	if (likely(common->fsg)) {
-		for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+		for (i = 0; i < common->num_buffers; ++i) {
 			bh = &common->buffhds[i];
 			if (bh->inreq_busy)
 				usb_ep_dequeue(common->fsg->bulk_in, bh->inreq);
@@ -2544,7 +2593,7 @@ static void handle_exception(struct fsg_common *common)
 		/* Wait until everything is idle */
 		for (;;) {
 			int num_active = 0;
-			for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+			for (i = 0; i < common->num_buffers; ++i) {
 				bh = &common->buffhds[i];
 				num_active += bh->inreq_busy + bh->outreq_busy;
 			}
@@ -2567,7 +2616,7 @@ static void handle_exception(struct fsg_common *common)
 	 */
 	spin_lock_irq(&common->lock);
 
-	for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+	for (i = 0; i < common->num_buffers; ++i) {
 		bh = &common->buffhds[i];
 		bh->state = BUF_STATE_EMPTY;
 	}
@@ -2740,9 +2789,35 @@ static int fsg_main_thread(void *common_)
 
 /*************************** DEVICE ATTRIBUTES ***************************/
 
+static ssize_t fsg_show_nocache(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct fsg_lun	*curlun = fsg_lun_from_dev(dev);
+
+	return sprintf(buf, "%u\n", curlun->nocache);
+}
+
+static ssize_t fsg_store_nocache(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct fsg_lun	*curlun = fsg_lun_from_dev(dev);
+	unsigned	nocache;
+	int		ret;
+
+	ret = kstrtouint(buf, 2, &nocache);
+	if (ret)
+		return ret;
+
+	curlun->nocache = nocache;
+
+	return count;
+}
+
 /* Write permission is checked per LUN in store_*() functions. */
 static DEVICE_ATTR(ro, 0644, fsg_show_ro, fsg_store_ro);
 static DEVICE_ATTR(nofua, 0644, fsg_show_nofua, fsg_store_nofua);
+static DEVICE_ATTR(nocache, 0644, fsg_show_nocache, fsg_store_nocache);
 static DEVICE_ATTR(file, 0644, fsg_show_file, fsg_store_file);
 
 
@@ -2829,6 +2904,7 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 		curlun->ro = lcfg->cdrom || lcfg->ro;
 		curlun->initially_ro = curlun->ro;
 		curlun->removable = lcfg->removable;
+		curlun->nocache = lcfg->nocache;
 		curlun->dev.release = fsg_lun_release;
 		curlun->dev.parent = &gadget->dev;
 		/* curlun->dev.driver = &fsg_driver.driver; XXX */
@@ -2854,6 +2930,9 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 		if (rc)
 			goto error_luns;
 		rc = device_create_file(&curlun->dev, &dev_attr_nofua);
+		if (rc)
+			goto error_luns;
+		rc = device_create_file(&curlun->dev, &dev_attr_nocache);
 		if (rc)
 			goto error_luns;
 
@@ -2870,8 +2949,16 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 	common->nluns = nluns;
 
 	/* Data buffers cyclic list */
+	common->num_buffers = clamp_t(unsigned int, fsg_num_buffers,
+				      2, FSG_MAX_NUM_BUFFERS);
+	common->buffhds = kcalloc(common->num_buffers,
+				  sizeof *common->buffhds, GFP_KERNEL);
+	if (unlikely(!common->buffhds)) {
+		rc = -ENOMEM;
+		goto error_release;
+	}
 	bh = common->buffhds;
-	i = FSG_NUM_BUFFERS;
+	i = common->num_buffers;
 	goto buffhds_first_it;
 	do {
 		bh->next = bh + 1;
@@ -2989,6 +3076,7 @@ static void fsg_common_release(struct kref *ref)
 
 		/* In error recovery common->nluns may be zero. */
 		for (; i; --i, ++lun) {
+			device_remove_file(&lun->dev, &dev_attr_nocache);
 			device_remove_file(&lun->dev, &dev_attr_nofua);
 			device_remove_file(&lun->dev, &dev_attr_ro);
 			device_remove_file(&lun->dev, &dev_attr_file);
@@ -2999,9 +3087,9 @@ static void fsg_common_release(struct kref *ref)
 		kfree(common->luns);
 	}
 
-	{
+	if (likely(common->buffhds)) {
 		struct fsg_buffhd *bh = common->buffhds;
-		unsigned i = FSG_NUM_BUFFERS;
+		unsigned i = common->num_buffers;
 		do {
 #ifdef DMA_MODE
 			dma_free_coherent (NULL, FSG_BUFLEN, bh->buf, bh->dma);	//for dma (AlenOh)
@@ -3009,6 +3097,8 @@ static void fsg_common_release(struct kref *ref)
 			kfree(bh->buf);
 #endif			
 		} while (++bh, --i);
+
+		kfree(common->buffhds);
 	}
 
    /*B090162: Fix Kernel panic built as module*/
@@ -3156,9 +3246,10 @@ struct fsg_module_parameters {
 	int		removable[FSG_MAX_LUNS];
 	int		cdrom[FSG_MAX_LUNS];
 	int		nofua[FSG_MAX_LUNS];
+	int		nocache[FSG_MAX_LUNS];
 
 	unsigned int	file_count, ro_count, removable_count, cdrom_count;
-	unsigned int	nofua_count;
+	unsigned int	nofua_count, nocache_count;
 	unsigned int	luns;	/* nluns */
 	int		stall;	/* can_stall */
 };
@@ -3185,6 +3276,8 @@ struct fsg_module_parameters {
 				"true to simulate CD-ROM instead of disk"); \
 	_FSG_MODULE_PARAM_ARRAY(prefix, params, nofua, bool,		\
 				"true to ignore SCSI WRITE(10,12) FUA bit"); \
+	_FSG_MODULE_PARAM_ARRAY(prefix, params, nocache, bool,		\
+				"true to stream data past the page cache"); \
 	_FSG_MODULE_PARAM(prefix, params, luns, uint,			\
 			  "number of LUNs");				\
 	_FSG_MODULE_PARAM(prefix, params, stall, bool,			\
@@ -3204,6 +3297,7 @@ fsg_config_from_params(struct fsg_config *cfg,
 	for (i = 0, lun = cfg->luns; i < cfg->nluns; ++i, ++lun) {
 		lun->ro = !!params->ro[i];
 		lun->cdrom = !!params->cdrom[i];
+		lun->nocache = !!params->nocache[i];
 		lun->removable = /* Removable by default */
 			params->removable_count <= i || params->removable[i];
 		lun->filename =
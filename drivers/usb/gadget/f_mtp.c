@@ -28,6 +28,7 @@
 
 #include <linux/types.h>
 #include <linux/file.h>
+#include <linux/pagemap.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
 
@@ -37,6 +38,7 @@
 #include <linux/usb/f_mtp.h>
 
 #define MTP_BULK_BUFFER_SIZE       16384
+#define MTP_BULK_BUFFER_MAX        (1024 * 1024)
 #define INTR_BUFFER_SIZE           28
 
 /* String IDs */
@@ -49,9 +51,9 @@
 #define STATE_CANCELED              3   /* transaction canceled by host */
 #define STATE_ERROR                 4   /* error from completion routine */
 
-/* number of tx and rx requests to allocate */
-#define TX_REQ_MAX 4
-#define RX_REQ_MAX 2
+/* maximum number of tx and rx requests to allocate */
+#define TX_REQ_MAX 16
+#define RX_REQ_MAX 8
 #define INTR_REQ_MAX 5
 
 /* ID for Microsoft MTP OS String */
@@ -69,6 +71,27 @@
 
 static const char mtp_shortname[] = "mtp_usb";
 
+/*
+ * Bulk request sizes and queue depths.  These are sampled when the
+ * function is bound; if the large buffers cannot be allocated we fall
+ * back to MTP_BULK_BUFFER_SIZE.
+ */
+static unsigned int mtp_tx_req_len = 64 * 1024;
+module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_req_len, "MTP bulk IN request size in bytes");
+
+static unsigned int mtp_rx_req_len = 64 * 1024;
+module_param(mtp_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_req_len, "MTP bulk OUT request size in bytes");
+
+static unsigned int mtp_tx_reqs = 8;
+module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_reqs, "number of MTP bulk IN requests");
+
+static unsigned int mtp_rx_reqs = 4;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_reqs, "number of MTP bulk OUT requests");
+
 #ifdef CONFIG_ARCH_TCC
 #if defined(CONFIG_TCC_DWC_HS_ELECT_TST)
 #undef DMA_MODE
@@ -100,7 +123,13 @@ struct mtp_dev {
 	wait_queue_head_t write_wq;
 	wait_queue_head_t intr_wq;
 	struct usb_request *rx_req[RX_REQ_MAX];
-	int rx_done;
+	/* number of OUT requests completed since it was last cleared */
+	unsigned rx_done;
+
+	unsigned tx_req_len;
+	unsigned rx_req_len;
+	unsigned tx_reqs;
+	unsigned rx_reqs;
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
 	 * MTP_SEND_FILE_WITH_HEADER ioctls on a work queue
@@ -348,7 +377,7 @@ static struct usb_request *mtp_request_new(struct usb_ep *ep, int buffer_size)
 	if (!req)
 		return NULL;
 #ifdef DMA_MODE
-	req->buf = dma_alloc_coherent(NULL, MTP_BULK_BUFFER_SIZE, &req->dma, GFP_KERNEL|GFP_DMA); 
+	req->buf = dma_alloc_coherent(NULL, buffer_size, &req->dma, GFP_KERNEL|GFP_DMA);
 #else
 	/* now allocate buffers for the requests */
 	req->buf = kmalloc(buffer_size, GFP_KERNEL);
@@ -361,11 +390,12 @@ static struct usb_request *mtp_request_new(struct usb_ep *ep, int buffer_size)
 	return req;
 }
 
-static void mtp_request_free(struct usb_request *req, struct usb_ep *ep)
+static void mtp_request_free(struct usb_request *req, struct usb_ep *ep,
+			     int buffer_size)
 {
 	if (req) {
 #ifdef DMA_MODE
-		dma_free_coherent(NULL, MTP_BULK_BUFFER_SIZE, req->buf, req->dma);
+		dma_free_coherent(NULL, buffer_size, req->buf, req->dma);
 #else		
 		kfree(req->buf);
 #endif
@@ -433,8 +463,9 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
 
-	dev->rx_done = 1;
-	if (req->status != 0)
+	dev->rx_done++;
+	/* requests we dequeue ourselves are not a transfer error */
+	if (req->status != 0 && req->status != -ECONNRESET)
 		dev->state = STATE_ERROR;
 
 	wake_up(&dev->read_wq);
@@ -500,18 +531,45 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	ep->driver_data = dev;		/* claim the endpoint */
 	dev->ep_intr = ep;
 
+	/*
+	 * Request lengths are kept a multiple of the largest bulk maxpacket,
+	 * so only the last request of a transfer can end in a short packet.
+	 */
+	dev->tx_req_len = round_down(clamp_t(unsigned, mtp_tx_req_len,
+			MTP_BULK_BUFFER_SIZE, MTP_BULK_BUFFER_MAX), 1024);
+	dev->rx_req_len = round_down(clamp_t(unsigned, mtp_rx_req_len,
+			MTP_BULK_BUFFER_SIZE, MTP_BULK_BUFFER_MAX), 1024);
+	dev->tx_reqs = clamp_t(unsigned, mtp_tx_reqs, 2, TX_REQ_MAX);
+	dev->rx_reqs = clamp_t(unsigned, mtp_rx_reqs, 2, RX_REQ_MAX);
+
 	/* now allocate requests for our endpoints */
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+retry_tx_alloc:
+	for (i = 0; i < dev->tx_reqs; i++) {
+		req = mtp_request_new(dev->ep_in, dev->tx_req_len);
+		if (!req) {
+			if (dev->tx_req_len == MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while ((req = mtp_req_get(dev, &dev->tx_idle)))
+				mtp_request_free(req, dev->ep_in,
+						 dev->tx_req_len);
+			dev->tx_req_len = MTP_BULK_BUFFER_SIZE;
+			goto retry_tx_alloc;
+		}
 		req->complete = mtp_complete_in;
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
-	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+retry_rx_alloc:
+	for (i = 0; i < dev->rx_reqs; i++) {
+		req = mtp_request_new(dev->ep_out, dev->rx_req_len);
+		if (!req) {
+			if (dev->rx_req_len == MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while (i--)
+				mtp_request_free(dev->rx_req[i], dev->ep_out,
+						 dev->rx_req_len);
+			dev->rx_req_len = MTP_BULK_BUFFER_SIZE;
+			goto retry_rx_alloc;
+		}
 		req->complete = mtp_complete_out;
 		dev->rx_req[i] = req;
 	}
@@ -541,7 +599,7 @@ static ssize_t mtp_read(struct file *fp, char __user *buf,
 
 	DBG(cdev,  "mtp_read(%d)\n", count);
 
-	if (count > MTP_BULK_BUFFER_SIZE)
+	if (count > dev->rx_req_len)
 		return -EINVAL;
 
 	/* we will block until we're online */
@@ -661,8 +719,8 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 		if (xfer && copy_from_user(req->buf, buf, xfer)) {
@@ -708,6 +766,7 @@ static void send_file_work(struct work_struct *data) {
 	struct file *filp;
 	loff_t offset;
 	int64_t count;
+	unsigned long ra_pages;
 	int xfer, ret, hdr_size;
 	int r = 0;
 	int sendZLP = 0;
@@ -720,6 +779,17 @@ static void send_file_work(struct work_struct *data) {
 
 	DBG(cdev,  "send_file_work(%lld %lld)\n", offset, count);
 
+	/*
+	 * Let the page cache read ahead by at least a full TX queue, so
+	 * vfs_read() into the next free buffer finds its pages cached or
+	 * already under I/O while the queued buffers are on the wire.
+	 */
+	ra_pages = (dev->tx_reqs * dev->tx_req_len) >> PAGE_CACHE_SHIFT;
+	spin_lock(&filp->f_lock);
+	if (filp->f_ra.ra_pages < ra_pages)
+		filp->f_ra.ra_pages = ra_pages;
+	spin_unlock(&filp->f_lock);
+
 	if (dev->xfer_send_header) {
 		hdr_size = sizeof(struct mtp_data_header);
 		count += hdr_size;
@@ -753,8 +823,8 @@ static void send_file_work(struct work_struct *data) {
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 
@@ -804,11 +874,12 @@ static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev	*dev = container_of(data, struct mtp_dev, receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *read_req, *write_req = NULL;
 	struct file *filp;
 	loff_t offset;
-	int64_t count;
-	int ret, cur_buf = 0;
+	int64_t count, unqueued;
+	unsigned head = 0, tail = 0, queued = 0, completed = 0;
+	int ret;
 	int r = 0;
 
 	/* read our parameters */
@@ -819,21 +890,34 @@ static void receive_file_work(struct work_struct *data)
 
 	DBG(cdev,  "receive_file_work(%lld)\n", count);
 
+	/* bytes we have not yet asked the host for */
+	unqueued = count;
+	dev->rx_done = 0;
+
 	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
-
-			read_req->length = (count > MTP_BULK_BUFFER_SIZE
-					? MTP_BULK_BUFFER_SIZE : count);
-			dev->rx_done = 0;
+		/*
+		 * Keep as many OUT requests queued as we have free buffers,
+		 * one being reserved for the data we are about to write out.
+		 * When the length is known we never queue past its end, so
+		 * nothing is left on the endpoint to swallow the next
+		 * command.  If xfer_file_length is 0xFFFFFFFF the transfer
+		 * ends with a short packet, so only one read may be in flight.
+		 */
+		while (unqueued > 0 && queued + (write_req ? 1 : 0) < dev->rx_reqs &&
+		       (count != 0xFFFFFFFF || !queued)) {
+			read_req = dev->rx_req[head];
+			read_req->length = (unqueued > dev->rx_req_len
+					? dev->rx_req_len : unqueued);
 			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
 				dev->state = STATE_ERROR;
-				break;
+				goto out;
 			}
+			head = (head + 1) % dev->rx_reqs;
+			queued++;
+			if (count != 0xFFFFFFFF)
+				unqueued -= read_req->length;
 		}
 
 		if (write_req) {
@@ -849,30 +933,58 @@ static void receive_file_work(struct work_struct *data)
 			write_req = NULL;
 		}
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED) {
-				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
-			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/* short packet is used to signal EOF for sizes > 4 gig */
-				DBG(cdev,  "got short packet\n");
-				count = 0;
-			}
+		/*
+		 * After a short packet the host sends no more data, so the
+		 * reads still queued are taken back at out: rather than
+		 * waited for.
+		 */
+		if (!queued || !count)
+			break;
+
+		/* wait for the oldest read to complete */
+		read_req = dev->rx_req[tail];
+		ret = wait_event_interruptible(dev->read_wq,
+			dev->rx_done != completed || dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED) {
+			r = -ECANCELED;
+			break;
+		}
+		if (dev->rx_done == completed) {
+			r = -EIO;
+			break;
+		}
+		tail = (tail + 1) % dev->rx_reqs;
+		queued--;
+		completed++;
+		if (read_req->status) {
+			r = -EIO;
+			break;
+		}
 
-			write_req = read_req;
-			read_req = NULL;
+		/* if xfer_file_length is 0xFFFFFFFF, then we read until
+		 * we get a zero length packet
+		 */
+		if (count != 0xFFFFFFFF)
+			count -= read_req->actual;
+		if (read_req->actual < read_req->length) {
+			/* short packet is used to signal EOF for sizes > 4 gig */
+			DBG(cdev,  "got short packet\n");
+			count = 0;
+			unqueued = 0;
 		}
+
+		write_req = read_req;
+	}
+
+out:
+	/* take back whatever the host did not fill before we stopped */
+	if (queued) {
+		while (queued--) {
+			usb_ep_dequeue(dev->ep_out, dev->rx_req[tail]);
+			tail = (tail + 1) % dev->rx_reqs;
+			completed++;
+		}
+		wait_event_timeout(dev->read_wq, dev->rx_done == completed, HZ);
 	}
 
 	DBG(cdev,  "receive_file_work returning %d\n", r);
@@ -1196,11 +1308,13 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	int i;
 
 	while ((req = mtp_req_get(dev, &dev->tx_idle)))
-		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
-		mtp_request_free(dev->rx_req[i], dev->ep_out);
+		mtp_request_free(req, dev->ep_in, dev->tx_req_len);
+	for (i = 0; i < dev->rx_reqs; i++) {
+		mtp_request_free(dev->rx_req[i], dev->ep_out, dev->rx_req_len);
+		dev->rx_req[i] = NULL;
+	}
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
-		mtp_request_free(req, dev->ep_intr);
+		mtp_request_free(req, dev->ep_intr, INTR_BUFFER_SIZE);
 	dev->state = STATE_OFFLINE;
 }
 
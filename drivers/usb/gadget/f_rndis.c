@@ -89,6 +89,28 @@ struct f_rndis {
 	atomic_t			notify_count;
 };
 
+/*
+ * Multi-packet transfers: how many RNDIS packet messages we accept from
+ * the host in one transfer, and how many we pack into one transfer to
+ * it.  The latter is also bounded by the MaxTransferSize the host sends
+ * in REMOTE_NDIS_INITIALIZE_MSG and, if nonzero, by
+ * rndis_dl_max_xfer_size.
+ */
+static unsigned int rndis_ul_max_pkt_per_xfer = 3;
+module_param(rndis_ul_max_pkt_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_ul_max_pkt_per_xfer,
+	"max RNDIS packets per transfer from the host");
+
+static unsigned int rndis_dl_max_pkt_per_xfer = 3;
+module_param(rndis_dl_max_pkt_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_dl_max_pkt_per_xfer,
+	"max RNDIS packets per transfer to the host");
+
+static unsigned int rndis_dl_max_xfer_size;
+module_param(rndis_dl_max_xfer_size, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_dl_max_xfer_size,
+	"max bytes per transfer to the host (0 = host's limit)");
+
 static inline struct f_rndis *func_to_rndis(struct usb_function *f)
 {
 	return container_of(f, struct f_rndis, port.func);
@@ -454,6 +476,7 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct f_rndis			*rndis = req->context;
 	int				status;
+	u32				dl_max_xfer_size;
 
 	/* received RNDIS command from USB_CDC_SEND_ENCAPSULATED_COMMAND */
 //	spin_lock(&dev->lock);
@@ -462,6 +485,12 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 		pr_err("RNDIS command error %d, %d/%d\n",
 			status, req->actual, req->length);
 //	spin_unlock(&dev->lock);
+
+	/* REMOTE_NDIS_INITIALIZE_MSG tells how much the host will take */
+	dl_max_xfer_size = rndis_get_dl_max_xfer_size(rndis->config);
+	if (rndis_dl_max_xfer_size && dl_max_xfer_size > rndis_dl_max_xfer_size)
+		dl_max_xfer_size = rndis_dl_max_xfer_size;
+	rndis->port.dl_max_xfer_size = dl_max_xfer_size;
 }
 
 static int
@@ -774,6 +803,10 @@ rndis_bind(struct usb_configuration *c, struct usb_function *f)
 	rndis_set_param_medium(rndis->config, NDIS_MEDIUM_802_3, 0);
 	rndis_set_host_mac(rndis->config, rndis->ethaddr);
 
+	rndis->port.ul_max_pkts_per_xfer = max(rndis_ul_max_pkt_per_xfer, 1U);
+	rndis->port.dl_max_pkts_per_xfer = rndis_dl_max_pkt_per_xfer;
+	rndis_set_max_pkt_xfer(rndis->config, rndis->port.ul_max_pkts_per_xfer);
+
 	if (rndis_set_param_vendor(rndis->config, rndis->vendorID,
 				   rndis->manufacturer))
 			goto fail;
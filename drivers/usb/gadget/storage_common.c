@@ -250,6 +250,7 @@ struct fsg_lun {
 	unsigned int	registered:1;
 	unsigned int	info_valid:1;
 	unsigned int	nofua:1;
+	unsigned int	nocache:1;
 
 	u32		sense_data;
 	u32		sense_data_info;
@@ -270,9 +271,6 @@ static struct fsg_lun *fsg_lun_from_dev(struct device *dev)
 #define EP0_BUFSIZE	256
 #define DELAYED_STATUS	(EP0_BUFSIZE + 999)	/* An impossibly large value */
 
-/* Number of buffers we will use.  2 is enough for double-buffering */
-#define FSG_NUM_BUFFERS	2
-
 /* Default size of buffer length. */
 #define FSG_BUFLEN	((u32)16384)
 
@@ -28,6 +28,7 @@
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
+#include <linux/hrtimer.h>
 
 #include "u_ether.h"
 
@@ -70,6 +71,17 @@ struct eth_dev {
 	atomic_t		tx_qlen;
 
 	struct sk_buff_head	rx_frames;
+	struct napi_struct	napi;
+	unsigned		ul_max_pkts;
+
+	/* multi-packet TX, used only while tx_agg_bufsize is nonzero */
+	spinlock_t		tx_agg_lock;	/* guard the tx_agg* state */
+	struct usb_request	*tx_agg;	/* request being filled */
+	unsigned		tx_agg_pkts;
+	bool			tx_agg_stopped;	/* link going away */
+	unsigned		tx_agg_max_pkts;
+	unsigned		tx_agg_bufsize;
+	struct hrtimer		tx_agg_timer;
 
 	unsigned		header_len;
 	struct sk_buff		*(*wrap)(struct gether *, struct sk_buff *skb);
@@ -92,6 +104,16 @@ struct eth_dev {
 
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
+/* frames waiting for eth_poll(); beyond this, rx requests are parked */
+#define RX_BACKLOG	256
+
+#define ETH_NAPI_WEIGHT	64
+
+/* longest a partly filled multi-packet TX request waits for company */
+static unsigned tx_flush_usecs = 200;
+module_param(tx_flush_usecs, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(tx_flush_usecs, "multi-packet TX flush delay (usecs)");
+
 
 #ifdef CONFIG_USB_GADGET_DUALSPEED
 
@@ -241,6 +263,10 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
+	/* room for a whole batch if the host aggregates frames */
+	if (dev->ul_max_pkts > 1)
+		size *= dev->ul_max_pkts;
+
 	if (dev->port_usb->is_fixed)
 		size = max_t(size_t, size, dev->port_usb->fixed_out_len);
 
@@ -278,7 +304,7 @@ enomem:
 
 static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context, *skb2;
+	struct sk_buff	*skb = req->context;
 	struct eth_dev	*dev = ep->driver_data;
 	int		status = req->status;
 
@@ -306,28 +332,13 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 		}
 		skb = NULL;
 
-		skb2 = skb_dequeue(&dev->rx_frames);
-		while (skb2) {
-			if (status < 0
-					|| ETH_HLEN > skb2->len
-					|| skb2->len > ETH_FRAME_LEN) {
-				dev->net->stats.rx_errors++;
-				dev->net->stats.rx_length_errors++;
-				DBG(dev, "rx length %d\n", skb2->len);
-				dev_kfree_skb_any(skb2);
-				goto next_frame;
-			}
-			skb2->protocol = eth_type_trans(skb2, dev->net);
-			dev->net->stats.rx_packets++;
-			dev->net->stats.rx_bytes += skb2->len;
-
-			/* no buffer copies needed, unless hardware can't
-			 * use skb buffers.
-			 */
-			status = netif_rx(skb2);
-next_frame:
-			skb2 = skb_dequeue(&dev->rx_frames);
+		if (status < 0) {
+			dev->net->stats.rx_errors++;
+			DBG(dev, "rx unwrap %d\n", status);
 		}
+
+		/* frames reach the network stack from eth_poll() */
+		napi_schedule(&dev->napi);
 		break;
 
 	/* software-driven interface shutdown */
@@ -357,7 +368,12 @@ quiesce:
 
 	if (skb)
 		dev_kfree_skb_any(skb);
-	if (!netif_running(dev->net)) {
+	if (!netif_running(dev->net))
+		skb_queue_purge(&dev->rx_frames);
+
+	/* stop refilling while eth_poll() is behind; it refills later */
+	if (!netif_running(dev->net) ||
+			skb_queue_len(&dev->rx_frames) >= RX_BACKLOG) {
 clean:
 		spin_lock(&dev->req_lock);
 		list_add(&req->list, &dev->rx_reqs);
@@ -462,6 +478,44 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+/*
+ * NAPI poll: rx_complete() only unwraps transfers into rx_frames, and
+ * the frames are handed to the network stack here, a budget at a time.
+ */
+static int eth_poll(struct napi_struct *napi, int budget)
+{
+	struct eth_dev	*dev = container_of(napi, struct eth_dev, napi);
+	struct sk_buff	*skb;
+	int		work = 0;
+
+	while (work < budget && (skb = skb_dequeue(&dev->rx_frames))) {
+		work++;
+		if (ETH_HLEN > skb->len || skb->len > ETH_FRAME_LEN) {
+			dev->net->stats.rx_errors++;
+			dev->net->stats.rx_length_errors++;
+			DBG(dev, "rx length %d\n", skb->len);
+			dev_kfree_skb_any(skb);
+			continue;
+		}
+		skb->protocol = eth_type_trans(skb, dev->net);
+		dev->net->stats.rx_packets++;
+		dev->net->stats.rx_bytes += skb->len;
+		napi_gro_receive(napi, skb);
+	}
+
+	/* requeue any requests rx_complete() parked for us */
+	if (!list_empty(&dev->rx_reqs) &&
+			skb_queue_len(&dev->rx_frames) < RX_BACKLOG / 2)
+		rx_fill(dev, GFP_ATOMIC);
+
+	if (work < budget) {
+		napi_complete(napi);
+		if (!skb_queue_empty(&dev->rx_frames))
+			napi_schedule(napi);
+	}
+	return work;
+}
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context;
@@ -490,6 +544,223 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 		netif_wake_queue(dev->net);
 }
 
+/*
+ * Multi-packet TX.  When the function allows it (RNDIS), wrapped frames
+ * are copied back to back into a preallocated request buffer instead of
+ * being sent one skb per request.  A partly filled request (tx_agg) is
+ * sent when the next frame doesn't fit, when it holds the maximum number
+ * of frames, when no other transfer is in flight, when a transfer
+ * completes, or at the latest after tx_flush_usecs.
+ *
+ * Everything that sends tx_agg holds tx_agg_lock across usb_ep_queue(),
+ * so transfers go out in the order their frames were queued.
+ */
+static void tx_agg_send(struct eth_dev *dev)
+{
+	struct usb_request	*req = dev->tx_agg;
+	unsigned		pkts = dev->tx_agg_pkts;
+	struct usb_ep		*in = NULL;
+	int			retval = -ENOTCONN;
+
+	dev->tx_agg = NULL;
+	dev->tx_agg_pkts = 0;
+
+	spin_lock(&dev->lock);
+	if (dev->port_usb)
+		in = dev->port_usb->in_ep;
+	spin_unlock(&dev->lock);
+
+	if (in) {
+		/* same zlp framing as single frames; the buffer has
+		 * room for the extra byte.
+		 */
+		req->zero = 1;
+		if (!dev->zlp && (req->length % in->maxpacket) == 0)
+			req->length++;
+
+		retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	}
+
+	if (retval) {
+		DBG(dev, "tx queue err %d\n", retval);
+		dev->net->stats.tx_dropped += pkts;
+		spin_lock(&dev->req_lock);
+		if (list_empty(&dev->tx_reqs))
+			netif_start_queue(dev->net);
+		list_add(&req->list, &dev->tx_reqs);
+		spin_unlock(&dev->req_lock);
+		return;
+	}
+
+	dev->net->trans_start = jiffies;
+	dev->net->stats.tx_packets += pkts;
+	atomic_inc(&dev->tx_qlen);
+}
+
+static void tx_agg_flush(struct eth_dev *dev)
+{
+	unsigned long	flags;
+
+	spin_lock_irqsave(&dev->tx_agg_lock, flags);
+	if (dev->tx_agg)
+		tx_agg_send(dev);
+	spin_unlock_irqrestore(&dev->tx_agg_lock, flags);
+}
+
+static enum hrtimer_restart tx_agg_timeout(struct hrtimer *timer)
+{
+	tx_agg_flush(container_of(timer, struct eth_dev, tx_agg_timer));
+	return HRTIMER_NORESTART;
+}
+
+static void tx_agg_complete(struct usb_ep *ep, struct usb_request *req)
+{
+	struct eth_dev	*dev = ep->driver_data;
+	unsigned long	flags;
+
+	switch (req->status) {
+	default:
+		dev->net->stats.tx_errors++;
+		VDBG(dev, "tx err %d\n", req->status);
+		/* FALLTHROUGH */
+	case -ECONNRESET:		/* unlink */
+	case -ESHUTDOWN:		/* disconnect etc */
+		break;
+	case 0:
+		dev->net->stats.tx_bytes += req->actual;
+	}
+
+	spin_lock(&dev->req_lock);
+	list_add(&req->list, &dev->tx_reqs);
+	spin_unlock(&dev->req_lock);
+
+	atomic_dec(&dev->tx_qlen);
+
+	/* the link can take more; send what has been collected.  If
+	 * the lock is busy, whoever holds it is already sending (this
+	 * may even be a completion from within their usb_ep_queue()).
+	 */
+	if (req->status == 0 &&
+			spin_trylock_irqsave(&dev->tx_agg_lock, flags)) {
+		if (dev->tx_agg)
+			tx_agg_send(dev);
+		spin_unlock_irqrestore(&dev->tx_agg_lock, flags);
+	}
+
+	if (netif_carrier_ok(dev->net))
+		netif_wake_queue(dev->net);
+}
+
+static netdev_tx_t tx_agg_xmit(struct eth_dev *dev, struct sk_buff *skb)
+{
+	struct usb_request	*req;
+	unsigned long		flags;
+	unsigned		max_size = 0;
+	unsigned		max_pkts = 1;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->port_usb) {
+		if (dev->wrap)
+			skb = dev->wrap(dev->port_usb, skb);
+		max_size = dev->port_usb->dl_max_xfer_size;
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+	if (!skb || skb->len > dev->tx_agg_bufsize) {
+		dev_kfree_skb_any(skb);
+		dev->net->stats.tx_dropped++;
+		return NETDEV_TX_OK;
+	}
+
+	/* until the host reports its limit, send one frame per transfer */
+	if (max_size)
+		max_pkts = dev->tx_agg_max_pkts;
+	if (!max_size || max_size > dev->tx_agg_bufsize)
+		max_size = dev->tx_agg_bufsize;
+
+	spin_lock_irqsave(&dev->tx_agg_lock, flags);
+	/* gether_disconnect() is tearing the requests down */
+	if (dev->tx_agg_stopped) {
+		spin_unlock_irqrestore(&dev->tx_agg_lock, flags);
+		dev_kfree_skb_any(skb);
+		dev->net->stats.tx_dropped++;
+		return NETDEV_TX_OK;
+	}
+
+	if (dev->tx_agg && dev->tx_agg->length + skb->len > max_size)
+		tx_agg_send(dev);
+
+	if (!dev->tx_agg) {
+		spin_lock(&dev->req_lock);
+		/* see eth_start_xmit() */
+		if (list_empty(&dev->tx_reqs)) {
+			spin_unlock(&dev->req_lock);
+			spin_unlock_irqrestore(&dev->tx_agg_lock, flags);
+			dev_kfree_skb_any(skb);
+			dev->net->stats.tx_dropped++;
+			return NETDEV_TX_OK;
+		}
+		req = container_of(dev->tx_reqs.next, struct usb_request, list);
+		list_del(&req->list);
+		if (list_empty(&dev->tx_reqs))
+			netif_stop_queue(dev->net);
+		spin_unlock(&dev->req_lock);
+
+		req->length = 0;
+		dev->tx_agg = req;
+	}
+
+	req = dev->tx_agg;
+	memcpy(req->buf + req->length, skb->data, skb->len);
+	req->length += skb->len;
+	dev->tx_agg_pkts++;
+
+	if (dev->tx_agg_pkts >= max_pkts || !atomic_read(&dev->tx_qlen))
+		tx_agg_send(dev);
+	else if (!hrtimer_is_queued(&dev->tx_agg_timer))
+		hrtimer_start(&dev->tx_agg_timer,
+				ktime_set(0, tx_flush_usecs * NSEC_PER_USEC),
+				HRTIMER_MODE_REL);
+	spin_unlock_irqrestore(&dev->tx_agg_lock, flags);
+
+	dev_kfree_skb_any(skb);
+	return NETDEV_TX_OK;
+}
+
+/* give each TX request its own buffer; called with irqs blocked */
+static int tx_agg_alloc(struct eth_dev *dev, struct gether *link)
+{
+	struct usb_request	*req;
+	unsigned		size;
+
+	size = link->dl_max_pkts_per_xfer *
+		(dev->net->mtu + ETH_HLEN + link->header_len);
+
+	spin_lock(&dev->req_lock);
+	list_for_each_entry(req, &dev->tx_reqs, list)
+		req->buf = NULL;
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		/* one spare byte for zlp framing */
+		req->buf = kmalloc(size + 1, GFP_ATOMIC);
+		if (!req->buf)
+			goto fail;
+		req->complete = tx_agg_complete;
+		req->context = NULL;
+	}
+	spin_unlock(&dev->req_lock);
+
+	dev->tx_agg_bufsize = size;
+	dev->tx_agg_max_pkts = link->dl_max_pkts_per_xfer;
+	return 0;
+
+fail:
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		kfree(req->buf);
+		req->buf = NULL;
+	}
+	spin_unlock(&dev->req_lock);
+	return -ENOMEM;
+}
+
 static inline int is_promisc(u16 cdc_filter)
 {
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
@@ -543,6 +814,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	if (dev->tx_agg_bufsize)
+		return tx_agg_xmit(dev, skb);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -649,6 +923,7 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	napi_enable(&dev->napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
 
@@ -668,6 +943,8 @@ static int eth_stop(struct net_device *net)
 
 	VDBG(dev, "%s\n", __func__);
 	netif_stop_queue(net);
+	napi_disable(&dev->napi);
+	skb_queue_purge(&dev->rx_frames);
 
 	DBG(dev, "stop stats: rx/tx %ld/%ld, errs %ld/%ld\n",
 		dev->net->stats.rx_packets, dev->net->stats.tx_packets,
@@ -807,6 +1084,10 @@ int gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 
 	skb_queue_head_init(&dev->rx_frames);
 
+	spin_lock_init(&dev->tx_agg_lock);
+	hrtimer_init(&dev->tx_agg_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->tx_agg_timer.function = tx_agg_timeout;
+
 	/* network device setup */
 	dev->net = net;
 	snprintf(net->name, sizeof(net->name), "%s%%d", netname);
@@ -822,6 +1103,7 @@ int gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 		memcpy(ethaddr, dev->host_mac, ETH_ALEN);
 
 	net->netdev_ops = &eth_netdev_ops;
+	netif_napi_add(net, &dev->napi, eth_poll, ETH_NAPI_WEIGHT);
 
 	SET_ETHTOOL_OPS(net, &ops);
 
@@ -915,6 +1197,12 @@ struct net_device *gether_connect(struct gether *link)
 		dev->zlp = link->is_zlp_ok;
 		DBG(dev, "qlen %d\n", qlen(dev->gadget));
 
+		dev->ul_max_pkts = link->ul_max_pkts_per_xfer;
+		/* without the buffers, fall back to one frame per request */
+		dev->tx_agg_stopped = false;
+		if (link->dl_max_pkts_per_xfer > 1 && tx_agg_alloc(dev, link))
+			DBG(dev, "no multi-packet tx buffers\n");
+
 		dev->header_len = link->header_len;
 		dev->unwrap = link->unwrap;
 		dev->wrap = link->wrap;
@@ -973,6 +1261,23 @@ void gether_disconnect(struct gether *link)
 	netif_stop_queue(dev->net);
 	netif_carrier_off(dev->net);
 
+	/* drop any partly filled multi-packet request.  Once stopped,
+	 * eth_start_xmit() can't start another one, so no request
+	 * is held back from tx_reqs while they are freed below.
+	 */
+	spin_lock(&dev->tx_agg_lock);
+	dev->tx_agg_stopped = true;
+	if (dev->tx_agg) {
+		dev->net->stats.tx_dropped += dev->tx_agg_pkts;
+		spin_lock(&dev->req_lock);
+		list_add(&dev->tx_agg->list, &dev->tx_reqs);
+		spin_unlock(&dev->req_lock);
+		dev->tx_agg = NULL;
+		dev->tx_agg_pkts = 0;
+	}
+	spin_unlock(&dev->tx_agg_lock);
+	hrtimer_cancel(&dev->tx_agg_timer);
+
 	/* disable endpoints, forcing (synchronous) completion
 	 * of all pending i/o.  then free the request objects
 	 * and forget about the endpoints.
@@ -985,10 +1290,13 @@ void gether_disconnect(struct gether *link)
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
+		if (dev->tx_agg_bufsize)
+			kfree(req->buf);
 		usb_ep_free_request(link->in_ep, req);
 		spin_lock(&dev->req_lock);
 	}
 	spin_unlock(&dev->req_lock);
+	dev->tx_agg_bufsize = 0;
 	link->in_ep->driver_data = NULL;
 	link->in_ep->desc = NULL;
 
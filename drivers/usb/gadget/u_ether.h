@@ -62,6 +62,13 @@ struct gether {
 	bool				is_fixed;
 	u32				fixed_out_len;
 	u32				fixed_in_len;
+	/* multi-packet transfers; 0 or 1 means one frame per request.
+	 * dl_max_xfer_size may be updated once the host reports its
+	 * limit; until then downlink frames are not aggregated.
+	 */
+	u32				ul_max_pkts_per_xfer;
+	u32				dl_max_pkts_per_xfer;
+	u32				dl_max_xfer_size;
 	struct sk_buff			*(*wrap)(struct gether *port,
 						struct sk_buff *skb);
 	int				(*unwrap)(struct gether *port,
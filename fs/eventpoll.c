@@ -88,7 +88,12 @@
  */
 
 /* Epoll private bits inside the event mask */
-#define EP_PRIVATE_BITS (EPOLLONESHOT | EPOLLET)
+#define EP_PRIVATE_BITS (EPOLLONESHOT | EPOLLET | EPOLLEXCLUSIVE)
+
+#define EPOLLINOUT_BITS (POLLIN | POLLOUT)
+
+#define EPOLLEXCLUSIVE_OK_BITS (EPOLLINOUT_BITS | POLLERR | POLLHUP | \
+				EPOLLET | EPOLLEXCLUSIVE)
 
 /* Maximum number of nesting allowed inside epoll sets */
 #define EP_MAX_NESTS 4
@@ -819,10 +824,16 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
  * This is the callback that is passed to the wait queue wakeup
  * mechanism. It is called by the stored file descriptors when they
  * have events to report.
+ *
+ * For an EPOLLEXCLUSIVE item the wait queue entry is exclusive, and the
+ * return value tells __wake_up_common() whether this wakeup was used up:
+ * it is only if a task was actually waiting on this epoll instance, so
+ * that an event nobody is waiting for here moves on to the next one.
  */
 static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *key)
 {
 	int pwake = 0;
+	int ewake = 0;
 	unsigned long flags;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
@@ -869,8 +880,10 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
 	 * wait list.
 	 */
-	if (waitqueue_active(&ep->wq))
+	if (waitqueue_active(&ep->wq)) {
+		ewake = 1;
 		wake_up_locked(&ep->wq);
+	}
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
 
@@ -881,6 +894,9 @@ out_unlock:
 	if (pwake)
 		ep_poll_safewake(&ep->poll_wait);
 
+	if (epi->event.events & EPOLLEXCLUSIVE)
+		return ewake;
+
 	return 1;
 }
 
@@ -898,7 +914,10 @@ static void ep_ptable_queue_proc(struct file *file, wait_queue_head_t *whead,
 		init_waitqueue_func_entry(&pwq->wait, ep_poll_callback);
 		pwq->whead = whead;
 		pwq->base = epi;
-		add_wait_queue(whead, &pwq->wait);
+		if (epi->event.events & EPOLLEXCLUSIVE)
+			add_wait_queue_exclusive(whead, &pwq->wait);
+		else
+			add_wait_queue(whead, &pwq->wait);
 		list_add_tail(&pwq->llink, &epi->pwqlist);
 		epi->nwait++;
 	} else {
@@ -1350,6 +1369,84 @@ SYSCALL_DEFINE1(epoll_create, int, size)
 	return sys_epoll_create1(0);
 }
 
+/*
+ * Checks an epoll_ctl(2) operation on the target file "tfile" before any
+ * lock is taken. "file" must already be known to be an eventpoll file.
+ */
+static int ep_ctl_check(struct file *file, struct file *tfile, int op,
+			struct epoll_event *epds)
+{
+	/* The target file descriptor must support poll */
+	if (!tfile->f_op || !tfile->f_op->poll)
+		return -EPERM;
+
+	/* We do not permit adding an epoll file descriptor inside itself */
+	if (file == tfile)
+		return -EINVAL;
+
+	/*
+	 * epoll adds to the wakeup queue at EPOLL_CTL_ADD time only, so
+	 * EPOLLEXCLUSIVE is not allowed for an EPOLL_CTL_MOD operation.
+	 * Nested exclusive wakeups are not supported either.
+	 */
+	if (ep_op_has_event(op) && (epds->events & EPOLLEXCLUSIVE)) {
+		if (op == EPOLL_CTL_MOD)
+			return -EINVAL;
+		if (op == EPOLL_CTL_ADD && (is_file_epoll(tfile) ||
+				(epds->events & ~EPOLLEXCLUSIVE_OK_BITS)))
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Applies one epoll_ctl(2) operation to the interest set. Must be called
+ * with "mtx" held, and for the insertion of an epoll file also with
+ * "epmutex" held and the loop check done.
+ */
+static int ep_ctl(struct eventpoll *ep, int op, struct file *tfile, int fd,
+		  struct epoll_event *epds)
+{
+	struct epitem *epi;
+	int error;
+
+	/*
+	 * Try to lookup the file inside our RB tree, Since we grabbed "mtx"
+	 * above, we can be sure to be able to use the item looked up by
+	 * ep_find() till we release the mutex.
+	 */
+	epi = ep_find(ep, tfile, fd);
+
+	error = -EINVAL;
+	switch (op) {
+	case EPOLL_CTL_ADD:
+		if (!epi) {
+			epds->events |= POLLERR | POLLHUP;
+			error = ep_insert(ep, epds, tfile, fd);
+		} else
+			error = -EEXIST;
+		break;
+	case EPOLL_CTL_DEL:
+		if (epi)
+			error = ep_remove(ep, epi);
+		else
+			error = -ENOENT;
+		break;
+	case EPOLL_CTL_MOD:
+		if (epi) {
+			if (!(epi->event.events & EPOLLEXCLUSIVE)) {
+				epds->events |= POLLERR | POLLHUP;
+				error = ep_modify(ep, epi, epds);
+			}
+		} else
+			error = -ENOENT;
+		break;
+	}
+
+	return error;
+}
+
 /*
  * The following function implements the controller interface for
  * the eventpoll file that enables the insertion/removal/change of
@@ -1362,7 +1459,6 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	int did_lock_epmutex = 0;
 	struct file *file, *tfile;
 	struct eventpoll *ep;
-	struct epitem *epi;
 	struct epoll_event epds;
 
 	error = -EFAULT;
@@ -1381,18 +1477,16 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	if (!tfile)
 		goto error_fput;
 
-	/* The target file descriptor must support poll */
-	error = -EPERM;
-	if (!tfile->f_op || !tfile->f_op->poll)
-		goto error_tgt_fput;
-
 	/*
 	 * We have to check that the file structure underneath the file descriptor
-	 * the user passed to us _is_ an eventpoll file. And also we do not permit
-	 * adding an epoll file descriptor inside itself.
+	 * the user passed to us _is_ an eventpoll file.
 	 */
 	error = -EINVAL;
-	if (file == tfile || !is_file_epoll(file))
+	if (!is_file_epoll(file))
+		goto error_tgt_fput;
+
+	error = ep_ctl_check(file, tfile, op, &epds);
+	if (error)
 		goto error_tgt_fput;
 
 	/*
@@ -1421,47 +1515,139 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 
 
 	mutex_lock_nested(&ep->mtx, 0);
+	error = ep_ctl(ep, op, tfile, fd, &epds);
+	mutex_unlock(&ep->mtx);
+
+error_tgt_fput:
+	if (unlikely(did_lock_epmutex))
+		mutex_unlock(&epmutex);
+
+	fput(tfile);
+error_fput:
+	fput(file);
+error_return:
+
+	return error;
+}
+
+/*
+ * Batched version of epoll_ctl(2): applies up to EPOLL_CTL_BATCH_MAX
+ * operations on the interest set of "epfd" in order, taking "mtx" only
+ * once for all of them. Processing stops at the first operation that
+ * fails. The result of every operation that was attempted is stored in
+ * its "result" field, and the number of operations that succeeded is
+ * returned.
+ */
+SYSCALL_DEFINE4(epoll_ctl_batch, int, epfd, int, flags, int, ncmds,
+		struct epoll_ctl_cmd __user *, cmds)
+{
+	int i, n, error;
+	int did_lock_epmutex = 0;
+	struct epoll_ctl_cmd *kcmds;
+	struct file **tfiles;
+	struct file *file;
+	struct eventpoll *ep;
+	struct epoll_event epds;
+
+	if (flags || ncmds <= 0 || ncmds > EPOLL_CTL_BATCH_MAX)
+		return -EINVAL;
+
+	error = -ENOMEM;
+	kcmds = kmalloc(ncmds * sizeof(*kcmds), GFP_KERNEL);
+	tfiles = kcalloc(ncmds, sizeof(*tfiles), GFP_KERNEL);
+	if (!kcmds || !tfiles)
+		goto error_free;
+
+	error = -EFAULT;
+	if (copy_from_user(kcmds, cmds, ncmds * sizeof(*kcmds)))
+		goto error_free;
+
+	/* Get the "struct file *" for the eventpoll file */
+	error = -EBADF;
+	file = fget(epfd);
+	if (!file)
+		goto error_free;
+
+	error = -EINVAL;
+	if (!is_file_epoll(file))
+		goto error_fput;
+	ep = file->private_data;
 
 	/*
-	 * Try to lookup the file inside our RB tree, Since we grabbed "mtx"
-	 * above, we can be sure to be able to use the item looked up by
-	 * ep_find() till we release the mutex.
+	 * Look up and check all the targets before taking any lock, so we
+	 * know whether "epmutex" is needed before "mtx" is taken. The batch
+	 * is cut short at the first operation that fails here.
 	 */
-	epi = ep_find(ep, tfile, fd);
+	for (n = 0; n < ncmds; n++) {
+		struct epoll_ctl_cmd *cmd = &kcmds[n];
 
-	error = -EINVAL;
-	switch (op) {
-	case EPOLL_CTL_ADD:
-		if (!epi) {
-			epds.events |= POLLERR | POLLHUP;
-			error = ep_insert(ep, &epds, tfile, fd);
-		} else
-			error = -EEXIST;
-		break;
-	case EPOLL_CTL_DEL:
-		if (epi)
-			error = ep_remove(ep, epi);
-		else
-			error = -ENOENT;
-		break;
-	case EPOLL_CTL_MOD:
-		if (epi) {
-			epds.events |= POLLERR | POLLHUP;
-			error = ep_modify(ep, epi, &epds);
-		} else
-			error = -ENOENT;
-		break;
+		epds.events = cmd->events;
+		epds.data = cmd->data;
+		cmd->result = -EINVAL;
+		if (cmd->flags)
+			break;
+		cmd->result = -EBADF;
+		tfiles[n] = fget(cmd->fd);
+		if (!tfiles[n])
+			break;
+		cmd->result = ep_ctl_check(file, tfiles[n], cmd->op, &epds);
+		if (cmd->result)
+			break;
+		if (unlikely(is_file_epoll(tfiles[n]) &&
+			     cmd->op == EPOLL_CTL_ADD))
+			did_lock_epmutex = 1;
+	}
+
+	/* See sys_epoll_ctl() for why "epmutex" covers the inserts too */
+	if (unlikely(did_lock_epmutex)) {
+		mutex_lock(&epmutex);
+		for (i = 0; i < n; i++) {
+			if (!is_file_epoll(tfiles[i]) ||
+			    kcmds[i].op != EPOLL_CTL_ADD)
+				continue;
+			if (ep_loop_check(ep, tfiles[i]) != 0) {
+				kcmds[i].result = -ELOOP;
+				n = i;
+				break;
+			}
+		}
+	}
+
+	mutex_lock_nested(&ep->mtx, 0);
+	for (i = 0; i < n; i++) {
+		epds.events = kcmds[i].events;
+		epds.data = kcmds[i].data;
+		kcmds[i].result = ep_ctl(ep, kcmds[i].op, tfiles[i],
+					 kcmds[i].fd, &epds);
+		if (kcmds[i].result)
+			break;
 	}
 	mutex_unlock(&ep->mtx);
 
-error_tgt_fput:
 	if (unlikely(did_lock_epmutex))
 		mutex_unlock(&epmutex);
 
-	fput(tfile);
+	/*
+	 * Report back up to the operation that failed, which is either the
+	 * one ep_ctl() failed on or operation n that failed the checks above.
+	 */
+	error = i;
+	n = i < n ? i + 1 : min(n + 1, ncmds);
+	for (i = 0; i < n; i++) {
+		if (put_user(kcmds[i].result, &cmds[i].result)) {
+			error = -EFAULT;
+			break;
+		}
+	}
+
+	for (i = 0; i < ncmds; i++)
+		if (tfiles[i])
+			fput(tfiles[i]);
 error_fput:
 	fput(file);
-error_return:
+error_free:
+	kfree(tfiles);
+	kfree(kcmds);
 
 	return error;
 }
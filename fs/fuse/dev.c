@@ -35,34 +35,55 @@ static struct fuse_conn *fuse_get_conn(struct file *file)
 	return file->private_data;
 }
 
-static void fuse_request_init(struct fuse_req *req)
+static void fuse_request_init(struct fuse_req *req, struct page **pages,
+			      unsigned npages)
 {
 	memset(req, 0, sizeof(*req));
+	memset(pages, 0, sizeof(*pages) * npages);
 	INIT_LIST_HEAD(&req->list);
 	INIT_LIST_HEAD(&req->intr_entry);
 	init_waitqueue_head(&req->waitq);
 	atomic_set(&req->count, 1);
+	req->pages = pages;
+	req->max_pages = npages;
 }
 
-struct fuse_req *fuse_request_alloc(void)
+static struct fuse_req *__fuse_request_alloc(unsigned npages, gfp_t flags)
 {
-	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, GFP_KERNEL);
-	if (req)
-		fuse_request_init(req);
+	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, flags);
+	if (req) {
+		struct page **pages;
+
+		if (npages <= FUSE_REQ_INLINE_PAGES)
+			pages = req->inline_pages;
+		else
+			pages = kmalloc(sizeof(struct page *) * npages, flags);
+
+		if (!pages) {
+			kmem_cache_free(fuse_req_cachep, req);
+			return NULL;
+		}
+
+		fuse_request_init(req, pages, npages);
+	}
 	return req;
 }
+
+struct fuse_req *fuse_request_alloc(unsigned npages)
+{
+	return __fuse_request_alloc(npages, GFP_KERNEL);
+}
 EXPORT_SYMBOL_GPL(fuse_request_alloc);
 
-struct fuse_req *fuse_request_alloc_nofs(void)
+struct fuse_req *fuse_request_alloc_nofs(unsigned npages)
 {
-	struct fuse_req *req = kmem_cache_alloc(fuse_req_cachep, GFP_NOFS);
-	if (req)
-		fuse_request_init(req);
-	return req;
+	return __fuse_request_alloc(npages, GFP_NOFS);
 }
 
 void fuse_request_free(struct fuse_req *req)
 {
+	if (req->pages != req->inline_pages)
+		kfree(req->pages);
 	kmem_cache_free(fuse_req_cachep, req);
 }
 
@@ -98,7 +119,7 @@ static void fuse_req_init_context(struct fuse_req *req)
 	req->in.h.pid = current->pid;
 }
 
-struct fuse_req *fuse_get_req(struct fuse_conn *fc)
+struct fuse_req *fuse_get_req(struct fuse_conn *fc, unsigned npages)
 {
 	struct fuse_req *req;
 	sigset_t oldset;
@@ -117,7 +138,7 @@ struct fuse_req *fuse_get_req(struct fuse_conn *fc)
 	if (!fc->connected)
 		goto out;
 
-	req = fuse_request_alloc();
+	req = fuse_request_alloc(npages);
 	err = -ENOMEM;
 	if (!req)
 		goto out;
@@ -167,7 +188,7 @@ static void put_reserved_req(struct fuse_conn *fc, struct fuse_req *req)
 	struct fuse_file *ff = file->private_data;
 
 	spin_lock(&fc->lock);
-	fuse_request_init(req);
+	fuse_request_init(req, req->pages, req->max_pages);
 	BUG_ON(ff->reserved_req);
 	ff->reserved_req = req;
 	wake_up_all(&fc->reserved_req_waitq);
@@ -194,7 +215,7 @@ struct fuse_req *fuse_get_req_nofail(struct fuse_conn *fc, struct file *file)
 
 	atomic_inc(&fc->num_waiting);
 	wait_event(fc->blocked_waitq, !fc->blocked);
-	req = fuse_request_alloc();
+	req = fuse_request_alloc(0);
 	if (!req)
 		req = get_reserved_req(fc, file);
 
@@ -540,6 +561,7 @@ struct fuse_copy_state {
 	struct pipe_buffer *currbuf;
 	struct pipe_inode_info *pipe;
 	unsigned long nr_segs;
+	unsigned long max_segs;
 	unsigned long seglen;
 	unsigned long addr;
 	struct page *pg;
@@ -614,7 +636,7 @@ static int fuse_copy_fill(struct fuse_copy_state *cs)
 		} else {
 			struct page *page;
 
-			if (cs->nr_segs == cs->pipe->buffers)
+			if (cs->nr_segs == cs->max_segs)
 				return -EIO;
 
 			page = alloc_page(GFP_HIGHUSER);
@@ -684,8 +706,11 @@ static int fuse_check_page(struct page *page)
 	       1 << PG_lru |
 	       1 << PG_active |
 	       1 << PG_reclaim))) {
-		printk(KERN_WARNING "fuse: trying to steal weird page\n");
-		printk(KERN_WARNING "  page=%p index=%li flags=%08lx, count=%i, mapcount=%i, mapping=%p\n", page, page->index, page->flags, page_count(page), page_mapcount(page), page->mapping);
+		/* not fatal, the data gets copied instead */
+		if (printk_ratelimit()) {
+			printk(KERN_WARNING "fuse: trying to steal weird page\n");
+			printk(KERN_WARNING "  page=%p index=%li flags=%08lx, count=%i, mapcount=%i, mapping=%p\n", page, page->index, page->flags, page_count(page), page_mapcount(page), page->mapping);
+		}
 		return 1;
 	}
 	return 0;
@@ -794,7 +819,7 @@ static int fuse_ref_page(struct fuse_copy_state *cs, struct page *page,
 {
 	struct pipe_buffer *buf;
 
-	if (cs->nr_segs == cs->pipe->buffers)
+	if (cs->nr_segs == cs->max_segs)
 		return -EIO;
 
 	unlock_request(cs->fc, cs->req);
@@ -826,15 +851,27 @@ static int fuse_copy_page(struct fuse_copy_state *cs, struct page **pagep,
 	if (page && zeroing && count < PAGE_SIZE)
 		clear_highpage(page);
 
+	if (page && cs->write) {
+		if (cs->pipebufs) {
+			err = fuse_ref_page(cs, page, offset, count);
+			if (!err)
+				atomic_long_inc(&cs->fc->pages_spliced);
+			return err;
+		}
+		atomic_long_inc(&cs->fc->pages_copied_out);
+	}
+
 	while (count) {
-		if (cs->write && cs->pipebufs && page) {
-			return fuse_ref_page(cs, page, offset, count);
-		} else if (!cs->len) {
+		if (!cs->len) {
 			if (cs->move_pages && page &&
 			    offset == 0 && count == PAGE_SIZE) {
 				err = fuse_try_move_page(cs, pagep);
-				if (err <= 0)
+				if (err < 0)
 					return err;
+				if (!err) {
+					atomic_long_inc(&cs->fc->pages_stolen);
+					return 0;
+				}
 			} else {
 				err = fuse_copy_fill(cs);
 				if (err)
@@ -849,8 +886,10 @@ static int fuse_copy_page(struct fuse_copy_state *cs, struct page **pagep,
 		} else
 			offset += fuse_copy_do(cs, NULL, &count);
 	}
-	if (page && !cs->write)
+	if (page && !cs->write) {
 		flush_dcache_page(page);
+		atomic_long_inc(&cs->fc->pages_copied_in);
+	}
 	return 0;
 }
 
@@ -1226,19 +1265,32 @@ static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
 	int ret;
 	int page_nr = 0;
 	int do_wakeup = 0;
+	unsigned nbufs;
 	struct pipe_buffer *bufs;
 	struct fuse_copy_state cs;
 	struct fuse_conn *fc = fuse_get_conn(in);
 	if (!fc)
 		return -EPERM;
 
-	bufs = kmalloc(pipe->buffers * sizeof(struct pipe_buffer), GFP_KERNEL);
+	/*
+	 * Only fill as many buffers as the pipe has room for.  A request
+	 * that doesn't fit then fails when it is copied, instead of being
+	 * taken off the queue and dropped when the pipe is found full.
+	 * The pipe may grow once the lock is dropped, so bufs is sized
+	 * from this snapshot rather than from pipe->buffers.
+	 */
+	pipe_lock(pipe);
+	nbufs = pipe->buffers - pipe->nrbufs;
+	pipe_unlock(pipe);
+
+	bufs = kmalloc(nbufs * sizeof(struct pipe_buffer), GFP_KERNEL);
 	if (!bufs)
 		return -ENOMEM;
 
 	fuse_copy_init(&cs, fc, 1, NULL, 0);
 	cs.pipebufs = bufs;
 	cs.pipe = pipe;
+	cs.max_segs = nbufs;
 	ret = fuse_dev_do_read(fc, in, &cs, len);
 	if (ret < 0)
 		goto out;
@@ -1494,13 +1546,24 @@ static int fuse_retrieve(struct fuse_conn *fc, struct inode *inode,
 	unsigned int num;
 	unsigned int offset;
 	size_t total_len = 0;
+	unsigned int num_pages;
+
+	offset = outarg->offset & ~PAGE_CACHE_MASK;
+	file_size = i_size_read(inode);
 
-	req = fuse_get_req(fc);
+	num = outarg->size;
+	if (outarg->offset > file_size)
+		num = 0;
+	else if (outarg->offset + num > file_size)
+		num = file_size - outarg->offset;
+
+	num_pages = (num + offset + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	num_pages = min(num_pages, fc->max_pages);
+
+	req = fuse_get_req(fc, num_pages);
 	if (IS_ERR(req))
 		return PTR_ERR(req);
 
-	offset = outarg->offset & ~PAGE_CACHE_MASK;
-
 	req->in.h.opcode = FUSE_NOTIFY_REPLY;
 	req->in.h.nodeid = outarg->nodeid;
 	req->in.numargs = 2;
@@ -1509,14 +1572,8 @@ static int fuse_retrieve(struct fuse_conn *fc, struct inode *inode,
 	req->end = fuse_retrieve_end;
 
 	index = outarg->offset >> PAGE_CACHE_SHIFT;
-	file_size = i_size_read(inode);
-	num = outarg->size;
-	if (outarg->offset > file_size)
-		num = 0;
-	else if (outarg->offset + num > file_size)
-		num = file_size - outarg->offset;
 
-	while (num && req->num_pages < FUSE_MAX_PAGES_PER_REQ) {
+	while (num && req->num_pages < num_pages) {
 		struct page *page;
 		unsigned int this_num;
 
@@ -1585,6 +1642,12 @@ copy_finish:
 static int fuse_notify(struct fuse_conn *fc, enum fuse_notify_code code,
 		       unsigned int size, struct fuse_copy_state *cs)
 {
+	/*
+	 * Don't try to move pages: there is no request to check for
+	 * abort, and a store may target pages that are already mapped.
+	 */
+	cs->move_pages = 0;
+
 	switch (code) {
 	case FUSE_NOTIFY_POLL:
 		return fuse_notify_poll(fc, size, cs);
@@ -1773,11 +1836,14 @@ static ssize_t fuse_dev_splice_write(struct pipe_inode_info *pipe,
 	if (!fc)
 		return -EPERM;
 
+	/* size bufs under the lock, the pipe may grow until it is taken */
+	pipe_lock(pipe);
 	bufs = kmalloc(pipe->buffers * sizeof(struct pipe_buffer), GFP_KERNEL);
-	if (!bufs)
+	if (!bufs) {
+		pipe_unlock(pipe);
 		return -ENOMEM;
+	}
 
-	pipe_lock(pipe);
 	nbuf = 0;
 	rem = 0;
 	for (idx = 0; idx < pipe->nrbufs && rem < len; idx++)
@@ -412,6 +412,7 @@ redo:
 				curbuf = (curbuf + 1) & (pipe->buffers - 1);
 				pipe->curbuf = curbuf;
 				pipe->nrbufs = --bufs;
+				pipe->drained++;
 				do_wakeup = 1;
 			}
 			total_len -= chars;
@@ -599,7 +600,7 @@ redo2:
 			if (!total_len)
 				break;
 		}
-		if (bufs < pipe->buffers)
+		if (bufs < pipe->buffers || pipe_grow(pipe))
 			continue;
 		if (filp->f_flags & O_NONBLOCK) {
 			if (!ret)
@@ -1163,12 +1164,37 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long nr_pages)
 	}
 
 	pipe->curbuf = 0;
+	pipe->drained = 0;
 	kfree(pipe->bufs);
 	pipe->bufs = bufs;
 	pipe->buffers = nr_pages;
 	return nr_pages * PAGE_SIZE;
 }
 
+/**
+ * pipe_grow - make room in a full pipe by growing its ring
+ * @pipe:	the pipe, locked, that a writer found full
+ *
+ * Description:
+ *    If the reader has emptied a whole ring's worth of buffers since a
+ *    writer last found the pipe full, it is the size of the ring rather
+ *    than the reader that holds the writer up, so the ring is doubled,
+ *    up to pipe_max_size. A stalled or slow reader never lets the pipe
+ *    grow, and a pipe sized with F_SETPIPE_SZ keeps its size.
+ *    Returns nonzero if there is room for another buffer now.
+ */
+int pipe_grow(struct pipe_inode_info *pipe)
+{
+	unsigned int drained = pipe->drained;
+
+	pipe->drained = 0;
+	if (pipe->fixed_size || drained < pipe->buffers ||
+	    pipe->buffers * PAGE_SIZE >= pipe_max_size)
+		return 0;
+
+	return pipe_set_size(pipe, pipe->buffers * 2) > 0;
+}
+
 /*
  * Currently we rely on the pipe array holding a power-of-2 number
  * of pages.
@@ -1237,6 +1263,8 @@ long pipe_fcntl(struct file *file, unsigned int cmd, unsigned long arg)
 			goto out;
 		}
 		ret = pipe_set_size(pipe, nr_pages);
+		if (ret > 0)
+			pipe->fixed_size = 1;
 		break;
 		}
 	case F_GETPIPE_SZ:
@@ -25,6 +25,7 @@
 #include <linux/mm_inline.h>
 #include <linux/swap.h>
 #include <linux/writeback.h>
+#include <linux/backing-dev.h>
 #include <linux/buffer_head.h>
 #include <linux/module.h>
 #include <linux/syscalls.h>
@@ -142,13 +143,21 @@ const struct pipe_buf_operations page_cache_pipe_buf_ops = {
 	.get = generic_pipe_buf_get,
 };
 
+/*
+ * buf->private is set for pages that vmsplice_detach() took away from the
+ * process that gifted them. Those are on no LRU list, all others still
+ * are. Until splice_to_pipe() has run vmsplice_detach() on them, the
+ * buffers of a detaching vmsplice hold the user address of their page
+ * there instead, see get_iovec_page_array().
+ */
 static int user_page_pipe_buf_steal(struct pipe_inode_info *pipe,
 				    struct pipe_buffer *buf)
 {
 	if (!(buf->flags & PIPE_BUF_FLAG_GIFT))
 		return 1;
 
-	buf->flags |= PIPE_BUF_FLAG_LRU;
+	if (!buf->private)
+		buf->flags |= PIPE_BUF_FLAG_LRU;
 	return generic_pipe_buf_steal(pipe, buf);
 }
 
@@ -162,6 +171,62 @@ static const struct pipe_buf_operations user_page_pipe_buf_ops = {
 	.get = generic_pipe_buf_get,
 };
 
+static void vmsplice_detach_run(struct pipe_inode_info *pipe, int first,
+				int nr, unsigned long base, struct page **pages)
+{
+	unsigned long detached;
+	int i;
+
+	detach_anon_pages(base, nr, pages, &detached);
+	for (i = 0; i < nr; i++) {
+		int idx = (pipe->curbuf + first + i) & (pipe->buffers - 1);
+
+		pipe->bufs[idx].private = test_bit(i, &detached);
+	}
+}
+
+/*
+ * With SPLICE_F_GIFT | SPLICE_F_MOVE the caller gives its pages away for
+ * good: the last @nr buffers that splice_to_pipe() added to @pipe are
+ * unmapped from the caller, and those whose page the pipe ends up owning
+ * outright get buf->private set, so that they can be moved on to their
+ * destination rather than copied. Only pages that made it into the pipe
+ * are given away, a short or failed splice leaves the rest of the caller's
+ * memory alone. Called with the pipe locked, before readers can get at the
+ * new buffers. See detach_anon_pages().
+ */
+static void vmsplice_detach(struct pipe_inode_info *pipe, int nr)
+{
+	struct page *pages[BITS_PER_LONG];
+	unsigned long base = 0;
+	int i, first = 0, n = 0;
+
+	for (i = pipe->nrbufs - nr; i < pipe->nrbufs; i++) {
+		int idx = (pipe->curbuf + i) & (pipe->buffers - 1);
+		struct pipe_buffer *buf = pipe->bufs + idx;
+		unsigned long addr = buf->private;
+
+		if (n && (n == BITS_PER_LONG ||
+			  addr != base + (n << PAGE_SHIFT))) {
+			vmsplice_detach_run(pipe, first, n, base, pages);
+			n = 0;
+		}
+		if (!n) {
+			first = i;
+			base = addr;
+		}
+		pages[n++] = buf->page;
+	}
+	if (n)
+		vmsplice_detach_run(pipe, first, n, base, pages);
+}
+
+static inline int spd_detach(struct splice_pipe_desc *spd)
+{
+	return spd->ops == &user_page_pipe_buf_ops &&
+		(spd->flags & SPLICE_F_GIFT) && (spd->flags & SPLICE_F_MOVE);
+}
+
 static void wakeup_pipe_readers(struct pipe_inode_info *pipe)
 {
 	smp_mb();
@@ -185,11 +250,13 @@ ssize_t splice_to_pipe(struct pipe_inode_info *pipe,
 		       struct splice_pipe_desc *spd)
 {
 	unsigned int spd_pages = spd->nr_pages;
-	int ret, do_wakeup, page_nr;
+	int ret, do_wakeup, page_nr, detach, undetached;
 
 	ret = 0;
 	do_wakeup = 0;
 	page_nr = 0;
+	detach = spd_detach(spd);
+	undetached = 0;
 
 	pipe_lock(pipe);
 
@@ -215,6 +282,7 @@ ssize_t splice_to_pipe(struct pipe_inode_info *pipe,
 
 			pipe->nrbufs++;
 			page_nr++;
+			undetached += detach;
 			ret += buf->len;
 
 			if (pipe->inode)
@@ -222,12 +290,15 @@ ssize_t splice_to_pipe(struct pipe_inode_info *pipe,
 
 			if (!--spd->nr_pages)
 				break;
-			if (pipe->nrbufs < pipe->buffers)
+			if (pipe->nrbufs < pipe->buffers || pipe_grow(pipe))
 				continue;
 
 			break;
 		}
 
+		if (pipe_grow(pipe))
+			continue;
+
 		if (spd->flags & SPLICE_F_NONBLOCK) {
 			if (!ret)
 				ret = -EAGAIN;
@@ -240,6 +311,11 @@ ssize_t splice_to_pipe(struct pipe_inode_info *pipe,
 			break;
 		}
 
+		if (undetached) {
+			vmsplice_detach(pipe, undetached);
+			undetached = 0;
+		}
+
 		if (do_wakeup) {
 			smp_mb();
 			if (waitqueue_active(&pipe->wait))
@@ -253,6 +329,9 @@ ssize_t splice_to_pipe(struct pipe_inode_info *pipe,
 		pipe->waiting_writers--;
 	}
 
+	if (undetached)
+		vmsplice_detach(pipe, undetached);
+
 	pipe_unlock(pipe);
 
 	if (do_wakeup)
@@ -271,15 +350,20 @@ void spd_release_page(struct splice_pipe_desc *spd, unsigned int i)
 
 /*
  * Check if we need to grow the arrays holding pages and partial page
- * descriptions.
+ * descriptions. The pipe may be resized while the caller fills them, so
+ * their size is recorded in spd->nr_pages_max and must be used instead of
+ * pipe->buffers from here on.
  */
 int splice_grow_spd(struct pipe_inode_info *pipe, struct splice_pipe_desc *spd)
 {
-	if (pipe->buffers <= PIPE_DEF_BUFFERS)
+	unsigned int buffers = ACCESS_ONCE(pipe->buffers);
+
+	spd->nr_pages_max = buffers;
+	if (buffers <= PIPE_DEF_BUFFERS)
 		return 0;
 
-	spd->pages = kmalloc(pipe->buffers * sizeof(struct page *), GFP_KERNEL);
-	spd->partial = kmalloc(pipe->buffers * sizeof(struct partial_page), GFP_KERNEL);
+	spd->pages = kmalloc(buffers * sizeof(struct page *), GFP_KERNEL);
+	spd->partial = kmalloc(buffers * sizeof(struct partial_page), GFP_KERNEL);
 
 	if (spd->pages && spd->partial)
 		return 0;
@@ -289,10 +373,9 @@ int splice_grow_spd(struct pipe_inode_info *pipe, struct splice_pipe_desc *spd)
 	return -ENOMEM;
 }
 
-void splice_shrink_spd(struct pipe_inode_info *pipe,
-		       struct splice_pipe_desc *spd)
+void splice_shrink_spd(struct splice_pipe_desc *spd)
 {
-	if (pipe->buffers <= PIPE_DEF_BUFFERS)
+	if (spd->nr_pages_max <= PIPE_DEF_BUFFERS)
 		return;
 
 	kfree(spd->pages);
@@ -326,7 +409,7 @@ __generic_file_splice_read(struct file *in, loff_t *ppos,
 	index = *ppos >> PAGE_CACHE_SHIFT;
 	loff = *ppos & ~PAGE_CACHE_MASK;
 	req_pages = (len + loff + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
-	nr_pages = min(req_pages, pipe->buffers);
+	nr_pages = min(req_pages, spd.nr_pages_max);
 
 	/*
 	 * Lookup the (hopefully) full range of pages we need.
@@ -497,7 +580,7 @@ fill_it:
 	if (spd.nr_pages)
 		error = splice_to_pipe(pipe, &spd);
 
-	splice_shrink_spd(pipe, &spd);
+	splice_shrink_spd(&spd);
 	return error;
 }
 
@@ -608,8 +691,8 @@ ssize_t default_file_splice_read(struct file *in, loff_t *ppos,
 
 	res = -ENOMEM;
 	vec = __vec;
-	if (pipe->buffers > PIPE_DEF_BUFFERS) {
-		vec = kmalloc(pipe->buffers * sizeof(struct iovec), GFP_KERNEL);
+	if (spd.nr_pages_max > PIPE_DEF_BUFFERS) {
+		vec = kmalloc(spd.nr_pages_max * sizeof(struct iovec), GFP_KERNEL);
 		if (!vec)
 			goto shrink_ret;
 	}
@@ -617,7 +700,7 @@ ssize_t default_file_splice_read(struct file *in, loff_t *ppos,
 	offset = *ppos & ~PAGE_CACHE_MASK;
 	nr_pages = (len + offset + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
 
-	for (i = 0; i < nr_pages && i < pipe->buffers && len; i++) {
+	for (i = 0; i < nr_pages && i < spd.nr_pages_max && len; i++) {
 		struct page *page;
 
 		page = alloc_page(GFP_USER);
@@ -665,7 +748,7 @@ ssize_t default_file_splice_read(struct file *in, loff_t *ppos,
 shrink_ret:
 	if (vec != __vec)
 		kfree(vec);
-	splice_shrink_spd(pipe, &spd);
+	splice_shrink_spd(&spd);
 	return res;
 
 err:
@@ -696,6 +779,78 @@ static int pipe_to_sendpage(struct pipe_inode_info *pipe,
 				    sd->len, &pos, more);
 }
 
+/*
+ * Whether @page, held only by a pipe buffer, could go into the page cache
+ * of @mapping as it is.
+ */
+static int pipe_page_can_move(struct page *page, struct address_space *mapping)
+{
+	if (PageHighMem(page) && !(mapping_gfp_mask(mapping) & __GFP_HIGHMEM))
+		return 0;
+
+	return !PageLRU(page) && !page->mapping && !page_mapped(page) &&
+		page_count(page) == 1 && !PageSwapBacked(page) &&
+		!PageCompound(page) && !PagePrivate(page);
+}
+
+/*
+ * Try to insert the page of @buf into the page cache of @mapping at @index,
+ * so that ->write_begin() finds it there and nothing needs to be copied.
+ * Only a whole page that nobody but the pipe references and that is on no
+ * LRU list yet - written to the pipe, or detached by vmsplice - can move,
+ * and only into a file that does dirty accounting, which rules out shmem
+ * and the like, and that takes highmem pages if it is one. Returns 0 if
+ * the page was moved.
+ */
+static int pipe_to_file_move(struct pipe_inode_info *pipe,
+			     struct pipe_buffer *buf,
+			     struct address_space *mapping, pgoff_t index)
+{
+	struct page *page;
+	int ret;
+
+	if (buf->offset || buf->len != PAGE_CACHE_SIZE ||
+	    !mapping_cap_account_dirty(mapping))
+		return -EINVAL;
+
+	page = find_get_page(mapping, index);
+	if (page) {
+		page_cache_release(page);
+		return -EEXIST;
+	}
+
+	/*
+	 * ->steal() may take the page away from where it came from, a page
+	 * cache page out of its file, so check that the page could move
+	 * before stealing it, and again once it is locked.
+	 */
+	page = buf->page;
+	if (!pipe_page_can_move(page, mapping))
+		return -EBUSY;
+
+	if (buf->ops->steal(pipe, buf))
+		return -EBUSY;
+
+	/* ->steal() returned with the page locked */
+	ret = -EBUSY;
+	if ((buf->flags & PIPE_BUF_FLAG_LRU) ||
+	    !pipe_page_can_move(page, mapping))
+		goto out_unlock;
+
+	/*
+	 * The data is all there, and marking the page uptodate keeps a
+	 * reader that finds it before ->write_begin() does from reading
+	 * the old contents from disk into it.
+	 */
+	SetPageUptodate(page);
+	ret = add_to_page_cache_locked(page, mapping, index, GFP_KERNEL);
+	if (!ret)
+		lru_cache_add_file(page);
+out_unlock:
+	unlock_page(page);
+	return ret;
+}
+
 /*
  * This is a little more tricky than the file -> pipe splicing. There are
  * basically three cases:
@@ -712,8 +867,8 @@ static int pipe_to_sendpage(struct pipe_inode_info *pipe,
  * If asked to move pages to the output file (SPLICE_F_MOVE is set in
  * sd->flags), we attempt to migrate pages from the pipe to the output
  * file address space page cache. This is possible if no one else has
- * the pipe page referenced outside of the pipe and page cache. If
- * SPLICE_F_MOVE isn't set, or we cannot move the page, we simply create
+ * the pipe page referenced outside of the pipe, see pipe_to_file_move().
+ * If SPLICE_F_MOVE isn't set, or we cannot move the page, we simply create
  * a new page in the output file page cache and fill/dirty that.
  */
 int pipe_to_file(struct pipe_inode_info *pipe, struct pipe_buffer *buf,
@@ -724,6 +879,7 @@ int pipe_to_file(struct pipe_inode_info *pipe, struct pipe_buffer *buf,
 	unsigned int offset, this_len;
 	struct page *page;
 	void *fsdata;
+	int moved = 0;
 	int ret;
 
 	offset = sd->pos & ~PAGE_CACHE_MASK;
@@ -732,10 +888,19 @@ int pipe_to_file(struct pipe_inode_info *pipe, struct pipe_buffer *buf,
 	if (this_len + offset > PAGE_CACHE_SIZE)
 		this_len = PAGE_CACHE_SIZE - offset;
 
+	if ((sd->flags & SPLICE_F_MOVE) && this_len == PAGE_CACHE_SIZE)
+		moved = !pipe_to_file_move(pipe, buf, mapping,
+					   sd->pos >> PAGE_CACHE_SHIFT);
+
 	ret = pagecache_write_begin(file, mapping, sd->pos, this_len,
 				AOP_FLAG_UNINTERRUPTIBLE, &page, &fsdata);
-	if (unlikely(ret))
+	if (unlikely(ret)) {
+		/* don't leave data in the page cache that never made it */
+		if (moved)
+			truncate_inode_pages_range(mapping, sd->pos,
+					sd->pos + PAGE_CACHE_SIZE - 1);
 		goto out;
+	}
 
 	if (buf->page != page) {
 		/*
@@ -821,6 +986,7 @@ int splice_from_pipe_feed(struct pipe_inode_info *pipe, struct splice_desc *sd,
 			ops->release(pipe, buf);
 			pipe->curbuf = (pipe->curbuf + 1) & (pipe->buffers - 1);
 			pipe->nrbufs--;
+			pipe->drained++;
 			if (pipe->inode)
 				sd->need_wakeup = true;
 		}
@@ -1390,7 +1556,7 @@ static long do_splice(struct file *in, loff_t __user *off_in,
 static int get_iovec_page_array(const struct iovec __user *iov,
 				unsigned int nr_vecs, struct page **pages,
 				struct partial_page *partial, int aligned,
-				unsigned int pipe_buffers)
+				int detach, unsigned int pipe_buffers)
 {
 	int buffers = 0, error = 0;
 
@@ -1450,6 +1616,9 @@ static int get_iovec_page_array(const struct iovec __user *iov,
 
 			partial[buffers].offset = off;
 			partial[buffers].len = plen;
+			/* the user address, see vmsplice_detach() */
+			partial[buffers].private = detach ?
+				(unsigned long) base + (i << PAGE_SHIFT) : 0;
 
 			off = 0;
 			len -= plen;
@@ -1628,13 +1797,15 @@ static long vmsplice_to_pipe(struct file *file, const struct iovec __user *iov,
 
 	spd.nr_pages = get_iovec_page_array(iov, nr_segs, spd.pages,
 					    spd.partial, flags & SPLICE_F_GIFT,
-					    pipe->buffers);
+					    (flags & SPLICE_F_GIFT) &&
+					    (flags & SPLICE_F_MOVE),
+					    spd.nr_pages_max);
 	if (spd.nr_pages <= 0)
 		ret = spd.nr_pages;
 	else
 		ret = splice_to_pipe(pipe, &spd);
 
-	splice_shrink_spd(pipe, &spd);
+	splice_shrink_spd(&spd);
 	return ret;
 }
 
@@ -1773,6 +1944,8 @@ static int opipe_prep(struct pipe_inode_info *pipe, unsigned int flags)
 			ret = -EPIPE;
 			break;
 		}
+		if (pipe_grow(pipe))
+			break;
 		if (flags & SPLICE_F_NONBLOCK) {
 			ret = -EAGAIN;
 			break;
@@ -1866,6 +2039,7 @@ retry:
 			opipe->nrbufs++;
 			ipipe->curbuf = (ipipe->curbuf + 1) & (ipipe->buffers - 1);
 			ipipe->nrbufs--;
+			ipipe->drained++;
 			input_wakeup = true;
 		} else {
 			/*
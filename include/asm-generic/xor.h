@@ -677,6 +677,7 @@ xor_32regs_p_5(unsigned long bytes, unsigned long *p1, unsigned long *p2,
 		goto once_more;
 }
 
+#ifndef NO_TEMPLATE
 static struct xor_block_template xor_block_8regs = {
 	.name = "8regs",
 	.do_2 = xor_8regs_2,
@@ -716,3 +717,4 @@ static struct xor_block_template xor_block_32regs_p = {
 		xor_speed(&xor_block_32regs);	\
 		xor_speed(&xor_block_32regs_p);	\
 	} while (0)
+#endif
@@ -31,6 +31,9 @@ struct blk_trace;
 struct request;
 struct sg_io_hdr;
 struct bsg_job;
+struct blk_mq_ops;
+struct blk_mq_ctx;
+struct blk_mq_hw_ctx;
 
 #define BLKDEV_MIN_RQ	4
 #define BLKDEV_MAX_RQ	128	/* Default maximum */
@@ -82,6 +85,7 @@ struct request {
 	struct call_single_data csd;
 
 	struct request_queue *q;
+	struct blk_mq_ctx *mq_ctx;
 
 	unsigned int cmd_flags;
 	enum rq_cmd_type_bits cmd_type;
@@ -286,6 +290,17 @@ struct request_queue {
 	dma_drain_needed_fn	*dma_drain_needed;
 	lld_busy_fn		*lld_busy_fn;
 
+	/*
+	 * Multi-queue: per-CPU software queues and the hardware queues
+	 * they map to, see include/linux/blk-mq.h.
+	 */
+	struct blk_mq_ops	*mq_ops;
+	unsigned int		*mq_map;
+	struct blk_mq_ctx __percpu *queue_ctx;
+	unsigned int		nr_queues;
+	struct blk_mq_hw_ctx	**queue_hw_ctx;
+	unsigned int		nr_hw_queues;
+
 	/*
 	 * Dispatch queue sorting
 	 */
@@ -868,6 +883,7 @@ extern void blk_put_queue(struct request_queue *);
 struct blk_plug {
 	unsigned long magic;
 	struct list_head list;
+	struct list_head mq_list;	/* requests for multi-queue devices */
 	struct list_head cb_list;
 	unsigned int should_sort;
 };
@@ -902,7 +918,9 @@ static inline bool blk_needs_flush_plug(struct task_struct *tsk)
 {
 	struct blk_plug *plug = tsk->plug;
 
-	return plug && (!list_empty(&plug->list) || !list_empty(&plug->cb_list));
+	return plug && (!list_empty(&plug->list) ||
+			!list_empty(&plug->mq_list) ||
+			!list_empty(&plug->cb_list));
 }
 
 /*
@@ -1143,6 +1161,9 @@ static inline void put_dev_sector(Sector p)
 
 struct work_struct;
 int kblockd_schedule_work(struct request_queue *q, struct work_struct *work);
+int kblockd_schedule_delayed_work(struct request_queue *q,
+				  struct delayed_work *dwork,
+				  unsigned long delay);
 
 #ifdef CONFIG_BLK_CGROUP
 /*
@@ -13,6 +13,14 @@ extern u32  crc32_be(u32 crc, unsigned char const *p, size_t len);
 
 #define crc32(seed, data, length)  crc32_le(seed, (unsigned char const *)(data), length)
 
+/*
+ * This is the same as crc32_le(), but using the Castagnoli polynomial
+ * (0x82f63b78) used by iSCSI, SCTP, btrfs and ext4 metadata checksums.
+ * Most users want the crc32c() wrapper from <linux/crc32c.h> instead,
+ * which may use a hardware accelerated version through the crypto API.
+ */
+extern u32  __crc32c_le(u32 crc, unsigned char const *p, size_t len);
+
 /*
  * Helpers for hash table generation of ethernet nics:
  *
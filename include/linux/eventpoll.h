@@ -26,6 +26,13 @@
 #define EPOLL_CTL_DEL 2
 #define EPOLL_CTL_MOD 3
 
+/*
+ * Request only one of the epoll instances waiting on a shared wakeup
+ * source to be woken up for an event.  Only valid with EPOLL_CTL_ADD,
+ * and only together with POLLIN, POLLOUT, POLLERR, POLLHUP and EPOLLET.
+ */
+#define EPOLLEXCLUSIVE (1 << 28)
+
 /* Set the One Shot behaviour for the target file descriptor */
 #define EPOLLONESHOT (1 << 30)
 
@@ -49,6 +56,23 @@ struct epoll_event {
 	__u64 data;
 } EPOLL_PACKED;
 
+/*
+ * One operation for sys_epoll_ctl_batch().  The layout is the same for
+ * 32 and 64 bit user space, so no compat translation is needed.
+ */
+struct epoll_ctl_cmd {
+	__s32 flags;		/* reserved, must be zero */
+	__s32 op;		/* EPOLL_CTL_ADD, EPOLL_CTL_DEL or EPOLL_CTL_MOD */
+	__s32 fd;		/* target file descriptor */
+	__u32 events;		/* as in struct epoll_event */
+	__u64 data;		/* as in struct epoll_event */
+	__s32 result;		/* set by the kernel: 0 or -errno */
+	__u32 __reserved;
+};
+
+/* Maximum number of operations per sys_epoll_ctl_batch() call */
+#define EPOLL_CTL_BATCH_MAX 256
+
 #ifdef __KERNEL__
 
 /* Forward declarations to avoid compiler errors */
@@ -50,6 +50,15 @@
  *
  * 7.17
  *  - add FUSE_FLOCK_LOCKS and FUSE_RELEASE_FLOCK_UNLOCK
+ *
+ * Backported without a minor version bump, the protocol stays at 7.17:
+ *  - FUSE_WRITEBACK_CACHE and fuse_init_out.time_gran (ignored), as in
+ *    upstream 7.23
+ *  - FUSE_MAX_PAGES and fuse_init_out.max_pages, as in upstream 7.28
+ *  Both are only offered through the INIT flags, with the upstream flag
+ *  bits and fuse_init_out layout, so that 7.18 and later keep their
+ *  upstream meaning.  The INIT reply may stop after max_write as
+ *  before; max_pages is only used if the reply carries it.
  */
 
 #ifndef _LINUX_FUSE_H
@@ -160,6 +169,8 @@ struct fuse_file_lock {
  * FUSE_EXPORT_SUPPORT: filesystem handles lookups of "." and ".."
  * FUSE_DONT_MASK: don't apply umask to file mode on create operations
  * FUSE_FLOCK_LOCKS: remote locking for BSD style file locks
+ * FUSE_WRITEBACK_CACHE: use writeback cache for buffered writes
+ * FUSE_MAX_PAGES: init_out.max_pages contains the max number of req pages
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -169,6 +180,8 @@ struct fuse_file_lock {
 #define FUSE_BIG_WRITES		(1 << 5)
 #define FUSE_DONT_MASK		(1 << 6)
 #define FUSE_FLOCK_LOCKS	(1 << 10)
+#define FUSE_WRITEBACK_CACHE	(1 << 16)
+#define FUSE_MAX_PAGES		(1 << 22)
 
 /**
  * CUSE INIT request/reply flags
@@ -490,6 +503,10 @@ struct fuse_init_out {
 	__u16   max_background;
 	__u16   congestion_threshold;
 	__u32	max_write;
+	__u32	time_gran;
+	__u16	max_pages;
+	__u16	padding;
+	__u32	unused[8];
 };
 
 #define CUSE_INIT_INFO_MAX 4096
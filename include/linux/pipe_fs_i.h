@@ -32,6 +32,8 @@ struct pipe_buffer {
  *	@nrbufs: the number of non-empty pipe buffers in this pipe
  *	@buffers: total number of buffers (should be a power of 2)
  *	@curbuf: the current pipe buffer entry
+ *	@drained: buffers consumed since a writer last found the pipe full
+ *	@fixed_size: the size was set with F_SETPIPE_SZ, don't grow the pipe
  *	@tmp_page: cached released page
  *	@readers: number of current readers of this pipe
  *	@writers: number of current writers of this pipe
@@ -46,6 +48,8 @@ struct pipe_buffer {
 struct pipe_inode_info {
 	wait_queue_head_t wait;
 	unsigned int nrbufs, curbuf, buffers;
+	unsigned int drained;
+	unsigned int fixed_size;
 	unsigned int readers;
 	unsigned int writers;
 	unsigned int waiting_writers;
@@ -147,6 +151,9 @@ int pipe_proc_fn(struct ctl_table *, int, void __user *, size_t *, loff_t *);
 /* Drop the inode semaphore and wait for a pipe event, atomically */
 void pipe_wait(struct pipe_inode_info *pipe);
 
+/* Called by writers that found the pipe full */
+int pipe_grow(struct pipe_inode_info *pipe);
+
 struct pipe_inode_info * alloc_pipe_info(struct inode * inode);
 void free_pipe_info(struct inode * inode);
 void __free_pipe_info(struct pipe_inode_info *);
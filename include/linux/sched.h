@@ -796,6 +796,35 @@ enum cpu_idle_type {
 	CPU_MAX_IDLE_TYPES
 };
 
+/*
+ * Reason codes of the sched_wake_affine, sched_select_task_rq and
+ * sched_load_balance trace events.  'perf sched placement' decodes them
+ * by value, so only ever append.
+ */
+enum sched_wake_affine_reason {
+	WAKE_AFFINE_SYNC,		/* sync wakeup, loads close enough */
+	WAKE_AFFINE_BALANCED,		/* loads within imbalance_pct */
+	WAKE_AFFINE_LIGHT,		/* this_cpu lightly loaded */
+	WAKE_AFFINE_IMBALANCED,		/* left on prev_cpu */
+};
+
+enum sched_select_reason {
+	SELECT_NO_DOMAIN,		/* no domain wanted to balance */
+	SELECT_AFFINE,			/* woken next to the waker */
+	SELECT_PREV,			/* woken next to prev_cpu */
+	SELECT_IDLEST,			/* idlest group/cpu search */
+};
+
+enum sched_lb_reason {
+	LB_NOT_BALANCER,		/* another cpu balances the group */
+	LB_NO_BUSIEST_GROUP,
+	LB_NO_BUSIEST_QUEUE,
+	LB_MOVED,
+	LB_FAILED,
+	LB_ACTIVE,			/* active balance kicked */
+	LB_PINNED,			/* tasks pinned by affinity */
+};
+
 /*
  * Increase resolution of nice-level calculations for 64-bit architectures.
  * The extra resolution improves shares distribution and load balancing of
@@ -1101,6 +1130,7 @@ struct sched_class {
 	void (*post_schedule) (struct rq *this_rq);
 	void (*task_waking) (struct task_struct *task);
 	void (*task_woken) (struct rq *this_rq, struct task_struct *task);
+	void (*migrate_task_rq)(struct task_struct *p, int next_cpu);
 
 	void (*set_cpus_allowed)(struct task_struct *p,
 				 const struct cpumask *newmask);
@@ -1130,6 +1160,27 @@ struct load_weight {
 	unsigned long weight, inv_weight;
 };
 
+/*
+ * Per-entity runnable average.  Time is accounted in ~1us units (1024ns)
+ * and folded into 1024 unit periods; each completed period is decayed by
+ * y, where y^32 = 1/2, so the runnable history halves every ~32ms.
+ */
+struct sched_avg {
+	/*
+	 * runnable_avg_sum is the decayed time spent runnable,
+	 * runnable_avg_period the decayed time it was tracked over;
+	 * their ratio is the fraction of time the entity was runnable.
+	 */
+	u32 runnable_avg_sum, runnable_avg_period;
+	u64 last_runnable_update;
+	/*
+	 * decay_count is the parent cfs_rq's decay_counter at the time the
+	 * entity blocked, or minus the decays it missed while migrating.
+	 */
+	s64 decay_count;
+	unsigned long load_avg_contrib;
+};
+
 #ifdef CONFIG_SCHEDSTATS
 struct sched_statistics {
 	u64			wait_start;
@@ -1190,6 +1241,11 @@ struct sched_entity {
 	/* rq "owned" by this entity/group: */
 	struct cfs_rq		*my_q;
 #endif
+
+#ifdef CONFIG_SMP
+	/* runnable average, used for load-balancing */
+	struct sched_avg	avg;
+#endif
 };
 
 struct sched_rt_entity {
@@ -177,6 +177,139 @@ TRACE_EVENT(sched_migrate_task,
 		  __entry->orig_cpu, __entry->dest_cpu)
 );
 
+/*
+ * Tracepoint for the wake_affine() verdict.  The reason values are
+ * enum sched_wake_affine_reason.
+ */
+TRACE_EVENT(sched_wake_affine,
+
+	TP_PROTO(struct task_struct *p, int level, int this_cpu,
+		 s64 this_load, s64 prev_load, int reason),
+
+	TP_ARGS(p, level, this_cpu, this_load, prev_load, reason),
+
+	TP_STRUCT__entry(
+		__array(	char,	comm,	TASK_COMM_LEN	)
+		__field(	pid_t,	pid			)
+		__field(	int,	level			)
+		__field(	int,	this_cpu		)
+		__field(	int,	prev_cpu		)
+		__field(	s64,	this_load		)
+		__field(	s64,	prev_load		)
+		__field(	int,	reason			)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+		__entry->pid		= p->pid;
+		__entry->level		= level;
+		__entry->this_cpu	= this_cpu;
+		__entry->prev_cpu	= task_cpu(p);
+		__entry->this_load	= this_load;
+		__entry->prev_load	= prev_load;
+		__entry->reason		= reason;
+	),
+
+	TP_printk("comm=%s pid=%d level=%d this_cpu=%d prev_cpu=%d this_load=%Ld prev_load=%Ld reason=%s",
+		  __entry->comm, __entry->pid, __entry->level,
+		  __entry->this_cpu, __entry->prev_cpu,
+		  (long long)__entry->this_load,
+		  (long long)__entry->prev_load,
+		  __print_symbolic(__entry->reason,
+				{ 0, "sync" }, { 1, "balanced" },
+				{ 2, "light" }, { 3, "imbalanced" }))
+);
+
+/*
+ * Tracepoint for the cpu select_task_rq_fair() picked for a waking,
+ * forked or exec'ing task.  level is the domain the decision was made
+ * in (-1 if none) and the reason values are enum sched_select_reason.
+ * sd_flag holds SD_BALANCE_{EXEC,FORK,WAKE}, spelled out numerically since
+ * they are only defined on SMP.
+ */
+TRACE_EVENT(sched_select_task_rq,
+
+	TP_PROTO(struct task_struct *p, int sd_flag, int level,
+		 int target_cpu, int reason),
+
+	TP_ARGS(p, sd_flag, level, target_cpu, reason),
+
+	TP_STRUCT__entry(
+		__array(	char,	comm,	TASK_COMM_LEN	)
+		__field(	pid_t,	pid			)
+		__field(	int,	sd_flag			)
+		__field(	int,	level			)
+		__field(	int,	prev_cpu		)
+		__field(	int,	target_cpu		)
+		__field(	int,	reason			)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+		__entry->pid		= p->pid;
+		__entry->sd_flag	= sd_flag;
+		__entry->level		= level;
+		__entry->prev_cpu	= task_cpu(p);
+		__entry->target_cpu	= target_cpu;
+		__entry->reason		= reason;
+	),
+
+	TP_printk("comm=%s pid=%d sd_flag=%s level=%d prev_cpu=%d target_cpu=%d reason=%s",
+		  __entry->comm, __entry->pid,
+		  __print_flags(__entry->sd_flag, "|",
+				{ 0x0004, "EXEC" }, { 0x0008, "FORK" },
+				{ 0x0010, "WAKE" }),
+		  __entry->level, __entry->prev_cpu, __entry->target_cpu,
+		  __print_symbolic(__entry->reason,
+				{ 0, "no_domain" }, { 1, "affine" },
+				{ 2, "prev" }, { 3, "idlest" }))
+);
+
+/*
+ * Tracepoint for the outcome of a load_balance() pass.  The reason
+ * values are enum sched_lb_reason.
+ */
+TRACE_EVENT(sched_load_balance,
+
+	TP_PROTO(int cpu, int idle, int level, int busiest_cpu,
+		 unsigned long imbalance, int nr_moved, int reason),
+
+	TP_ARGS(cpu, idle, level, busiest_cpu, imbalance, nr_moved, reason),
+
+	TP_STRUCT__entry(
+		__field(	int,		cpu		)
+		__field(	int,		idle		)
+		__field(	int,		level		)
+		__field(	int,		busiest_cpu	)
+		__field(	unsigned long,	imbalance	)
+		__field(	int,		nr_moved	)
+		__field(	int,		reason		)
+	),
+
+	TP_fast_assign(
+		__entry->cpu		= cpu;
+		__entry->idle		= idle;
+		__entry->level		= level;
+		__entry->busiest_cpu	= busiest_cpu;
+		__entry->imbalance	= imbalance;
+		__entry->nr_moved	= nr_moved;
+		__entry->reason		= reason;
+	),
+
+	TP_printk("cpu=%d idle=%s level=%d busiest_cpu=%d imbalance=%lu nr_moved=%d reason=%s",
+		  __entry->cpu,
+		  __print_symbolic(__entry->idle,
+				{ 0, "idle" }, { 1, "busy" }, { 2, "newidle" }),
+		  __entry->level, __entry->busiest_cpu, __entry->imbalance,
+		  __entry->nr_moved,
+		  __print_symbolic(__entry->reason,
+				{ 0, "not_balancer" },
+				{ 1, "no_busiest_group" },
+				{ 2, "no_busiest_queue" },
+				{ 3, "moved" }, { 4, "failed" },
+				{ 5, "active" }, { 6, "pinned" }))
+);
+
 DECLARE_EVENT_CLASS(sched_process_template,
 
 	TP_PROTO(struct task_struct *p),
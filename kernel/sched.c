@@ -260,6 +260,12 @@ struct task_group {
 	unsigned long shares;
 
 	atomic_t load_weight;
+#ifdef CONFIG_SMP
+	/* sum of the cfs_rq runnable averages, see tg_load_contrib */
+	atomic64_t load_avg;
+	/* sum of the per-cpu runnable fractions, NICE_0_LOAD == one cpu */
+	atomic_t runnable_avg;
+#endif
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -336,6 +342,24 @@ struct cfs_rq {
 	unsigned int nr_spread_over;
 #endif
 
+#ifdef CONFIG_SMP
+	/*
+	 * Per-entity load tracking: runnable_load_avg is the sum of the
+	 * load_avg_contrib of the entities queued here, blocked_load_avg
+	 * that of the entities which went to sleep here, decayed lazily
+	 * on each decay_counter tick (~1ms).  removed_load accumulates the
+	 * contribution of blocked entities that migrated away.
+	 */
+	unsigned long runnable_load_avg, blocked_load_avg;
+	atomic64_t decay_counter, removed_load;
+	u64 last_decay;
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	/* what this cfs_rq currently contributes to tg->{runnable,load}_avg */
+	u32 tg_runnable_contrib;
+	u64 tg_load_contrib;
+#endif
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	struct rq *rq;	/* cpu runqueue to which this cfs_rq is attached */
 
@@ -522,6 +546,8 @@ struct rq {
 	int online;
 
 	unsigned long avg_load_per_task;
+	/* runnable average of the whole cpu, feeds the root group */
+	struct sched_avg avg;
 
 	u64 rt_avg;
 	u64 age_stamp;
@@ -1521,7 +1547,7 @@ static int tg_nop(struct task_group *tg, void *data)
 /* Used instead of source_load when we know the type == 0 */
 static unsigned long weighted_cpuload(const int cpu)
 {
-	return cpu_rq(cpu)->load.weight;
+	return cpu_rq(cpu)->cfs.runnable_load_avg;
 }
 
 /*
@@ -1570,7 +1596,7 @@ static unsigned long cpu_avg_load_per_task(int cpu)
 	unsigned long nr_running = ACCESS_ONCE(rq->nr_running);
 
 	if (nr_running)
-		rq->avg_load_per_task = rq->load.weight / nr_running;
+		rq->avg_load_per_task = rq->cfs.runnable_load_avg / nr_running;
 	else
 		rq->avg_load_per_task = 0;
 
@@ -2232,6 +2258,8 @@ void set_task_cpu(struct task_struct *p, unsigned int new_cpu)
 	trace_sched_migrate_task(p, new_cpu);
 
 	if (task_cpu(p) != new_cpu) {
+		if (p->sched_class->migrate_task_rq)
+			p->sched_class->migrate_task_rq(p, new_cpu);
 		p->se.nr_migrations++;
 		perf_sw_event(PERF_COUNT_SW_CPU_MIGRATIONS, 1, NULL, 0);
 	}
@@ -2821,6 +2849,10 @@ static void __sched_fork(struct task_struct *p)
 	p->se.vruntime			= 0;
 	INIT_LIST_HEAD(&p->se.group_node);
 
+#ifdef CONFIG_SMP
+	memset(&p->se.avg, 0, sizeof(p->se.avg));
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
@@ -3588,6 +3620,19 @@ decay_load_missed(unsigned long load, unsigned long missed_updates, int idx)
 	return load;
 }
 
+/*
+ * The load fed into cpu_load[]; on SMP it has to agree with
+ * weighted_cpuload() since source_load() and target_load() mix the two.
+ */
+static inline unsigned long rq_runnable_load(struct rq *rq)
+{
+#ifdef CONFIG_SMP
+	return rq->cfs.runnable_load_avg;
+#else
+	return rq->load.weight;
+#endif
+}
+
 /*
  * Update rq->cpu_load[] statistics. This function is usually called every
  * scheduler tick (TICK_NSEC). With tickless idle this will not be called
@@ -3595,7 +3640,7 @@ decay_load_missed(unsigned long load, unsigned long missed_updates, int idx)
  */
 static void update_cpu_load(struct rq *this_rq)
 {
-	unsigned long this_load = this_rq->load.weight;
+	unsigned long this_load = rq_runnable_load(this_rq);
 	unsigned long curr_jiffies = jiffies;
 	unsigned long pending_updates;
 	int i, scale;
@@ -7930,6 +7975,11 @@ static void init_cfs_rq(struct cfs_rq *cfs_rq)
 #ifndef CONFIG_64BIT
 	cfs_rq->min_vruntime_copy = cfs_rq->min_vruntime;
 #endif
+#ifdef CONFIG_SMP
+	/* a non-zero decay_count marks an entity as blocked */
+	atomic64_set(&cfs_rq->decay_counter, 1);
+	atomic64_set(&cfs_rq->removed_load, 0);
+#endif
 }
 
 static void init_rt_rq(struct rt_rq *rt_rq, struct rq *rq)
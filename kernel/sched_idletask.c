@@ -5,6 +5,10 @@
  *  handled in sched_fair.c)
  */
 
+/* runnable average bookkeeping, see sched_fair.c */
+static void idle_enter_fair(struct rq *this_rq);
+static void idle_exit_fair(struct rq *this_rq);
+
 #ifdef CONFIG_SMP
 static int
 select_task_rq_idle(struct task_struct *p, int sd_flag, int flags)
@@ -24,6 +28,7 @@ static struct task_struct *pick_next_task_idle(struct rq *rq)
 {
 	schedstat_inc(rq, sched_goidle);
 	calc_load_account_idle(rq);
+	idle_enter_fair(rq);
 	return rq->idle;
 }
 
@@ -42,6 +47,7 @@ dequeue_task_idle(struct rq *rq, struct task_struct *p, int flags)
 
 static void put_prev_task_idle(struct rq *rq, struct task_struct *prev)
 {
+	idle_exit_fair(rq);
 }
 
 static void task_tick_idle(struct rq *rq, struct task_struct *curr, int queued)
@@ -0,0 +1,206 @@
+/*
+ * Memory copy bandwidth benchmark
+ *
+ * Measures memcpy(), copy_page(), copy_to_user() and copy_from_user()
+ * for sizes from 64 bytes to 64 KB, with the source and destination
+ * aligned, misaligned by a word and misaligned relative to each other:
+ *
+ *	modprobe copy_bench [msec=N]
+ *
+ * The user side buffer is an anonymous mapping in the address space of
+ * the process loading the module.  Like tcrypt, the module always fails
+ * to load with -EAGAIN once the measurements are done.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+
+#define COPY_BENCH_MIN_LEN	64
+#define COPY_BENCH_MAX_LEN	65536
+/* room for the largest copy plus the misalignment */
+#define COPY_BENCH_BUF_LEN	(COPY_BENCH_MAX_LEN + PAGE_SIZE)
+
+/*
+ * Run each measurement for this many milliseconds.
+ */
+static unsigned int msec = 100;
+
+static const struct {
+	unsigned int dst, src;
+} copy_bench_align[] = {
+	{ 0, 0 },	/* both page aligned */
+	{ 4, 4 },	/* both word but not cache line aligned */
+	{ 0, 3 },	/* misaligned relative to each other */
+};
+
+enum copy_bench_op {
+	COPY_BENCH_MEMCPY,
+	COPY_BENCH_TO_USER,
+	COPY_BENCH_FROM_USER,
+	COPY_BENCH_PAGE,
+};
+
+static const char * const copy_bench_names[] = {
+	[COPY_BENCH_MEMCPY]	= "memcpy",
+	[COPY_BENCH_TO_USER]	= "copy_to_user",
+	[COPY_BENCH_FROM_USER]	= "copy_from_user",
+	[COPY_BENCH_PAGE]	= "copy_page",
+};
+
+static u8 *kbuf1, *kbuf2;
+static u8 __user *ubuf;
+
+static int copy_bench_do(enum copy_bench_op op, unsigned int dst,
+			 unsigned int src, size_t len)
+{
+	switch (op) {
+	case COPY_BENCH_MEMCPY:
+		memcpy(kbuf1 + dst, kbuf2 + src, len);
+		return 0;
+	case COPY_BENCH_TO_USER:
+		return copy_to_user(ubuf + dst, kbuf2 + src, len) ? -EFAULT : 0;
+	case COPY_BENCH_FROM_USER:
+		return copy_from_user(kbuf1 + dst, ubuf + src, len) ? -EFAULT : 0;
+	case COPY_BENCH_PAGE:
+		copy_page(kbuf1, kbuf2);
+		return 0;
+	}
+	return -EINVAL;
+}
+
+/* returns the bandwidth in MB/s, or a negative error */
+static long __init copy_bench_one(enum copy_bench_op op, unsigned int dst,
+				  unsigned int src, size_t len)
+{
+	/* enough calls per batch to make the clock reads negligible */
+	unsigned int batch = max_t(unsigned int, 1, 65536 / len);
+	ktime_t start;
+	u64 bytes = 0;
+	u64 ns;
+	int i, err;
+
+	/* warm up the caches and fault in the user buffer */
+	err = copy_bench_do(op, dst, src, len);
+	if (err)
+		return err;
+
+	start = ktime_get();
+	do {
+		for (i = 0; i < batch; i++)
+			copy_bench_do(op, dst, src, len);
+		bytes += (u64)batch * len;
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		cond_resched();
+	} while (ns < (u64)msec * NSEC_PER_MSEC);
+
+	/* bytes per microsecond is MB/s */
+	do_div(ns, NSEC_PER_USEC);
+	do_div(bytes, ns ? ns : 1);
+	return bytes;
+}
+
+static int __init copy_bench_run(void)
+{
+	enum copy_bench_op op;
+	unsigned int a;
+	size_t len;
+	long mbps;
+
+	for (op = COPY_BENCH_MEMCPY; op < COPY_BENCH_PAGE; op++) {
+		for (a = 0; a < ARRAY_SIZE(copy_bench_align); a++) {
+			for (len = COPY_BENCH_MIN_LEN;
+			     len <= COPY_BENCH_MAX_LEN; len <<= 1) {
+				mbps = copy_bench_one(op,
+						      copy_bench_align[a].dst,
+						      copy_bench_align[a].src,
+						      len);
+				if (mbps < 0)
+					return mbps;
+				pr_info("copy_bench: %-14s dst+%u src+%u %5zu bytes: %5ld MB/s\n",
+					copy_bench_names[op],
+					copy_bench_align[a].dst,
+					copy_bench_align[a].src, len, mbps);
+			}
+		}
+	}
+
+	mbps = copy_bench_one(COPY_BENCH_PAGE, 0, 0, PAGE_SIZE);
+	pr_info("copy_bench: %-14s %25lu bytes: %5ld MB/s\n",
+		copy_bench_names[COPY_BENCH_PAGE], PAGE_SIZE, mbps);
+
+	return 0;
+}
+
+static int __init copy_bench_init(void)
+{
+	unsigned long addr;
+	int order = get_order(COPY_BENCH_BUF_LEN);
+	int err = -ENOMEM;
+
+	kbuf1 = (u8 *)__get_free_pages(GFP_KERNEL, order);
+	kbuf2 = (u8 *)__get_free_pages(GFP_KERNEL, order);
+	if (!kbuf1 || !kbuf2)
+		goto out_free;
+	memset(kbuf2, 0x5a, COPY_BENCH_BUF_LEN);
+
+	down_write(&current->mm->mmap_sem);
+	addr = do_mmap(NULL, 0, COPY_BENCH_BUF_LEN, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, 0);
+	up_write(&current->mm->mmap_sem);
+	if (IS_ERR_VALUE(addr)) {
+		err = addr;
+		goto out_free;
+	}
+	ubuf = (u8 __user *)addr;
+
+	pr_info("copy_bench: %u msec per test\n", msec);
+	err = copy_bench_run();
+	if (err)
+		pr_err("copy_bench: failed with %d\n", err);
+
+	down_write(&current->mm->mmap_sem);
+	do_munmap(current->mm, addr, COPY_BENCH_BUF_LEN);
+	up_write(&current->mm->mmap_sem);
+
+	/*
+	 * We intentionally return -EAGAIN to prevent keeping the module.
+	 * It does all its work from init() and doesn't offer any runtime
+	 * functionality.
+	 */
+	if (!err)
+		err = -EAGAIN;
+out_free:
+	if (kbuf1)
+		free_pages((unsigned long)kbuf1, order);
+	if (kbuf2)
+		free_pages((unsigned long)kbuf2, order);
+	return err;
+}
+
+/*
+ * If an init function is provided, an exit function must also be provided
+ * to allow module unload.
+ */
+static void __exit copy_bench_exit(void) { }
+
+module_init(copy_bench_init);
+module_exit(copy_bench_exit);
+
+module_param(msec, uint, 0);
+MODULE_PARM_DESC(msec, "Length in milliseconds of each measurement");
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Memory copy bandwidth benchmark");
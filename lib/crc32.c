@@ -28,13 +28,14 @@
 #include <linux/init.h>
 #include <linux/atomic.h>
 #include "crc32defs.h"
-#if CRC_LE_BITS == 8
+
+#if CRC_LE_BITS > 8
 # define tole(x) __constant_cpu_to_le32(x)
 #else
 # define tole(x) (x)
 #endif
 
-#if CRC_BE_BITS == 8
+#if CRC_BE_BITS > 8
 # define tobe(x) __constant_cpu_to_be32(x)
 #else
 # define tobe(x) (x)
@@ -42,29 +43,41 @@
 #include "crc32table.h"
 
 MODULE_AUTHOR("Matt Domsch <Matt_Domsch@dell.com>");
-MODULE_DESCRIPTION("Ethernet CRC32 calculations");
+MODULE_DESCRIPTION("Various CRC32 calculations");
 MODULE_LICENSE("GPL");
 
-#if CRC_LE_BITS == 8 || CRC_BE_BITS == 8
+#if CRC_LE_BITS > 8 || CRC_BE_BITS > 8
 
+/*
+ * Implements the slicing-by-4 and slicing-by-8 algorithms: the crc is
+ * xor'ed into the next input word, and every byte of the result is then
+ * looked up in its own table, which holds the crc of that byte followed
+ * by the appropriate number of zero bytes.  Slicing-by-8 consumes a
+ * second word per iteration, whose bytes only need the first four tables.
+ */
 static inline u32
 crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 {
 # ifdef __LITTLE_ENDIAN
-#  define DO_CRC(x) crc = tab[0][(crc ^ (x)) & 255] ^ (crc >> 8)
-#  define DO_CRC4 crc = tab[3][(crc) & 255] ^ \
-		tab[2][(crc >> 8) & 255] ^ \
-		tab[1][(crc >> 16) & 255] ^ \
-		tab[0][(crc >> 24) & 255]
+#  define DO_CRC(x) crc = t0[(crc ^ (x)) & 255] ^ (crc >> 8)
+#  define DO_CRC4 (t3[(q) & 255] ^ t2[(q >> 8) & 255] ^ \
+		   t1[(q >> 16) & 255] ^ t0[(q >> 24) & 255])
+#  define DO_CRC8 (t7[(q) & 255] ^ t6[(q >> 8) & 255] ^ \
+		   t5[(q >> 16) & 255] ^ t4[(q >> 24) & 255])
 # else
-#  define DO_CRC(x) crc = tab[0][((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
-#  define DO_CRC4 crc = tab[0][(crc) & 255] ^ \
-		tab[1][(crc >> 8) & 255] ^ \
-		tab[2][(crc >> 16) & 255] ^ \
-		tab[3][(crc >> 24) & 255]
+#  define DO_CRC(x) crc = t0[((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
+#  define DO_CRC4 (t0[(q) & 255] ^ t1[(q >> 8) & 255] ^ \
+		   t2[(q >> 16) & 255] ^ t3[(q >> 24) & 255])
+#  define DO_CRC8 (t4[(q) & 255] ^ t5[(q >> 8) & 255] ^ \
+		   t6[(q >> 16) & 255] ^ t7[(q >> 24) & 255])
 # endif
 	const u32 *b;
 	size_t    rem_len;
+	const u32 *t0 = tab[0], *t1 = tab[1], *t2 = tab[2], *t3 = tab[3];
+# if CRC_LE_BITS != 32
+	const u32 *t4 = tab[4], *t5 = tab[5], *t6 = tab[6], *t7 = tab[7];
+# endif
+	u32 q;
 
 	/* Align it */
 	if (unlikely((long)buf & 3 && len)) {
@@ -72,13 +85,25 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 			DO_CRC(*buf++);
 		} while ((--len) && ((long)buf)&3);
 	}
+
+# if CRC_LE_BITS == 32
 	rem_len = len & 3;
-	/* load data 32 bits wide, xor data 32 bits wide. */
 	len = len >> 2;
+# else
+	rem_len = len & 7;
+	len = len >> 3;
+# endif
+
 	b = (const u32 *)buf;
 	for (--b; len; --len) {
-		crc ^= *++b; /* use pre increment for speed */
-		DO_CRC4;
+		q = crc ^ *++b; /* use pre increment for speed */
+# if CRC_LE_BITS == 32
+		crc = DO_CRC4;
+# else
+		crc = DO_CRC8;
+		q = *++b;
+		crc ^= DO_CRC4;
+# endif
 	}
 	len = rem_len;
 	/* And the last few bytes */
@@ -91,121 +116,141 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 	return crc;
 #undef DO_CRC
 #undef DO_CRC4
+#undef DO_CRC8
 }
 #endif
+
 /**
- * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
- * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
- *	other uses, or the previous crc32 value if computing incrementally.
- * @p: pointer to buffer over which CRC is run
+ * crc32_le_generic() - Calculate bitwise little-endian Ethernet AUTODIN II
+ *			CRC32/CRC32C
+ * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for other
+ *	 uses, or the previous crc32/crc32c value if computing incrementally.
+ * @p: pointer to buffer over which CRC32/CRC32C is run
  * @len: length of buffer @p
+ * @tab: little-endian Ethernet table
+ * @polynomial: CRC32/CRC32c LE polynomial
  */
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len);
-
-#if CRC_LE_BITS == 1
-/*
- * In fact, the table-based code will work in this case, but it can be
- * simplified by inlining the table in ?: form.
- */
-
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+static inline u32 __pure crc32_le_generic(u32 crc, unsigned char const *p,
+					  size_t len, const u32 (*tab)[256],
+					  u32 polynomial)
 {
+#if CRC_LE_BITS == 1
 	int i;
 	while (len--) {
 		crc ^= *p++;
 		for (i = 0; i < 8; i++)
-			crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
+			crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+	}
+# elif CRC_LE_BITS == 2
+	while (len--) {
+		crc ^= *p++;
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
 	}
-	return crc;
-}
-#else				/* Table-based approach */
-
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
-{
-# if CRC_LE_BITS == 8
-	const u32      (*tab)[] = crc32table_le;
-
-	crc = __cpu_to_le32(crc);
-	crc = crc32_body(crc, p, len, tab);
-	return __le32_to_cpu(crc);
 # elif CRC_LE_BITS == 4
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
+		crc = (crc >> 4) ^ tab[0][crc & 15];
+		crc = (crc >> 4) ^ tab[0][crc & 15];
 	}
-	return crc;
-# elif CRC_LE_BITS == 2
+# elif CRC_LE_BITS == 8
+	/* aka Sarwate algorithm */
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
+		crc = (crc >> 8) ^ tab[0][crc & 255];
 	}
+# else
+	crc = __cpu_to_le32(crc);
+	crc = crc32_body(crc, p, len, tab);
+	crc = __le32_to_cpu(crc);
+#endif
 	return crc;
-# endif
+}
+
+#if CRC_LE_BITS == 1
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len, NULL, CRCPOLY_LE);
+}
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len, NULL, CRC32C_POLY_LE);
+}
+#else
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len, crc32table_le, CRCPOLY_LE);
+}
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len, crc32ctable_le, CRC32C_POLY_LE);
 }
 #endif
+EXPORT_SYMBOL(crc32_le);
+EXPORT_SYMBOL(__crc32c_le);
 
 /**
- * crc32_be() - Calculate bitwise big-endian Ethernet AUTODIN II CRC32
+ * crc32_be_generic() - Calculate bitwise big-endian Ethernet AUTODIN II CRC32
  * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
  *	other uses, or the previous crc32 value if computing incrementally.
- * @p: pointer to buffer over which CRC is run
+ * @p: pointer to buffer over which CRC32 is run
  * @len: length of buffer @p
+ * @tab: big-endian Ethernet table
+ * @polynomial: CRC32 BE polynomial
  */
-u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len);
-
-#if CRC_BE_BITS == 1
-/*
- * In fact, the table-based code will work in this case, but it can be
- * simplified by inlining the table in ?: form.
- */
-
-u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
+static inline u32 __pure crc32_be_generic(u32 crc, unsigned char const *p,
+					  size_t len, const u32 (*tab)[256],
+					  u32 polynomial)
 {
+#if CRC_BE_BITS == 1
 	int i;
 	while (len--) {
 		crc ^= *p++ << 24;
 		for (i = 0; i < 8; i++)
 			crc =
-			    (crc << 1) ^ ((crc & 0x80000000) ? CRCPOLY_BE :
+			    (crc << 1) ^ ((crc & 0x80000000) ? polynomial :
 					  0);
 	}
-	return crc;
-}
-
-#else				/* Table-based approach */
-u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
-{
-# if CRC_BE_BITS == 8
-	const u32      (*tab)[] = crc32table_be;
-
-	crc = __cpu_to_be32(crc);
-	crc = crc32_body(crc, p, len, tab);
-	return __be32_to_cpu(crc);
+# elif CRC_BE_BITS == 2
+	while (len--) {
+		crc ^= *p++ << 24;
+		crc = (crc << 2) ^ tab[0][crc >> 30];
+		crc = (crc << 2) ^ tab[0][crc >> 30];
+		crc = (crc << 2) ^ tab[0][crc >> 30];
+		crc = (crc << 2) ^ tab[0][crc >> 30];
+	}
 # elif CRC_BE_BITS == 4
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
+		crc = (crc << 4) ^ tab[0][crc >> 28];
+		crc = (crc << 4) ^ tab[0][crc >> 28];
 	}
-	return crc;
-# elif CRC_BE_BITS == 2
+# elif CRC_BE_BITS == 8
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
+		crc = (crc << 8) ^ tab[0][crc >> 24];
 	}
-	return crc;
+# else
+	crc = __cpu_to_be32(crc);
+	crc = crc32_body(crc, p, len, tab);
+	crc = __be32_to_cpu(crc);
 # endif
+	return crc;
 }
-#endif
 
-EXPORT_SYMBOL(crc32_le);
+#if CRC_BE_BITS == 1
+u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_be_generic(crc, p, len, NULL, CRCPOLY_BE);
+}
+#else
+u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_be_generic(crc, p, len, crc32table_be, CRCPOLY_BE);
+}
+#endif
 EXPORT_SYMBOL(crc32_be);
 
 /*
@@ -335,6 +380,210 @@ EXPORT_SYMBOL(crc32_be);
  * the same way on decoding, it doesn't make a difference.
  */
 
+#ifdef CONFIG_CRC32_SELFTEST
+
+/* 4096 pseudo random bytes, filled in by crc32_fill_test_buf() */
+static u8 __initdata __aligned(8) test_buf[4096];
+
+/*
+ * Each test runs crc32_le, crc32_be and __crc32c_le over "length" bytes
+ * of test_buf starting at "start", with "crc" as the seed.  The first
+ * entries cover the unaligned head and tail handling of the slicing
+ * code, the rest are random.
+ */
+static struct crc_test {
+	u32 crc;	/* random starting crc */
+	u32 start;	/* random 6 bit offset in buf */
+	u32 length;	/* random 11 bit length of test */
+	u32 crc_le;	/* expected crc32_le result */
+	u32 crc_be;	/* expected crc32_be result */
+	u32 crc32c_le;	/* expected crc32c_le result */
+} test[] __initdata = {
+	{0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000},
+	{0xffffffff, 0x00000000, 0x00000001, 0x5ffa77f7, 0x0904629f, 0x48ae6d82},
+	{0xffffffff, 0x00000001, 0x00000003, 0xa629726d, 0x3abd9fc8, 0x30d6c8c7},
+	{0x00000000, 0x00000003, 0x00000007, 0x9c245907, 0xdd830c75, 0x6e5fa455},
+	{0x12345678, 0x00000005, 0x00000008, 0x0f1b28fd, 0x3d691d54, 0xb70024c6},
+	{0xffffffff, 0x00000007, 0x00000009, 0x760a3df4, 0x2885cfe3, 0xc6ba1430},
+	{0x00000000, 0x00000001, 0x0000000f, 0xab91518f, 0x2607a84e, 0xd9368b90},
+	{0xffffffff, 0x00000000, 0x00000010, 0x99c797cf, 0xddb61b8e, 0xaae0c867},
+	{0xdeadbeef, 0x00000002, 0x0000001f, 0x610336c0, 0xe041db17, 0x3064c872},
+	{0x00000000, 0x00000004, 0x00000040, 0xcc8fa083, 0xdedea2b8, 0x48130cda},
+	{0xaac6871e, 0x0000002b, 0x000000a8, 0xb4c00704, 0x21e545ec, 0xa8d780bf},
+	{0x8856bcaf, 0x0000003b, 0x0000070f, 0x2a40a1dd, 0xda6391d4, 0x0d275128},
+	{0x2d820b22, 0x00000026, 0x000002fb, 0x96df9615, 0x1bbf2033, 0xe763f74a},
+	{0x86ac98e3, 0x00000004, 0x000001a5, 0x5aa3fd58, 0xa06ab796, 0xb740e83d},
+	{0xf56d8fa2, 0x0000001e, 0x000000d8, 0xaa8de278, 0xcd025696, 0x4ab04b74},
+	{0x6f4baf50, 0x0000000a, 0x000005d8, 0x20209d4e, 0x3c20bdca, 0xac8d8734},
+	{0xe0670a2a, 0x0000000a, 0x000005e9, 0x93bf14ce, 0x41b74f24, 0xe605c3e5},
+	{0x003002cd, 0x00000008, 0x000005d2, 0x45b291c9, 0x764ac5d8, 0xe0512a21},
+	{0x92b137d8, 0x00000025, 0x00000784, 0x2c559d01, 0x128ac8ef, 0xa86b3288},
+	{0x37abc66e, 0x00000014, 0x00000032, 0xc6130d5c, 0x395a46a2, 0x461b0afc},
+	{0xc602fcc8, 0x00000035, 0x000002fd, 0x677e2ee7, 0x9b639149, 0xf5671a23},
+	{0x0f2c7104, 0x00000017, 0x0000060c, 0xbc1de1e2, 0xece07e3d, 0x6deb730b},
+	{0xba9de1d5, 0x00000027, 0x000000b6, 0x82414e13, 0x1aa85364, 0x63b696ab},
+	{0xf9267967, 0x00000000, 0x0000019c, 0xe5f615ee, 0xed946e01, 0xcec0bcfa},
+	{0x9d607553, 0x00000017, 0x00000107, 0x07e4edbb, 0x4b1f7e6d, 0x401ae0c2},
+	{0x66205e2e, 0x0000003e, 0x00000696, 0xb8a33b66, 0xa0511069, 0xb5515246},
+	{0x69bd84b6, 0x00000037, 0x000003af, 0x851f7875, 0xba181df2, 0x19823e6c},
+	{0x5f7019a7, 0x00000020, 0x00000264, 0xb62d47d3, 0x2c4b0cc3, 0x03ad7f3a},
+	{0x0103ebf6, 0x0000002c, 0x00000343, 0x87519bec, 0x03fccc54, 0x3d8d0891},
+	{0xc7f4627d, 0x00000030, 0x000005fe, 0x574ee976, 0xb03f2940, 0x6ecc3bcc},
+	{0xa7339143, 0x00000023, 0x000007ce, 0x43905e85, 0x444d5dfd, 0xc3069864},
+	{0x5df5473a, 0x00000037, 0x00000514, 0x67d7ad17, 0xbf7198da, 0x2ca0c575},
+	{0xb8faa71c, 0x00000029, 0x0000040d, 0x76cab8c3, 0xb5f89413, 0x6bf1763b},
+	{0x669727e8, 0x00000029, 0x000001de, 0x7a7d86a1, 0x7558255f, 0x1f12a960},
+	{0x583d5a19, 0x00000005, 0x000007c2, 0x45ad7afe, 0x192560b5, 0xf9c12cae},
+	{0x8377207f, 0x0000002e, 0x000001e3, 0x61520c36, 0xae7a3253, 0xfdbab466},
+	{0x55f6b0cc, 0x00000034, 0x000000cd, 0x19982ba3, 0x12a44f62, 0xa41414af},
+	{0xcd3cf110, 0x0000001d, 0x000002f4, 0xe4b8fa28, 0x983fcf7d, 0x98f2eb89},
+	{0xcc6f9959, 0x00000001, 0x000001e6, 0xe86bb9cf, 0x1515973e, 0x7df0252a},
+	{0x50cbced4, 0x00000032, 0x000005e2, 0xfc83dc8c, 0x22542e6b, 0x34c9b701},
+	{0xa8236d78, 0x0000002e, 0x000000ca, 0x53504602, 0x95b4dc41, 0x6b0c2eba},
+	{0x80faa6b9, 0x00000037, 0x0000056b, 0xad53a2e8, 0x664b2681, 0x55b1c8de},
+	{0x1b4395c5, 0x00000003, 0x000005db, 0x3b560d2c, 0xcc10e1bf, 0xfc9f9672},
+	{0xd97e155e, 0x00000024, 0x0000008f, 0x7dd9cf2f, 0x9823c31e, 0xf8d62559},
+	{0xf6556e2c, 0x00000039, 0x000000a1, 0x35fe2a16, 0x525e9e1f, 0x7241a1de},
+	{0x1dfcc19b, 0x0000002d, 0x000001d6, 0xb0988406, 0xa5ad5f13, 0xcef4e089},
+	{0xd4fb0cfa, 0x0000001a, 0x000002fc, 0xc2347c56, 0x92321c56, 0xc30ab131},
+	{0xb2c5dee4, 0x00000003, 0x00000596, 0xc1a67765, 0xd4f6f6f5, 0x38ba1854},
+	{0xffffffff, 0x00000000, 0x00000fc0, 0x748ce8ce, 0xdc614cbe, 0x350a08ee},
+	{0x00000000, 0x0000003f, 0x00000fc1, 0x7df716e1, 0x02518ab8, 0xaa8c09f2},
+};
+
+static void __init crc32_fill_test_buf(void)
+{
+	u32 x = 1;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(test_buf); i++) {
+		x = x * 1103515245 + 12345;
+		test_buf[i] = x >> 16;
+	}
+}
+
+static int __init crc32c_test(void)
+{
+	int i;
+	int errors = 0;
+	int bytes = 0;
+	struct timespec start, stop;
+	u64 nsec;
+	unsigned long flags;
+
+	/* keep static to prevent cache warming code from
+	 * getting eliminated by the compiler */
+	static u32 crc;
+
+	/* pre-warm the cache */
+	for (i = 0; i < ARRAY_SIZE(test); i++) {
+		bytes += test[i].length;
+
+		crc ^= __crc32c_le(test[i].crc, test_buf +
+		    test[i].start, test[i].length);
+	}
+
+	/* reduce OS noise */
+	local_irq_save(flags);
+
+	getnstimeofday(&start);
+	for (i = 0; i < ARRAY_SIZE(test); i++) {
+		if (test[i].crc32c_le != __crc32c_le(test[i].crc, test_buf +
+		    test[i].start, test[i].length))
+			errors++;
+	}
+	getnstimeofday(&stop);
+
+	local_irq_restore(flags);
+
+	nsec = stop.tv_nsec - start.tv_nsec +
+		1000000000 * (stop.tv_sec - start.tv_sec);
+
+	pr_info("crc32c: CRC_LE_BITS = %d\n", CRC_LE_BITS);
+
+	if (errors)
+		pr_warn("crc32c: %d self tests failed\n", errors);
+	else {
+		pr_info("crc32c: self tests passed, processed %d bytes in %lld nsec\n",
+			bytes, nsec);
+	}
+
+	return errors;
+}
+
+static int __init crc32_test(void)
+{
+	int i;
+	int errors = 0;
+	int bytes = 0;
+	struct timespec start, stop;
+	u64 nsec;
+	unsigned long flags;
+
+	/* keep static to prevent cache warming code from
+	 * getting eliminated by the compiler */
+	static u32 crc;
+
+	/* pre-warm the cache */
+	for (i = 0; i < ARRAY_SIZE(test); i++) {
+		bytes += 2*test[i].length;
+
+		crc ^= crc32_le(test[i].crc, test_buf +
+		    test[i].start, test[i].length);
+
+		crc ^= crc32_be(test[i].crc, test_buf +
+		    test[i].start, test[i].length);
+	}
+
+	/* reduce OS noise */
+	local_irq_save(flags);
+
+	getnstimeofday(&start);
+	for (i = 0; i < ARRAY_SIZE(test); i++) {
+		if (test[i].crc_le != crc32_le(test[i].crc, test_buf +
+		    test[i].start, test[i].length))
+			errors++;
+
+		if (test[i].crc_be != crc32_be(test[i].crc, test_buf +
+		    test[i].start, test[i].length))
+			errors++;
+	}
+	getnstimeofday(&stop);
+
+	local_irq_restore(flags);
+
+	nsec = stop.tv_nsec - start.tv_nsec +
+		1000000000 * (stop.tv_sec - start.tv_sec);
+
+	pr_info("crc32: CRC_LE_BITS = %d, CRC_BE BITS = %d\n",
+		 CRC_LE_BITS, CRC_BE_BITS);
+
+	if (errors)
+		pr_warn("crc32: %d self tests failed\n", errors);
+	else {
+		pr_info("crc32: self tests passed, processed %d bytes in %lld nsec\n",
+			bytes, nsec);
+	}
+
+	return errors;
+}
+
+static int __init crc32test_init(void)
+{
+	crc32_fill_test_buf();
+	crc32_test();
+	crc32c_test();
+	return 0;
+}
+
+static void __exit crc32_exit(void)
+{
+}
+
+module_init(crc32test_init);
+module_exit(crc32_exit);
+#endif /* CONFIG_CRC32_SELFTEST */
+
 #ifdef UNITTEST
 
 #include <stdlib.h>
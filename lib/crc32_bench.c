@@ -0,0 +1,137 @@
+/*
+ * CRC32 throughput benchmark
+ *
+ * Runs crc32_le(), crc32_be() and __crc32c_le() over buffers of 64 bytes
+ * up to 64 KB and prints the throughput of each to the kernel log, so
+ * that the CRC32 implementation choices (slice by 8, slice by 4, ...)
+ * can be compared on a given machine:
+ *
+ *	modprobe crc32_bench [sec=N] [offset=N]
+ *
+ * The module always fails to load with -EAGAIN once the measurements
+ * are done, like tcrypt, so it can be run again without unloading it.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/crc32.h>
+#include <linux/init.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+#define CRC32_BENCH_MIN_LEN	64
+#define CRC32_BENCH_MAX_LEN	65536
+
+/*
+ * Run each measurement for this many seconds.
+ */
+static unsigned int sec = 1;
+
+/*
+ * Start the data this many bytes past a cache line boundary, to measure
+ * the cost of the unaligned head and tail handling.
+ */
+static unsigned int offset;
+
+struct crc32_bench_fn {
+	const char *name;
+	u32 (*fn)(u32 crc, unsigned char const *p, size_t len);
+};
+
+static const struct crc32_bench_fn crc32_bench_fns[] = {
+	{ "crc32_le",	 crc32_le },
+	{ "crc32_be",	 crc32_be },
+	{ "crc32c_le",	 __crc32c_le },
+};
+
+/* keep static so that the calls can't be optimized away */
+static u32 crc32_bench_sink;
+
+/* returns the throughput in KB/s */
+static unsigned long __init crc32_bench_one(const struct crc32_bench_fn *f,
+					    const u8 *buf, size_t len)
+{
+	unsigned long start, end;
+	u64 bytes = 0;
+	u32 crc = ~0;
+
+	/* wait for the start of a jiffy to reduce the measurement error */
+	start = jiffies;
+	while (start == jiffies)
+		cpu_relax();
+
+	for (start = jiffies, end = start + sec * HZ;
+	     time_before(jiffies, end); bytes += len)
+		crc = f->fn(crc, buf, len);
+
+	crc32_bench_sink ^= crc;
+
+	do_div(bytes, 1024 * sec);
+	return bytes;
+}
+
+static int __init crc32_bench_init(void)
+{
+	unsigned long kbps[ARRAY_SIZE(crc32_bench_fns)];
+	size_t len;
+	u8 *buf;
+	int i;
+
+	if (!sec)
+		sec = 1;
+	offset %= L1_CACHE_BYTES;
+
+	buf = kmalloc(CRC32_BENCH_MAX_LEN + L1_CACHE_BYTES, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	get_random_bytes(buf, CRC32_BENCH_MAX_LEN + L1_CACHE_BYTES);
+
+	pr_info("crc32_bench: %u second(s) per test, data offset %u\n",
+		sec, offset);
+
+	for (len = CRC32_BENCH_MIN_LEN; len <= CRC32_BENCH_MAX_LEN; len <<= 1) {
+		for (i = 0; i < ARRAY_SIZE(crc32_bench_fns); i++) {
+			kbps[i] = crc32_bench_one(&crc32_bench_fns[i],
+						  buf + offset, len);
+			cond_resched();
+		}
+
+		pr_info("crc32_bench: %5zu bytes: %s %7lu KB/s, "
+			"%s %7lu KB/s, %s %7lu KB/s\n", len,
+			crc32_bench_fns[0].name, kbps[0],
+			crc32_bench_fns[1].name, kbps[1],
+			crc32_bench_fns[2].name, kbps[2]);
+	}
+
+	kfree(buf);
+
+	/*
+	 * We intentionally return -EAGAIN to prevent keeping the module.
+	 * The results are in the kernel log and there is nothing left to
+	 * do, so there is no need to unload it before running it again.
+	 */
+	return -EAGAIN;
+}
+
+/*
+ * If an init function is provided, an exit function must also be provided
+ * to allow module unload.
+ */
+static void __exit crc32_bench_exit(void) { }
+
+module_init(crc32_bench_init);
+module_exit(crc32_bench_exit);
+
+module_param(sec, uint, 0);
+MODULE_PARM_DESC(sec, "Length in seconds of each measurement");
+module_param(offset, uint, 0);
+MODULE_PARM_DESC(offset, "Byte offset of the data from a cache line boundary");
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("CRC32 throughput benchmark");
@@ -60,6 +60,26 @@ const struct raid6_calls * const raid6_algos[] = {
 	&raid6_altivec4,
 	&raid6_altivec8,
 #endif
+#ifdef CONFIG_KERNEL_MODE_NEON
+	&raid6_neonx1,
+	&raid6_neonx2,
+	&raid6_neonx4,
+	&raid6_neonx8,
+#endif
+	NULL
+};
+
+void (*raid6_2data_recov)(int, size_t, int, int, void **);
+EXPORT_SYMBOL_GPL(raid6_2data_recov);
+
+void (*raid6_datap_recov)(int, size_t, int, void **);
+EXPORT_SYMBOL_GPL(raid6_datap_recov);
+
+const struct raid6_recov_calls *const raid6_recov_algos[] = {
+#ifdef CONFIG_KERNEL_MODE_NEON
+	&raid6_recov_neon,
+#endif
+	&raid6_recov_intx1,
 	NULL
 };
 
@@ -71,6 +91,81 @@ const struct raid6_calls * const raid6_algos[] = {
 #define time_before(x, y) ((x) < (y))
 #endif
 
+/* Number of stripes recovered in 2^RAID6_TIME_JIFFIES_LG2 jiffies */
+static unsigned long raid6_time_recov(const struct raid6_recov_calls *algo,
+				      int disks, void **dptrs)
+{
+	unsigned long perf = 0;
+	unsigned long j0, j1;
+
+	preempt_disable();
+	j0 = jiffies;
+	while ((j1 = jiffies) == j0)
+		cpu_relax();
+	while (time_before(jiffies, j1 + (1<<RAID6_TIME_JIFFIES_LG2))) {
+		algo->data2(disks, PAGE_SIZE, 0, 1, dptrs);
+		algo->datap(disks, PAGE_SIZE, 0, dptrs);
+		perf += 2;
+	}
+	preempt_enable();
+
+	return perf;
+}
+
+/*
+ * Time the usable recovery routines on the same data as the syndrome
+ * routines and pick the fastest, the higher priority one on a tie.
+ * They write the recovered blocks, so the two failed data blocks are
+ * pointed at the scratch pages rather than at raid6_gfmul.  Without
+ * scratch pages nothing is timed and priority alone decides.
+ */
+static void raid6_choose_recov(int disks, void **dptrs, char *scratch)
+{
+	const struct raid6_recov_calls *const *algo;
+	const struct raid6_recov_calls *best;
+	unsigned long perf, bestperf;
+	void *data0 = dptrs[0], *data1 = dptrs[1];
+
+	if (scratch) {
+		dptrs[0] = scratch;
+		dptrs[1] = scratch + PAGE_SIZE;
+	}
+
+	bestperf = 0;  best = NULL;
+
+	for (algo = raid6_recov_algos; *algo; algo++) {
+		if ((*algo)->valid && !(*algo)->valid())
+			continue;
+
+		perf = 0;
+		if (scratch) {
+			perf = raid6_time_recov(*algo, disks, dptrs);
+			printk("raid6: %-8s %5ld MB/s recovery\n",
+			       (*algo)->name,
+			       (perf*HZ) >> (20-16+RAID6_TIME_JIFFIES_LG2));
+		}
+
+		if (!best || perf > bestperf ||
+		    (perf == bestperf && (*algo)->priority > best->priority)) {
+			best = *algo;
+			bestperf = perf;
+		}
+	}
+
+	dptrs[0] = data0;
+	dptrs[1] = data1;
+
+	if (best) {
+		raid6_2data_recov = best->data2;
+		raid6_datap_recov = best->datap;
+
+		printk("raid6: using %s recovery algorithm (%ld MB/s)\n",
+		       best->name,
+		       (bestperf*HZ) >> (20-16+RAID6_TIME_JIFFIES_LG2));
+	} else
+		printk("raid6: Yikes! No recovery algorithm found!\n");
+}
+
 /* Try to pick the best algorithm */
 /* This code uses the gfmul table as convenient data set to abuse */
 
@@ -78,7 +173,7 @@ int __init raid6_select_algo(void)
 {
 	const struct raid6_calls * const * algo;
 	const struct raid6_calls * best;
-	char *syndromes;
+	char *syndromes, *scratch;
 	void *dptrs[(65536/PAGE_SIZE)+2];
 	int i, disks;
 	unsigned long perf, bestperf;
@@ -138,6 +233,12 @@ int __init raid6_select_algo(void)
 	} else
 		printk("raid6: Yikes!  No algorithm found!\n");
 
+	/* The recovery routines run on the syndromes computed above */
+	scratch = (void *) __get_free_pages(GFP_KERNEL, 1);
+	raid6_choose_recov(disks, dptrs, scratch);
+	if (scratch)
+		free_pages((unsigned long)scratch, 1);
+
 	free_pages((unsigned long)syndromes, 1);
 
 	return best ? 0 : -EINVAL;
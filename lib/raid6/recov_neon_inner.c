@@ -0,0 +1,102 @@
+/* -*- linux-c -*- ------------------------------------------------------- *
+ *
+ *   recov_neon_inner.c - inner loops of the NEON RAID-6 recovery
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, Inc., 53 Temple Place Ste 330,
+ *   Boston MA 02111-1307, USA; either version 2 of the License, or
+ *   (at your option) any later version; incorporated herein by reference.
+ *
+ * ----------------------------------------------------------------------- */
+
+/*
+ * This file is built with the NEON unit enabled in the compiler, and so
+ * must not include any kernel headers.  Each multiplication table passed
+ * in is a raid6_vgfmul[] entry: the products with the 16 possible low
+ * nibbles, followed by the products with the 16 possible high nibbles.
+ */
+
+#include <arm_neon.h>
+
+/* Multiply each byte of x by the constant described by the two tables */
+static inline uint8x16_t gf_mul(uint8x16_t x, uint8x8x2_t lo, uint8x8x2_t hi)
+{
+	uint8x16_t l = vandq_u8(x, vdupq_n_u8(0x0f));
+	uint8x16_t h = vshrq_n_u8(x, 4);
+
+	l = vcombine_u8(vtbl2_u8(lo, vget_low_u8(l)),
+			vtbl2_u8(lo, vget_high_u8(l)));
+	h = vcombine_u8(vtbl2_u8(hi, vget_low_u8(h)),
+			vtbl2_u8(hi, vget_high_u8(h)));
+	return veorq_u8(l, h);
+}
+
+static inline uint8x8x2_t load_tbl(const uint8_t *tbl)
+{
+	uint8x8x2_t t;
+
+	t.val[0] = vld1_u8(tbl);
+	t.val[1] = vld1_u8(tbl + 8);
+	return t;
+}
+
+void __raid6_2data_recov_neon(int bytes, uint8_t *p, uint8_t *q, uint8_t *dp,
+			      uint8_t *dq, const uint8_t *pbmul,
+			      const uint8_t *qmul)
+{
+	uint8x8x2_t pm0 = load_tbl(pbmul), pm1 = load_tbl(pbmul + 16);
+	uint8x8x2_t qm0 = load_tbl(qmul), qm1 = load_tbl(qmul + 16);
+
+	/*
+	 * while ( bytes-- ) {
+	 *	px    = *p ^ *dp;
+	 *	qx    = qmul[*q ^ *dq];
+	 *	*dq++ = db = pbmul[px] ^ qx;
+	 *	*dp++ = db ^ px;
+	 *	p++; q++;
+	 * }
+	 */
+	while (bytes) {
+		uint8x16_t px, qx, db;
+
+		px = veorq_u8(vld1q_u8(p), vld1q_u8(dp));
+		qx = gf_mul(veorq_u8(vld1q_u8(q), vld1q_u8(dq)), qm0, qm1);
+		db = veorq_u8(gf_mul(px, pm0, pm1), qx);
+
+		vst1q_u8(dq, db);
+		vst1q_u8(dp, veorq_u8(db, px));
+
+		bytes -= 16;
+		p += 16;
+		q += 16;
+		dp += 16;
+		dq += 16;
+	}
+}
+
+void __raid6_datap_recov_neon(int bytes, uint8_t *p, uint8_t *q, uint8_t *dq,
+			      const uint8_t *qmul)
+{
+	uint8x8x2_t qm0 = load_tbl(qmul), qm1 = load_tbl(qmul + 16);
+
+	/*
+	 * while ( bytes-- ) {
+	 *	*p++ ^= *dq = qmul[*q ^ *dq];
+	 *	q++; dq++;
+	 * }
+	 */
+	while (bytes) {
+		uint8x16_t vx;
+
+		vx = gf_mul(veorq_u8(vld1q_u8(q), vld1q_u8(dq)), qm0, qm1);
+
+		vst1q_u8(dq, vx);
+		vst1q_u8(p, veorq_u8(vx, vld1q_u8(p)));
+
+		bytes -= 16;
+		p += 16;
+		q += 16;
+		dq += 16;
+	}
+}
@@ -1386,6 +1386,93 @@ unsigned long zap_page_range(struct vm_area_struct *vma, unsigned long address,
 	return end;
 }
 
+/**
+ * detach_anon_pages - take over the pages of a private anonymous range
+ * @start: page aligned start of the range in the current mm
+ * @nr_pages: number of pages in the range, at most BITS_PER_LONG
+ * @pages: the pages backing the range, pinned by get_user_pages()
+ * @detached: bitmap of the pages that were detached
+ *
+ * Unmaps the range from the current process, which sees zero filled
+ * memory there from then on, as after MADV_DONTNEED. Every page that was
+ * mapped only there is then taken off the LRU and turned into a plain
+ * page that the caller holds the only reference to, as if it had been
+ * allocated with alloc_page(); its bit in @detached is set. Other pages
+ * stay pinned as they were. Ranges that are not private anonymous
+ * memory, or that span more than one vma, are left alone.
+ *
+ * Returns the number of pages detached.
+ */
+int detach_anon_pages(unsigned long start, unsigned int nr_pages,
+		      struct page **pages, unsigned long *detached)
+{
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
+	unsigned long end = start + (nr_pages << PAGE_SHIFT);
+	unsigned long candidates = 0;
+	unsigned int i;
+	int ret = 0;
+
+	*detached = 0;
+	if (WARN_ON(nr_pages > BITS_PER_LONG))
+		return 0;
+
+	down_read(&mm->mmap_sem);
+	vma = find_vma(mm, start);
+	if (!vma || vma->vm_start > start || vma->vm_end < end ||
+	    vma->vm_file || !vma->anon_vma ||
+	    (vma->vm_flags & (VM_SHARED | VM_LOCKED | VM_HUGETLB |
+			      VM_PFNMAP | VM_MIXEDMAP)))
+		goto out;
+
+	for (i = 0; i < nr_pages; i++) {
+		struct page *page = pages[i];
+
+		if (PageAnon(page) && !PageKsm(page) && !PageCompound(page) &&
+		    !PageSwapCache(page) && page_mapcount(page) == 1)
+			__set_bit(i, &candidates);
+	}
+
+	zap_page_range(vma, start, end - start, NULL);
+
+	for_each_set_bit(i, &candidates, nr_pages) {
+		struct page *page = pages[i];
+
+		/* isolation takes a reference of its own */
+		if (page_mapped(page) || isolate_lru_page(page))
+			continue;
+		if (!trylock_page(page)) {
+			putback_lru_page(page);
+			continue;
+		}
+		if (page_mapped(page) || PageSwapCache(page) ||
+		    page_count(page) != 2) {
+			unlock_page(page);
+			putback_lru_page(page);
+			continue;
+		}
+
+		/*
+		 * The last unmap already dropped the anon and memcg
+		 * accounting, what is left is the anon_vma pointer and
+		 * the flags that only make sense for anonymous memory.
+		 */
+		page->mapping = NULL;
+		ClearPageSwapBacked(page);
+		ClearPageActive(page);
+		ClearPageUnevictable(page);
+		ClearPageDirty(page);
+		unlock_page(page);
+		put_page(page);
+
+		__set_bit(i, detached);
+		ret++;
+	}
+out:
+	up_read(&mm->mmap_sem);
+	return ret;
+}
+
 /**
  * zap_vma_ptes - remove ptes mapping the vma
  * @vma: vm_area_struct holding ptes to be zapped
@@ -0,0 +1,266 @@
+/*
+ * TCP Fast Open: cookie generation and the client side cookie cache.
+ *
+ * A server hands out a cookie, an AES encryption of the client's address
+ * under a key only the server knows, in the SYN-ACK of a connection where
+ * the client asked for one.  On later connections the client puts the
+ * cookie and its first data in the SYN, and a server that validates the
+ * cookie passes that data to the application right away instead of one
+ * round trip later.
+ *
+ * The client remembers cookies per destination, along with the MSS that
+ * destination advertised, in a small direct-mapped cache; a cookie is
+ * only a hint, so losing one to a collision just costs one regular
+ * handshake.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/crypto.h>
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/ipv6.h>
+#include <linux/jhash.h>
+#include <linux/kernel.h>
+#include <linux/random.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <net/inet_common.h>
+#include <net/netns/hash.h>
+#include <net/tcp.h>
+
+int sysctl_tcp_fastopen __read_mostly;
+
+struct tcp_fastopen_context {
+	struct crypto_cipher	*tfm;
+	u8			key[TCP_FASTOPEN_KEY_LENGTH];
+	struct rcu_head		rcu;
+};
+
+static struct tcp_fastopen_context __rcu *tcp_fastopen_ctx;
+
+static DEFINE_SPINLOCK(tcp_fastopen_ctx_lock);
+
+static void tcp_fastopen_ctx_free(struct rcu_head *head)
+{
+	struct tcp_fastopen_context *ctx =
+	    container_of(head, struct tcp_fastopen_context, rcu);
+
+	crypto_free_cipher(ctx->tfm);
+	kfree(ctx);
+}
+
+int tcp_fastopen_reset_cipher(void *key, unsigned int len)
+{
+	struct tcp_fastopen_context *ctx, *octx;
+	int err;
+
+	ctx = kmalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+	ctx->tfm = crypto_alloc_cipher("aes", 0, 0);
+
+	if (IS_ERR(ctx->tfm)) {
+		err = PTR_ERR(ctx->tfm);
+error:		kfree(ctx);
+		pr_err("TCP: TFO aes cipher alloc error: %d\n", err);
+		return err;
+	}
+	err = crypto_cipher_setkey(ctx->tfm, key, len);
+	if (err) {
+		pr_err("TCP: TFO cipher key error: %d\n", err);
+		crypto_free_cipher(ctx->tfm);
+		goto error;
+	}
+	memcpy(ctx->key, key, len);
+
+	spin_lock(&tcp_fastopen_ctx_lock);
+
+	octx = rcu_dereference_protected(tcp_fastopen_ctx,
+				lockdep_is_held(&tcp_fastopen_ctx_lock));
+	rcu_assign_pointer(tcp_fastopen_ctx, ctx);
+	spin_unlock(&tcp_fastopen_ctx_lock);
+
+	if (octx)
+		call_rcu(&octx->rcu, tcp_fastopen_ctx_free);
+	return err;
+}
+
+/* Copies the current key to @key, all zeroes if there is none. */
+void tcp_fastopen_get_key(u8 *key)
+{
+	struct tcp_fastopen_context *ctx;
+
+	rcu_read_lock();
+	ctx = rcu_dereference(tcp_fastopen_ctx);
+	if (ctx)
+		memcpy(key, ctx->key, TCP_FASTOPEN_KEY_LENGTH);
+	else
+		memset(key, 0, TCP_FASTOPEN_KEY_LENGTH);
+	rcu_read_unlock();
+}
+
+/* Computes the fastopen cookie for the peer.
+ * The peer address is a 128 bits long (pad with zeros for IPv4).
+ *
+ * The caller must check foc->len to determine if a valid cookie
+ * has been generated successfully.
+ */
+void tcp_fastopen_cookie_gen(__be32 addr, struct tcp_fastopen_cookie *foc)
+{
+	__be32 peer_addr[4] = { addr, 0, 0, 0 };
+	struct tcp_fastopen_context *ctx;
+
+	rcu_read_lock();
+	ctx = rcu_dereference(tcp_fastopen_ctx);
+	if (ctx) {
+		crypto_cipher_encrypt_one(ctx->tfm, foc->val,
+					  (__u8 *)peer_addr);
+		foc->len = TCP_FASTOPEN_COOKIE_SIZE;
+	}
+	rcu_read_unlock();
+}
+
+/*
+ * Client side cookie cache
+ */
+#define TCP_FASTOPEN_CACHE_BITS	7
+
+struct tcp_fastopen_cache_entry {
+	struct net			*net;
+	unsigned short			family;
+	u16				mss;
+	__be32				daddr[4];
+	int				syn_loss;
+	unsigned long			last_syn_loss;
+	struct tcp_fastopen_cookie	cookie;
+};
+
+static struct tcp_fastopen_cache_entry
+	tcp_fastopen_cache[1 << TCP_FASTOPEN_CACHE_BITS];
+static DEFINE_SPINLOCK(tcp_fastopen_cache_lock);
+
+static struct tcp_fastopen_cache_entry *
+tcp_fastopen_cache_slot(const struct sock *sk, __be32 *daddr)
+{
+	u32 hash;
+
+	memset(daddr, 0, 4 * sizeof(*daddr));
+#if defined(CONFIG_IPV6) || defined(CONFIG_IPV6_MODULE)
+	if (sk->sk_family == AF_INET6)
+		memcpy(daddr, &inet6_sk(sk)->daddr, 4 * sizeof(*daddr));
+	else
+#endif
+		daddr[0] = inet_sk(sk)->inet_daddr;
+
+	hash = jhash2((__force u32 *)daddr, 4,
+		      sk->sk_family ^ net_hash_mix(sock_net(sk)));
+	return &tcp_fastopen_cache[hash >> (32 - TCP_FASTOPEN_CACHE_BITS)];
+}
+
+static bool tcp_fastopen_cache_match(const struct tcp_fastopen_cache_entry *e,
+				     const struct sock *sk, const __be32 *daddr)
+{
+	return e->net == sock_net(sk) && e->family == sk->sk_family &&
+	       !memcmp(e->daddr, daddr, sizeof(e->daddr));
+}
+
+void tcp_fastopen_cache_get(struct sock *sk, u16 *mss,
+			    struct tcp_fastopen_cookie *cookie,
+			    int *syn_loss, unsigned long *last_syn_loss)
+{
+	struct tcp_fastopen_cache_entry *e;
+	__be32 daddr[4];
+
+	e = tcp_fastopen_cache_slot(sk, daddr);
+	spin_lock_bh(&tcp_fastopen_cache_lock);
+	if (tcp_fastopen_cache_match(e, sk, daddr)) {
+		if (e->mss)
+			*mss = e->mss;
+		*cookie = e->cookie;
+		*syn_loss = e->syn_loss;
+		*last_syn_loss = *syn_loss ? e->last_syn_loss : 0;
+	}
+	spin_unlock_bh(&tcp_fastopen_cache_lock);
+}
+
+void tcp_fastopen_cache_set(struct sock *sk, u16 mss,
+			    struct tcp_fastopen_cookie *cookie, bool syn_lost)
+{
+	struct tcp_fastopen_cache_entry *e;
+	__be32 daddr[4];
+
+	e = tcp_fastopen_cache_slot(sk, daddr);
+	spin_lock_bh(&tcp_fastopen_cache_lock);
+	if (!tcp_fastopen_cache_match(e, sk, daddr)) {
+		memset(e, 0, sizeof(*e));
+		e->net = sock_net(sk);
+		e->family = sk->sk_family;
+		memcpy(e->daddr, daddr, sizeof(e->daddr));
+	}
+	e->mss = mss;
+	if (cookie->len > 0)
+		e->cookie = *cookie;
+	if (syn_lost) {
+		++e->syn_loss;
+		e->last_syn_loss = jiffies;
+	} else
+		e->syn_loss = 0;
+	spin_unlock_bh(&tcp_fastopen_cache_lock);
+}
+
+/*
+ * Server side
+ */
+static void tcp_fastopen_sock_destruct(struct sock *sk)
+{
+	inet_sock_destruct(sk);
+	kfree(inet_csk(sk)->icsk_accept_queue.fastopenq);
+}
+
+/* Enable Fast Open on a listener, allowing up to @backlog requests that
+ * have not finished their handshake yet.  A @backlog of 0 disables it.
+ */
+int tcp_fastopen_init_queue(struct sock *sk, int backlog)
+{
+	struct request_sock_queue *queue = &inet_csk(sk)->icsk_accept_queue;
+
+	if (queue->fastopenq == NULL) {
+		struct fastopen_queue *fastopenq;
+
+		fastopenq = kzalloc(sizeof(*fastopenq), sk->sk_allocation);
+		if (fastopenq == NULL)
+			return -ENOMEM;
+		spin_lock_init(&fastopenq->lock);
+
+		/* the receive path looks at fastopenq without the socket lock */
+		smp_wmb();
+		queue->fastopenq = fastopenq;
+		sk->sk_destruct = tcp_fastopen_sock_destruct;
+	}
+	queue->fastopenq->max_qlen = backlog;
+	return 0;
+}
+
+void tcp_free_fastopen_req(struct tcp_sock *tp)
+{
+	if (tp->fastopen_req != NULL) {
+		kfree(tp->fastopen_req);
+		tp->fastopen_req = NULL;
+	}
+}
+
+static int __init tcp_fastopen_init(void)
+{
+	__u8 key[TCP_FASTOPEN_KEY_LENGTH];
+
+	get_random_bytes(key, sizeof(key));
+	tcp_fastopen_reset_cipher(key, sizeof(key));
+	return 0;
+}
+
+late_initcall(tcp_fastopen_init);
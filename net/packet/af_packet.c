@@ -85,6 +85,8 @@
 #include <linux/virtio_net.h>
 #include <linux/errqueue.h>
 #include <linux/net_tstamp.h>
+#include <linux/ethtool.h>
+#include <linux/rtnetlink.h>
 
 #ifdef CONFIG_INET
 #include <net/inet_common.h>
@@ -161,13 +163,52 @@ struct packet_mreq_max {
 	unsigned char	mr_address[MAX_ADDR_LEN];
 };
 
-static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
+static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 		int closing, int tx_ring);
 
 struct pgv {
 	char *buffer;
 };
 
+/* kernel side state of a TPACKET_V3 ring */
+struct tpacket_kbdq_core {
+	struct pgv	*pkbdq;
+	unsigned int	feature_req_word;
+	unsigned int	hdrlen;
+	unsigned char	reset_pending_on_curr_blk;
+	unsigned char	delete_blk_timer;
+	unsigned short	kactive_blk_num;
+	unsigned short	blk_sizeof_priv;
+
+	/* block that was active when the timer was last refreshed, to
+	 * tell whether user space has caught up without touching the
+	 * timer for every packet
+	 */
+	unsigned short	last_kactive_blk_num;
+
+	char		*pkblk_start;
+	char		*pkblk_end;
+	int		kblk_size;
+	unsigned int	max_frame_len;
+	unsigned int	knum_blocks;
+	uint64_t	knxt_seq_num;
+	char		*prev;
+	char		*nxt_offset;
+	struct sk_buff	*skb;
+
+	atomic_t	blk_fill_in_prog;
+
+	/* Default is set to 8ms */
+#define DEFAULT_PRB_RETIRE_TOV	(8)
+
+	unsigned short	retire_blk_tov;
+	unsigned short	version;
+	unsigned long	tov_in_jiffies;
+
+	/* timer to retire an outstanding block */
+	struct timer_list retire_blk_timer;
+};
+
 struct packet_ring_buffer {
 	struct pgv		*pg_vec;
 	unsigned int		head;
@@ -179,6 +220,7 @@ struct packet_ring_buffer {
 	unsigned int		pg_vec_pages;
 	unsigned int		pg_vec_len;
 
+	struct tpacket_kbdq_core	prb_bdqc;
 	atomic_t		pending;
 };
 
@@ -192,7 +234,7 @@ struct packet_sock {
 	/* struct sock has to be the first member of packet_sock */
 	struct sock		sk;
 	struct packet_fanout	*fanout;
-	struct tpacket_stats	stats;
+	union tpacket_stats_u	stats;
 	struct packet_ring_buffer	rx_ring;
 	struct packet_ring_buffer	tx_ring;
 	int			copy_thresh;
@@ -402,6 +444,452 @@ static inline void packet_increment_head(struct packet_ring_buffer *buff)
 	buff->head = buff->head != buff->frame_max ? buff->head+1 : 0;
 }
 
+/*
+ * TPACKET_V3 block based receive ring
+ *
+ * Instead of one fixed size frame per packet, packets of any length are
+ * packed back to back into blocks, each one a struct tpacket3_hdr plus
+ * the data, and a whole block is handed to user space at once.  A block
+ * is retired either when the next packet doesn't fit in it any more or
+ * when the retire timer fires, so that user space is woken up once per
+ * block rather than once per packet, but still without undue delay when
+ * the traffic is light.  When user space hasn't released the next block
+ * yet, the queue is frozen and packets are dropped until it does.
+ *
+ * The block being filled and everything around it is protected by the
+ * receive queue lock, except for the copy of the packet data which runs
+ * unlocked: blk_fill_in_prog counts those copies so that a block is not
+ * handed to user space while one is in progress.
+ */
+
+#define V3_ALIGNMENT		(8)
+
+#define BLK_HDR_LEN		(ALIGN(sizeof(struct tpacket_block_desc), V3_ALIGNMENT))
+
+#define BLK_PLUS_PRIV(sz_of_priv) \
+	(BLK_HDR_LEN + ALIGN((sz_of_priv), V3_ALIGNMENT))
+
+#define TOTAL_PKT_LEN_INCL_ALIGN(length) (ALIGN((length), V3_ALIGNMENT))
+
+#define BLOCK_STATUS(x)		((x)->hdr.bh1.block_status)
+#define BLOCK_NUM_PKTS(x)	((x)->hdr.bh1.num_pkts)
+#define BLOCK_O2FP(x)		((x)->hdr.bh1.offset_to_first_pkt)
+#define BLOCK_LEN(x)		((x)->hdr.bh1.blk_len)
+#define BLOCK_SNUM(x)		((x)->hdr.bh1.seq_num)
+#define BLOCK_O2PRIV(x)		((x)->offset_to_priv)
+
+#define GET_PBDQC_FROM_RB(x)	((struct tpacket_kbdq_core *)(&(x)->prb_bdqc))
+#define GET_PBLOCK_DESC(x, bid)	\
+	((struct tpacket_block_desc *)((x)->pkbdq[(bid)].buffer))
+#define GET_CURR_PBLOCK_DESC_FROM_CORE(x)	\
+	((struct tpacket_block_desc *)((x)->pkbdq[(x)->kactive_blk_num].buffer))
+#define GET_NEXT_PRB_BLK_NUM(x) \
+	(((x)->kactive_blk_num < ((x)->knum_blocks-1)) ? \
+	((x)->kactive_blk_num+1) : 0)
+
+static void prb_retire_rx_blk_timer_expired(unsigned long data);
+static void prb_open_block(struct tpacket_kbdq_core *pkc,
+			   struct tpacket_block_desc *pbd);
+
+/*
+ * Derive a retire timeout from the link speed when user space doesn't
+ * give one: roughly the time it takes to fill a block at line rate.
+ */
+static int prb_calc_retire_blk_tmo(struct packet_sock *po,
+				   int blk_size_in_bytes)
+{
+	struct net_device *dev;
+	unsigned int mbits, div = 0;
+	struct ethtool_cmd ecmd;
+	int err = -ENODEV;
+	u32 speed = 0;
+
+	rtnl_lock();
+	dev = __dev_get_by_index(sock_net(&po->sk), po->ifindex);
+	if (dev) {
+		err = dev_ethtool_get_settings(dev, &ecmd);
+		speed = ethtool_cmd_speed(&ecmd);
+	}
+	rtnl_unlock();
+
+	/* if the link is that slow, there's no need to bother */
+	if (err || speed < SPEED_1000 || speed == (u32)-1)
+		return DEFAULT_PRB_RETIRE_TOV;
+
+	div = speed / 1000;
+	mbits = (blk_size_in_bytes * 8) / (1024 * 1024) / div;
+
+	return mbits + 1;
+}
+
+static void init_prb_bdqc(struct packet_sock *po,
+			  struct packet_ring_buffer *rb,
+			  struct pgv *pg_vec,
+			  struct tpacket_req3 *req3,
+			  unsigned int retire_blk_tov)
+{
+	struct tpacket_kbdq_core *p1 = GET_PBDQC_FROM_RB(rb);
+	struct tpacket_block_desc *pbd;
+
+	memset(p1, 0, sizeof(*p1));
+
+	p1->knxt_seq_num = 1;
+	p1->pkbdq = pg_vec;
+	pbd = (struct tpacket_block_desc *)pg_vec[0].buffer;
+	p1->pkblk_start = pg_vec[0].buffer;
+	p1->kblk_size = req3->tp_block_size;
+	p1->knum_blocks = req3->tp_block_nr;
+	p1->hdrlen = po->tp_hdrlen;
+	p1->version = po->tp_version;
+	p1->last_kactive_blk_num = 0;
+	po->stats.stats3.tp_freeze_q_cnt = 0;
+	p1->retire_blk_tov = retire_blk_tov;
+	p1->tov_in_jiffies = msecs_to_jiffies(p1->retire_blk_tov);
+	p1->blk_sizeof_priv = req3->tp_sizeof_priv;
+	p1->max_frame_len = p1->kblk_size - BLK_PLUS_PRIV(p1->blk_sizeof_priv);
+	p1->feature_req_word = req3->tp_feature_req_word;
+
+	setup_timer(&p1->retire_blk_timer, prb_retire_rx_blk_timer_expired,
+		    (unsigned long)po);
+	prb_open_block(p1, pbd);
+}
+
+/*
+ * Called with the receive queue lock held.  The timer is only refreshed
+ * when a block is opened, not for every packet.
+ */
+static void _prb_refresh_rx_retire_blk_timer(struct tpacket_kbdq_core *pkc)
+{
+	mod_timer(&pkc->retire_blk_timer, jiffies + pkc->tov_in_jiffies);
+	pkc->last_kactive_blk_num = pkc->kactive_blk_num;
+}
+
+static int prb_queue_frozen(struct tpacket_kbdq_core *pkc)
+{
+	return pkc->reset_pending_on_curr_blk;
+}
+
+static void prb_freeze_queue(struct tpacket_kbdq_core *pkc,
+			     struct packet_sock *po)
+{
+	pkc->reset_pending_on_curr_blk = 1;
+	po->stats.stats3.tp_freeze_q_cnt++;
+}
+
+static void prb_thaw_queue(struct tpacket_kbdq_core *pkc)
+{
+	pkc->reset_pending_on_curr_blk = 0;
+}
+
+static int prb_curr_blk_in_use(struct tpacket_kbdq_core *pkc,
+			       struct tpacket_block_desc *pbd)
+{
+	return TP_STATUS_USER & BLOCK_STATUS(pbd);
+}
+
+/* wait for the unlocked skb_copy_bits() calls into the block to finish */
+static void prb_wait_for_fill(struct tpacket_kbdq_core *pkc)
+{
+	while (atomic_read(&pkc->blk_fill_in_prog))
+		cpu_relax();
+}
+
+static void prb_flush_block(struct tpacket_kbdq_core *pkc,
+			    struct tpacket_block_desc *pbd, __u32 status)
+{
+#if ARCH_IMPLEMENTS_FLUSH_DCACHE_PAGE == 1
+	u8 *start, *end;
+
+	/* everything but the first page, which holds the block header */
+	end = (u8 *)PAGE_ALIGN((unsigned long)pkc->pkblk_end);
+	for (start = (u8 *)pbd + PAGE_SIZE; start < end; start += PAGE_SIZE)
+		flush_dcache_page(pgv_to_page(start));
+	smp_wmb();
+#endif
+
+	BLOCK_STATUS(pbd) = status;
+
+#if ARCH_IMPLEMENTS_FLUSH_DCACHE_PAGE == 1
+	flush_dcache_page(pgv_to_page(pbd));
+	smp_wmb();
+#endif
+}
+
+/*
+ * Hand the current block to user space and move on to the next one.
+ * The timer isn't refreshed here since the next block is almost always
+ * opened right away, which does it.
+ */
+static void prb_close_block(struct tpacket_kbdq_core *pkc,
+			    struct tpacket_block_desc *pbd,
+			    struct packet_sock *po, unsigned int stat)
+{
+	__u32 status = TP_STATUS_USER | stat;
+	struct tpacket3_hdr *last_pkt;
+	struct tpacket_hdr_v1 *h1 = &pbd->hdr.bh1;
+
+	if (po->stats.stats1.tp_drops)
+		status |= TP_STATUS_LOSING;
+
+	last_pkt = (struct tpacket3_hdr *)pkc->prev;
+	last_pkt->tp_next_offset = 0;
+
+	if (BLOCK_NUM_PKTS(pbd)) {
+		h1->ts_last_pkt.ts_sec = last_pkt->tp_sec;
+		h1->ts_last_pkt.ts_nsec = last_pkt->tp_nsec;
+	} else {
+		/* retired empty by the timer, use the current time */
+		struct timespec ts;
+
+		getnstimeofday(&ts);
+		h1->ts_last_pkt.ts_sec = ts.tv_sec;
+		h1->ts_last_pkt.ts_nsec = ts.tv_nsec;
+	}
+
+	smp_wmb();
+
+	prb_flush_block(pkc, pbd, status);
+
+	pkc->kactive_blk_num = GET_NEXT_PRB_BLK_NUM(pkc);
+}
+
+/*
+ * Opening a block thaws the queue and refreshes the retire timer.
+ */
+static void prb_open_block(struct tpacket_kbdq_core *pkc,
+			   struct tpacket_block_desc *pbd)
+{
+	struct timespec ts;
+	struct tpacket_hdr_v1 *h1 = &pbd->hdr.bh1;
+
+	smp_rmb();
+
+	if (unlikely(BLOCK_STATUS(pbd) != TP_STATUS_KERNEL)) {
+		pr_err("af_packet: block %p is not free, status %u, active block %u\n",
+		       pbd, BLOCK_STATUS(pbd), pkc->kactive_blk_num);
+		BUG();
+	}
+
+	/*
+	 * Don't clear the whole block, so that the private area is
+	 * kept from one use to the next.
+	 */
+	BLOCK_SNUM(pbd) = pkc->knxt_seq_num++;
+	BLOCK_NUM_PKTS(pbd) = 0;
+	BLOCK_LEN(pbd) = BLK_PLUS_PRIV(pkc->blk_sizeof_priv);
+	getnstimeofday(&ts);
+	h1->ts_first_pkt.ts_sec = ts.tv_sec;
+	h1->ts_first_pkt.ts_nsec = ts.tv_nsec;
+	pkc->pkblk_start = (char *)pbd;
+	pkc->nxt_offset = pkc->pkblk_start +
+			  BLK_PLUS_PRIV(pkc->blk_sizeof_priv);
+	BLOCK_O2FP(pbd) = (__u32)BLK_PLUS_PRIV(pkc->blk_sizeof_priv);
+	BLOCK_O2PRIV(pbd) = BLK_HDR_LEN;
+	pbd->version = pkc->version;
+	pkc->prev = pkc->nxt_offset;
+	pkc->pkblk_end = pkc->pkblk_start + pkc->kblk_size;
+
+	prb_thaw_queue(pkc);
+	_prb_refresh_rx_retire_blk_timer(pkc);
+
+	smp_wmb();
+}
+
+/*
+ * Open the next block if user space has released it, or freeze the
+ * queue otherwise.  Returns where the next packet goes, or NULL if the
+ * queue was frozen.
+ */
+static void *prb_dispatch_next_block(struct tpacket_kbdq_core *pkc,
+				     struct packet_sock *po)
+{
+	struct tpacket_block_desc *pbd;
+
+	smp_rmb();
+
+	pbd = GET_CURR_PBLOCK_DESC_FROM_CORE(pkc);
+	if (prb_curr_blk_in_use(pkc, pbd)) {
+		prb_freeze_queue(pkc, po);
+		return NULL;
+	}
+
+	prb_open_block(pkc, pbd);
+	return (void *)pkc->nxt_offset;
+}
+
+static void prb_retire_current_block(struct tpacket_kbdq_core *pkc,
+				     struct packet_sock *po,
+				     unsigned int status)
+{
+	struct tpacket_block_desc *pbd = GET_CURR_PBLOCK_DESC_FROM_CORE(pkc);
+
+	if (unlikely(BLOCK_STATUS(pbd) != TP_STATUS_KERNEL)) {
+		pr_err("af_packet: retiring block %u which is not ours\n",
+		       pkc->kactive_blk_num);
+		BUG();
+	}
+
+	/*
+	 * Another CPU may still be copying a packet into this block.
+	 * The timer handler has already waited for it.
+	 */
+	if (!(status & TP_STATUS_BLK_TMO))
+		prb_wait_for_fill(pkc);
+	prb_close_block(pkc, pbd, po, status);
+}
+
+static void prb_retire_rx_blk_timer_expired(unsigned long data)
+{
+	struct packet_sock *po = (struct packet_sock *)data;
+	struct tpacket_kbdq_core *pkc = GET_PBDQC_FROM_RB(&po->rx_ring);
+	struct tpacket_block_desc *pbd;
+
+	spin_lock(&po->sk.sk_receive_queue.lock);
+
+	if (unlikely(pkc->delete_blk_timer))
+		goto out;
+
+	pbd = GET_CURR_PBLOCK_DESC_FROM_CORE(pkc);
+
+	/*
+	 * tpacket_rcv() reserves room in the block under the lock, but
+	 * copies the packet after dropping it: don't retire a block with
+	 * a copy still in progress.
+	 */
+	if (BLOCK_NUM_PKTS(pbd))
+		prb_wait_for_fill(pkc);
+
+	/* nothing to do if a new block was opened since the last time */
+	if (pkc->last_kactive_blk_num == pkc->kactive_blk_num) {
+		if (!prb_queue_frozen(pkc)) {
+			prb_retire_current_block(pkc, po, TP_STATUS_BLK_TMO);
+			if (prb_dispatch_next_block(pkc, po))
+				goto out;
+		} else if (!prb_curr_blk_in_use(pkc, pbd)) {
+			/*
+			 * The queue was frozen, user space has caught up
+			 * since, but the link has gone idle: reopen the
+			 * block now, which also restarts the timer.
+			 */
+			prb_open_block(pkc, pbd);
+			goto out;
+		}
+		/* otherwise user space is still behind, check again later */
+	}
+
+	_prb_refresh_rx_retire_blk_timer(pkc);
+out:
+	spin_unlock(&po->sk.sk_receive_queue.lock);
+}
+
+static void prb_fill_curr_block(char *curr, struct tpacket_kbdq_core *pkc,
+				struct tpacket_block_desc *pbd,
+				unsigned int len)
+{
+	struct tpacket3_hdr *ppd = (struct tpacket3_hdr *)curr;
+	struct sk_buff *skb = pkc->skb;
+
+	ppd->tp_next_offset = TOTAL_PKT_LEN_INCL_ALIGN(len);
+	pkc->prev = curr;
+	pkc->nxt_offset += TOTAL_PKT_LEN_INCL_ALIGN(len);
+	BLOCK_LEN(pbd) += TOTAL_PKT_LEN_INCL_ALIGN(len);
+	BLOCK_NUM_PKTS(pbd) += 1;
+	atomic_inc(&pkc->blk_fill_in_prog);
+
+	if (vlan_tx_tag_present(skb)) {
+		ppd->hv1.tp_vlan_tci = vlan_tx_tag_get(skb);
+		ppd->tp_status = TP_STATUS_VLAN_VALID;
+	} else {
+		ppd->hv1.tp_vlan_tci = 0;
+		ppd->tp_status = 0;
+	}
+	if (pkc->feature_req_word & TP_FT_REQ_FILL_RXHASH)
+		ppd->hv1.tp_rxhash = skb_get_rxhash(skb);
+	else
+		ppd->hv1.tp_rxhash = 0;
+}
+
+/* Called with the receive queue lock held. */
+static void *__packet_lookup_frame_in_block(struct packet_sock *po,
+					    struct sk_buff *skb,
+					    unsigned int len)
+{
+	struct tpacket_kbdq_core *pkc = GET_PBDQC_FROM_RB(&po->rx_ring);
+	struct tpacket_block_desc *pbd = GET_CURR_PBLOCK_DESC_FROM_CORE(pkc);
+	char *curr, *end;
+
+	if (prb_queue_frozen(pkc)) {
+		/* is the block which froze the queue still in use? */
+		if (prb_curr_blk_in_use(pkc, pbd))
+			return NULL;
+		prb_open_block(pkc, pbd);
+	}
+
+	smp_mb();
+	curr = pkc->nxt_offset;
+	pkc->skb = skb;
+	end = (char *)pbd + pkc->kblk_size;
+
+	if (curr + TOTAL_PKT_LEN_INCL_ALIGN(len) < end) {
+		prb_fill_curr_block(curr, pkc, pbd, len);
+		return (void *)curr;
+	}
+
+	/* doesn't fit in the current block: close it, try the next one */
+	prb_retire_current_block(pkc, po, 0);
+
+	curr = (char *)prb_dispatch_next_block(pkc, po);
+	if (curr) {
+		pbd = GET_CURR_PBLOCK_DESC_FROM_CORE(pkc);
+		prb_fill_curr_block(curr, pkc, pbd, len);
+		return (void *)curr;
+	}
+
+	/* the queue was just frozen, this packet is dropped */
+	return NULL;
+}
+
+static void *packet_current_rx_frame(struct packet_sock *po,
+				     struct sk_buff *skb,
+				     int status, unsigned int len)
+{
+	switch (po->tp_version) {
+	case TPACKET_V1:
+	case TPACKET_V2:
+		return packet_current_frame(po, &po->rx_ring, status);
+	case TPACKET_V3:
+		return __packet_lookup_frame_in_block(po, skb, len);
+	default:
+		pr_err("TPACKET version not supported\n");
+		BUG();
+		return NULL;
+	}
+}
+
+static void *packet_previous_rx_frame(struct packet_sock *po,
+				      struct packet_ring_buffer *rb,
+				      int status)
+{
+	struct tpacket_kbdq_core *pkc = GET_PBDQC_FROM_RB(rb);
+	struct tpacket_block_desc *pbd;
+	unsigned int prev;
+
+	if (po->tp_version <= TPACKET_V2)
+		return packet_previous_frame(po, rb, status);
+
+	prev = pkc->kactive_blk_num ? pkc->kactive_blk_num - 1 :
+				      pkc->knum_blocks - 1;
+	pbd = GET_PBLOCK_DESC(pkc, prev);
+	if (status != BLOCK_STATUS(pbd))
+		return NULL;
+	return pbd;
+}
+
+static void prb_clear_blk_fill_status(struct packet_ring_buffer *rb)
+{
+	atomic_dec(&GET_PBDQC_FROM_RB(rb)->blk_fill_in_prog);
+}
+
 static void packet_sock_destruct(struct sock *sk)
 {
 	skb_queue_purge(&sk->sk_error_queue);
@@ -953,7 +1441,7 @@ static int packet_rcv(struct sk_buff *skb, struct net_device *dev,
 	nf_reset(skb);
 
 	spin_lock(&sk->sk_receive_queue.lock);
-	po->stats.tp_packets++;
+	po->stats.stats1.tp_packets++;
 	skb->dropcount = atomic_read(&sk->sk_drops);
 	__skb_queue_tail(&sk->sk_receive_queue, skb);
 	spin_unlock(&sk->sk_receive_queue.lock);
@@ -962,7 +1450,7 @@ static int packet_rcv(struct sk_buff *skb, struct net_device *dev,
 
 drop_n_acct:
 	spin_lock(&sk->sk_receive_queue.lock);
-	po->stats.tp_drops++;
+	po->stats.stats1.tp_drops++;
 	atomic_inc(&sk->sk_drops);
 	spin_unlock(&sk->sk_receive_queue.lock);
 
@@ -985,12 +1473,13 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 	union {
 		struct tpacket_hdr *h1;
 		struct tpacket2_hdr *h2;
+		struct tpacket3_hdr *h3;
 		void *raw;
 	} h;
 	u8 *skb_head = skb->data;
 	int skb_len = skb->len;
 	unsigned int snaplen, res;
-	unsigned long status = TP_STATUS_LOSING|TP_STATUS_USER;
+	unsigned long status = TP_STATUS_USER;
 	unsigned short macoff, netoff, hdrlen;
 	struct sk_buff *copy_skb = NULL;
 	struct timeval tv;
@@ -1037,7 +1526,18 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 		macoff = netoff - maclen;
 	}
 
-	if (macoff + snaplen > po->rx_ring.frame_size) {
+	if (po->tp_version == TPACKET_V3) {
+		unsigned int max_len = GET_PBDQC_FROM_RB(&po->rx_ring)->max_frame_len;
+
+		/* a packet can't span blocks */
+		if (unlikely(macoff + snaplen > max_len)) {
+			snaplen = max_len - macoff;
+			if ((int)snaplen < 0) {
+				snaplen = 0;
+				macoff = max_len;
+			}
+		}
+	} else if (macoff + snaplen > po->rx_ring.frame_size) {
 		if (po->copy_thresh &&
 		    atomic_read(&sk->sk_rmem_alloc) + skb->truesize <
 		    (unsigned)sk->sk_rcvbuf) {
@@ -1056,17 +1556,21 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 	}
 
 	spin_lock(&sk->sk_receive_queue.lock);
-	h.raw = packet_current_frame(po, &po->rx_ring, TP_STATUS_KERNEL);
+	h.raw = packet_current_rx_frame(po, skb, TP_STATUS_KERNEL,
+					macoff + snaplen);
 	if (!h.raw)
 		goto ring_is_full;
-	packet_increment_head(&po->rx_ring);
-	po->stats.tp_packets++;
+	if (po->tp_version <= TPACKET_V2) {
+		packet_increment_head(&po->rx_ring);
+		/* V3 reports losses per block, in prb_close_block() */
+		if (po->stats.stats1.tp_drops)
+			status |= TP_STATUS_LOSING;
+	}
+	po->stats.stats1.tp_packets++;
 	if (copy_skb) {
 		status |= TP_STATUS_COPY;
 		__skb_queue_tail(&sk->sk_receive_queue, copy_skb);
 	}
-	if (!po->stats.tp_drops)
-		status &= ~TP_STATUS_LOSING;
 	spin_unlock(&sk->sk_receive_queue.lock);
 
 	skb_copy_bits(skb, 0, h.raw + macoff, snaplen);
@@ -1117,6 +1621,29 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 		h.h2->tp_padding = 0;
 		hdrlen = sizeof(*h.h2);
 		break;
+	case TPACKET_V3:
+		/* tp_next_offset and the vlan/rxhash fields are already set,
+		 * and tp_status may already carry TP_STATUS_VLAN_VALID
+		 */
+		h.h3->tp_status |= status;
+		h.h3->tp_len = skb->len;
+		h.h3->tp_snaplen = snaplen;
+		h.h3->tp_mac = macoff;
+		h.h3->tp_net = netoff;
+		if ((po->tp_tstamp & SOF_TIMESTAMPING_SYS_HARDWARE)
+				&& shhwtstamps->syststamp.tv64)
+			ts = ktime_to_timespec(shhwtstamps->syststamp);
+		else if ((po->tp_tstamp & SOF_TIMESTAMPING_RAW_HARDWARE)
+				&& shhwtstamps->hwtstamp.tv64)
+			ts = ktime_to_timespec(shhwtstamps->hwtstamp);
+		else if (skb->tstamp.tv64)
+			ts = ktime_to_timespec(skb->tstamp);
+		else
+			getnstimeofday(&ts);
+		h.h3->tp_sec = ts.tv_sec;
+		h.h3->tp_nsec = ts.tv_nsec;
+		hdrlen = sizeof(*h.h3);
+		break;
 	default:
 		BUG();
 	}
@@ -1143,7 +1670,10 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 		smp_wmb();
 	}
 #endif
-	__packet_set_status(po, h.raw, status);
+	if (po->tp_version <= TPACKET_V2)
+		__packet_set_status(po, h.raw, status);
+	else
+		prb_clear_blk_fill_status(&po->rx_ring);
 
 	sk->sk_data_ready(sk, 0);
 
@@ -1157,7 +1687,7 @@ drop:
 	return 0;
 
 ring_is_full:
-	po->stats.tp_drops++;
+	po->stats.stats1.tp_drops++;
 	spin_unlock(&sk->sk_receive_queue.lock);
 
 	sk->sk_data_ready(sk, 0);
@@ -1634,7 +2164,7 @@ static int packet_release(struct socket *sock)
 	struct sock *sk = sock->sk;
 	struct packet_sock *po;
 	struct net *net;
-	struct tpacket_req req;
+	union tpacket_req_u req_u;
 
 	if (!sk)
 		return 0;
@@ -1657,13 +2187,13 @@ static int packet_release(struct socket *sock)
 
 	packet_flush_mclist(sk);
 
-	memset(&req, 0, sizeof(req));
+	memset(&req_u, 0, sizeof(req_u));
 
 	if (po->rx_ring.pg_vec)
-		packet_set_ring(sk, &req, 1, 0);
+		packet_set_ring(sk, &req_u, 1, 0);
 
 	if (po->tx_ring.pg_vec)
-		packet_set_ring(sk, &req, 1, 1);
+		packet_set_ring(sk, &req_u, 1, 1);
 
 	fanout_release(sk);
 
@@ -2283,15 +2813,27 @@ packet_setsockopt(struct socket *sock, int level, int optname, char __user *optv
 	case PACKET_RX_RING:
 	case PACKET_TX_RING:
 	{
-		struct tpacket_req req;
+		union tpacket_req_u req_u;
+		int len;
 
-		if (optlen < sizeof(req))
+		switch (po->tp_version) {
+		case TPACKET_V1:
+		case TPACKET_V2:
+			len = sizeof(req_u.req);
+			break;
+		case TPACKET_V3:
+		default:
+			len = sizeof(req_u.req3);
+			break;
+		}
+		if (optlen < len)
 			return -EINVAL;
 		if (pkt_sk(sk)->has_vnet_hdr)
 			return -EINVAL;
-		if (copy_from_user(&req, optval, sizeof(req)))
+		if (copy_from_user(&req_u, optval, len))
 			return -EFAULT;
-		return packet_set_ring(sk, &req, 0, optname == PACKET_TX_RING);
+		return packet_set_ring(sk, &req_u, 0,
+				       optname == PACKET_TX_RING);
 	}
 	case PACKET_COPY_THRESH:
 	{
@@ -2318,6 +2860,7 @@ packet_setsockopt(struct socket *sock, int level, int optname, char __user *optv
 		switch (val) {
 		case TPACKET_V1:
 		case TPACKET_V2:
+		case TPACKET_V3:
 			po->tp_version = val;
 			return 0;
 		default:
@@ -2426,7 +2969,7 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 	struct sock *sk = sock->sk;
 	struct packet_sock *po = pkt_sk(sk);
 	void *data;
-	struct tpacket_stats st;
+	union tpacket_stats_u st;
 
 	if (level != SOL_PACKET)
 		return -ENOPROTOOPT;
@@ -2439,13 +2982,18 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 
 	switch (optname) {
 	case PACKET_STATISTICS:
-		if (len > sizeof(struct tpacket_stats))
-			len = sizeof(struct tpacket_stats);
+		if (po->tp_version == TPACKET_V3) {
+			if (len > sizeof(struct tpacket_stats_v3))
+				len = sizeof(struct tpacket_stats_v3);
+		} else {
+			if (len > sizeof(struct tpacket_stats))
+				len = sizeof(struct tpacket_stats);
+		}
 		spin_lock_bh(&sk->sk_receive_queue.lock);
 		st = po->stats;
 		memset(&po->stats, 0, sizeof(st));
 		spin_unlock_bh(&sk->sk_receive_queue.lock);
-		st.tp_packets += st.tp_drops;
+		st.stats1.tp_packets += st.stats1.tp_drops;
 
 		data = &st;
 		break;
@@ -2488,6 +3036,9 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 		case TPACKET_V2:
 			val = sizeof(struct tpacket2_hdr);
 			break;
+		case TPACKET_V3:
+			val = sizeof(struct tpacket3_hdr);
+			break;
 		default:
 			return -EINVAL;
 		}
@@ -2644,7 +3195,8 @@ static unsigned int packet_poll(struct file *file, struct socket *sock,
 
 	spin_lock_bh(&sk->sk_receive_queue.lock);
 	if (po->rx_ring.pg_vec) {
-		if (!packet_previous_frame(po, &po->rx_ring, TP_STATUS_KERNEL))
+		if (!packet_previous_rx_frame(po, &po->rx_ring,
+					      TP_STATUS_KERNEL))
 			mask |= POLLIN | POLLRDNORM;
 	}
 	spin_unlock_bh(&sk->sk_receive_queue.lock);
@@ -2763,7 +3315,7 @@ out_free_pgvec:
 	goto out;
 }
 
-static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
+static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 		int closing, int tx_ring)
 {
 	struct pgv *pg_vec = NULL;
@@ -2771,12 +3323,22 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
 	int was_running, order = 0;
 	struct packet_ring_buffer *rb;
 	struct sk_buff_head *rb_queue;
+	struct tpacket_req *req = &req_u->req;
+	/* block based ring, which needs its retire timer */
+	bool blocks = po->tp_version == TPACKET_V3 && !tx_ring;
+	bool stop_timer = false;
+	unsigned int retire_blk_tov = 0;
 	__be16 num;
 	int err;
 
 	rb = tx_ring ? &po->tx_ring : &po->rx_ring;
 	rb_queue = tx_ring ? &sk->sk_write_queue : &sk->sk_receive_queue;
 
+	err = -EINVAL;
+	/* a TPACKET_V3 transmit ring doesn't exist */
+	if (!closing && tx_ring && po->tp_version > TPACKET_V2)
+		goto out;
+
 	err = -EBUSY;
 	if (!closing) {
 		if (atomic_read(&po->mapped))
@@ -2798,6 +3360,9 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
 		case TPACKET_V2:
 			po->tp_hdrlen = TPACKET2_HDRLEN;
 			break;
+		case TPACKET_V3:
+			po->tp_hdrlen = TPACKET3_HDRLEN;
+			break;
 		}
 
 		err = -EINVAL;
@@ -2817,6 +3382,26 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
 		if (unlikely((rb->frames_per_block * req->tp_block_nr) !=
 					req->tp_frame_nr))
 			goto out;
+		if (blocks) {
+			struct tpacket_req3 *req3 = &req_u->req3;
+
+			/* the block descriptor, the private area and at
+			 * least one frame have to fit in a block
+			 */
+			if (unlikely(req3->tp_sizeof_priv >= req->tp_block_size ||
+				     BLK_PLUS_PRIV(req3->tp_sizeof_priv) +
+				     req->tp_frame_size > req->tp_block_size))
+				goto out;
+			if (unlikely(req->tp_block_nr > USHRT_MAX))
+				goto out;
+
+			retire_blk_tov = req3->tp_retire_blk_tov;
+			if (!retire_blk_tov)
+				retire_blk_tov = prb_calc_retire_blk_tmo(po,
+							req->tp_block_size);
+			retire_blk_tov = min_t(unsigned int, retire_blk_tov,
+					       USHRT_MAX);
+		}
 
 		err = -ENOMEM;
 		order = get_order(req->tp_block_size);
@@ -2854,6 +3439,14 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
 		rb->frame_max = (req->tp_frame_nr - 1);
 		rb->head = 0;
 		rb->frame_size = req->tp_frame_size;
+		if (blocks && rb->pg_vec) {
+			init_prb_bdqc(po, rb, rb->pg_vec, &req_u->req3,
+				      retire_blk_tov);
+		} else if (blocks && pg_vec) {
+			/* tearing the block ring down */
+			rb->prb_bdqc.delete_blk_timer = 1;
+			stop_timer = true;
+		}
 		spin_unlock_bh(&rb_queue->lock);
 
 		swap(rb->pg_vec_order, order);
@@ -2878,6 +3471,8 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
 
 	release_sock(sk);
 
+	if (stop_timer)
+		del_timer_sync(&rb->prb_bdqc.retire_blk_timer);
 	if (pg_vec)
 		free_pg_vec(pg_vec, order, req->tp_block_nr);
 out:
@@ -4,6 +4,15 @@
 extern int bench_sched_messaging(int argc, const char **argv, const char *prefix);
 extern int bench_sched_pipe(int argc, const char **argv, const char *prefix);
 extern int bench_mem_memcpy(int argc, const char **argv, const char *prefix __used);
+extern int bench_mem_memset(int argc, const char **argv, const char *prefix __used);
+extern int bench_mem_memmove(int argc, const char **argv, const char *prefix __used);
+extern int bench_mem_pagefault(int argc, const char **argv, const char *prefix __used);
+extern int bench_pipe_throughput(int argc, const char **argv, const char *prefix __used);
+extern int bench_futex_hash(int argc, const char **argv, const char *prefix __used);
+extern int bench_futex_wake(int argc, const char **argv, const char *prefix __used);
+extern int bench_futex_requeue(int argc, const char **argv, const char *prefix __used);
+extern int bench_epoll_wait(int argc, const char **argv, const char *prefix __used);
+extern int bench_epoll_ctl(int argc, const char **argv, const char *prefix __used);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
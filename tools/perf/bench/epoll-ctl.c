@@ -0,0 +1,233 @@
+/*
+ * epoll-ctl.c
+ *
+ * ctl: Cost of adding, modifying and removing epoll watches
+ *
+ * Every thread owns a set of eventfds and keeps adding all of them to an
+ * epoll instance, modifying and then removing them again, either with
+ * one epoll_ctl() per operation or with epoll_ctl_batch().  The threads
+ * either have an instance each or all share one, in which case they
+ * contend on its mutex.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/time.h>
+
+/* from include/linux/eventpoll.h, which clashes with sys/epoll.h */
+struct epoll_ctl_cmd {
+	int32_t		flags;
+	int32_t		op;
+	int32_t		fd;
+	u_int32_t	events;
+	u_int64_t	data;
+	int32_t		result;
+	u_int32_t	__reserved;
+};
+
+#define EPOLL_CTL_BATCH_MAX	256
+
+static int		nthreads;
+static int		nfds		= 64;
+static int		runtime		= 5;
+static bool		shared;
+static bool		batch;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of threads (default: online cpus)"),
+	OPT_INTEGER('f', "fds", &nfds,
+		    "Specify number of eventfds per thread"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify run time in seconds"),
+	OPT_BOOLEAN('s', "shared", &shared,
+		    "Share one epoll instance between all threads"),
+	OPT_BOOLEAN('b', "batch", &batch,
+		    "Use epoll_ctl_batch() instead of epoll_ctl()"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_ctl_usage[] = {
+	"perf bench epoll ctl <options>",
+	NULL
+};
+
+struct worker {
+	pthread_t		thread;
+	int			epfd;
+	int			*fds;
+	struct epoll_ctl_cmd	*cmds;
+	unsigned long		ops;
+};
+
+static volatile bool		done;
+static pthread_barrier_t	start_barrier;
+
+static void do_ctl(struct worker *w, int op, u_int32_t events)
+{
+	struct epoll_event ev;
+	int i;
+
+	for (i = 0; i < nfds; i++) {
+		ev.events = events;
+		ev.data.fd = w->fds[i];
+		if (epoll_ctl(w->epfd, op, w->fds[i], &ev))
+			die("epoll_ctl: %s\n", strerror(errno));
+	}
+}
+
+static void do_ctl_batch(struct worker *w, int op, u_int32_t events)
+{
+#ifdef __NR_epoll_ctl_batch
+	struct epoll_ctl_cmd *cmds = w->cmds;
+	int i, n, ret;
+
+	for (i = 0; i < nfds; i++) {
+		cmds[i].flags = 0;
+		cmds[i].op = op;
+		cmds[i].fd = w->fds[i];
+		cmds[i].events = events;
+		cmds[i].data = w->fds[i];
+	}
+
+	for (i = 0; i < nfds; i += n) {
+		n = min(nfds - i, EPOLL_CTL_BATCH_MAX);
+		ret = syscall(__NR_epoll_ctl_batch, w->epfd, 0, n, cmds + i);
+		if (ret < 0)
+			die("epoll_ctl_batch: %s\n", strerror(errno));
+		if (ret < n)
+			die("epoll_ctl_batch: %s\n",
+			    strerror(-cmds[i + ret].result));
+	}
+#else
+	die("epoll_ctl_batch() is not wired up for this architecture\n");
+#endif
+}
+
+static void *worker_fn(void *arg)
+{
+	void (*ctl)(struct worker *, int, u_int32_t);
+	struct worker *w = arg;
+	unsigned long ops = 0;
+
+	ctl = batch ? do_ctl_batch : do_ctl;
+	pthread_barrier_wait(&start_barrier);
+
+	while (!done) {
+		ctl(w, EPOLL_CTL_ADD, EPOLLIN);
+		ctl(w, EPOLL_CTL_MOD, EPOLLIN | EPOLLOUT);
+		ctl(w, EPOLL_CTL_DEL, 0);
+		ops += 3 * nfds;
+	}
+	w->ops = ops;
+	return NULL;
+}
+
+int bench_epoll_ctl(int argc, const char **argv,
+		    const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	struct worker *workers;
+	unsigned long ops = 0;
+	double secs;
+	int i, j;
+
+	argc = parse_options(argc, argv, options,
+			     bench_epoll_ctl_usage, 0);
+
+	if (!nthreads)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0 || nfds <= 0 || runtime <= 0) {
+		fprintf(stderr, "Invalid threads:%d, fds:%d or runtime:%d\n",
+			nthreads, nfds, runtime);
+		return 1;
+	}
+
+	workers = zalloc(nthreads * sizeof(*workers));
+	if (!workers)
+		die("memory allocation failed\n");
+
+	done = false;
+	pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
+	for (i = 0; i < nthreads; i++) {
+		struct worker *w = &workers[i];
+
+		if (!shared || !i) {
+			w->epfd = epoll_create(nfds);
+			if (w->epfd < 0)
+				die("epoll_create: %s\n", strerror(errno));
+		} else
+			w->epfd = workers[0].epfd;
+
+		w->fds = zalloc(nfds * sizeof(*w->fds));
+		w->cmds = zalloc(nfds * sizeof(*w->cmds));
+		if (!w->fds || !w->cmds)
+			die("memory allocation failed\n");
+		for (j = 0; j < nfds; j++) {
+			w->fds[j] = eventfd(0, EFD_NONBLOCK);
+			if (w->fds[j] < 0)
+				die("eventfd: %s\n", strerror(errno));
+		}
+
+		if (pthread_create(&w->thread, NULL, worker_fn, w))
+			die("pthread_create: %s\n", strerror(errno));
+	}
+
+	pthread_barrier_wait(&start_barrier);
+	BUG_ON(gettimeofday(&start, NULL));
+	sleep(runtime);
+	done = true;
+	for (i = 0; i < nthreads; i++)
+		pthread_join(workers[i].thread, NULL);
+	BUG_ON(gettimeofday(&stop, NULL));
+	pthread_barrier_destroy(&start_barrier);
+
+	for (i = 0; i < nthreads; i++) {
+		struct worker *w = &workers[i];
+
+		ops += w->ops;
+		for (j = 0; j < nfds; j++)
+			close(w->fds[j]);
+		if (!shared || !i)
+			close(w->epfd);
+		free(w->fds);
+		free(w->cmds);
+	}
+	free(workers);
+
+	timersub(&stop, &start, &diff);
+	secs = (double)diff.tv_sec + (double)diff.tv_usec / 1000000;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads with %d eventfds each, %s instance%s, "
+		       "%s, for %d sec\n\n", nthreads, nfds,
+		       shared ? "one shared" : "own", shared ? "" : "s",
+		       batch ? "epoll_ctl_batch()" : "epoll_ctl()", runtime);
+		printf(" %14lf ops/sec\n", ops / secs);
+		printf(" %14lf usecs/op per thread\n",
+		       secs * 1000000 * nthreads / ops);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", ops / secs);
+		break;
+
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	return 0;
+}
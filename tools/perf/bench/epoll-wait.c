@@ -0,0 +1,236 @@
+/*
+ * epoll-wait.c
+ *
+ * wait: Event delivery from a set of eventfds to threads in epoll_wait()
+ *
+ * One producer thread keeps signalling the eventfds round robin while
+ * the consumer threads wait for them with epoll_wait() and drain what
+ * they are handed.  The consumers either share one epoll instance, or
+ * each has its own instance watching all of the eventfds, plainly
+ * ("herd": every event wakes every waiting thread) or with EPOLLEXCLUSIVE
+ * (every event wakes one of them).  A wakeup that finds its eventfd
+ * already drained by another thread counts as wasted.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/time.h>
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE	(1u << 28)
+#endif
+
+static int		nthreads;
+static int		nfds		= 64;
+static int		runtime		= 5;
+static const char	*mode		= "shared";
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of waiting threads (default: online cpus)"),
+	OPT_INTEGER('f', "fds", &nfds,
+		    "Specify number of eventfds"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify run time in seconds"),
+	OPT_STRING('m', "mode", &mode, "shared",
+		    "Specify mode: shared (one epoll instance), herd (one "
+		    "instance per thread) or exclusive (one instance per "
+		    "thread, EPOLLEXCLUSIVE)"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_wait_usage[] = {
+	"perf bench epoll wait <options>",
+	NULL
+};
+
+struct worker {
+	pthread_t		thread;
+	int			epfd;
+	unsigned long		wakeups;
+	unsigned long		events;
+	unsigned long		wasted;
+};
+
+static int			*fds;
+static volatile bool		done;
+static pthread_barrier_t	start_barrier;
+
+static void *consumer_fn(void *arg)
+{
+	unsigned long wakeups = 0, events = 0, wasted = 0;
+	struct worker *w = arg;
+	struct epoll_event ev;
+	u_int64_t val;
+
+	pthread_barrier_wait(&start_barrier);
+
+	while (!done) {
+		/* time out now and then, to notice the end of the run */
+		if (epoll_wait(w->epfd, &ev, 1, 100) <= 0)
+			continue;
+		wakeups++;
+		if (read(ev.data.fd, &val, sizeof(val)) == sizeof(val))
+			events++;
+		else if (errno == EAGAIN)
+			wasted++;
+		else
+			die("read: %s\n", strerror(errno));
+	}
+	/* counted locally, so the threads don't share a hot cacheline */
+	w->wakeups = wakeups;
+	w->events = events;
+	w->wasted = wasted;
+	return NULL;
+}
+
+static void *producer_fn(void *arg)
+{
+	unsigned long *writes = arg;
+	u_int64_t one = 1;
+	int i = 0;
+
+	pthread_barrier_wait(&start_barrier);
+
+	while (!done) {
+		if (write(fds[i], &one, sizeof(one)) != sizeof(one))
+			die("write: %s\n", strerror(errno));
+		(*writes)++;
+		if (++i == nfds)
+			i = 0;
+	}
+	return NULL;
+}
+
+static int new_instance(u_int32_t flags)
+{
+	struct epoll_event ev;
+	int epfd, i;
+
+	epfd = epoll_create(nfds);
+	if (epfd < 0)
+		die("epoll_create: %s\n", strerror(errno));
+
+	for (i = 0; i < nfds; i++) {
+		ev.events = EPOLLIN | flags;
+		ev.data.fd = fds[i];
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev))
+			die("epoll_ctl: %s\n", strerror(errno));
+	}
+	return epfd;
+}
+
+int bench_epoll_wait(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	unsigned long wakeups = 0, events = 0, wasted = 0, writes = 0;
+	struct timeval start, stop, diff;
+	struct worker *workers;
+	pthread_t producer;
+	u_int32_t flags = 0;
+	bool shared = false;
+	double secs;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_epoll_wait_usage, 0);
+
+	if (!nthreads)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0 || nfds <= 0 || runtime <= 0) {
+		fprintf(stderr, "Invalid threads:%d, fds:%d or runtime:%d\n",
+			nthreads, nfds, runtime);
+		return 1;
+	}
+	if (!strcmp(mode, "shared"))
+		shared = true;
+	else if (!strcmp(mode, "exclusive"))
+		flags = EPOLLEXCLUSIVE;
+	else if (strcmp(mode, "herd")) {
+		fprintf(stderr, "Unknown mode:%s\n", mode);
+		return 1;
+	}
+
+	fds = zalloc(nfds * sizeof(*fds));
+	workers = zalloc(nthreads * sizeof(*workers));
+	if (!fds || !workers)
+		die("memory allocation failed\n");
+
+	for (i = 0; i < nfds; i++) {
+		fds[i] = eventfd(0, EFD_NONBLOCK);
+		if (fds[i] < 0)
+			die("eventfd: %s\n", strerror(errno));
+	}
+
+	done = false;
+	pthread_barrier_init(&start_barrier, NULL, nthreads + 2);
+	for (i = 0; i < nthreads; i++) {
+		if (!shared || !i)
+			workers[i].epfd = new_instance(flags);
+		else
+			workers[i].epfd = workers[0].epfd;
+		if (pthread_create(&workers[i].thread, NULL, consumer_fn,
+				   &workers[i]))
+			die("pthread_create: %s\n", strerror(errno));
+	}
+	if (pthread_create(&producer, NULL, producer_fn, &writes))
+		die("pthread_create: %s\n", strerror(errno));
+
+	pthread_barrier_wait(&start_barrier);
+	BUG_ON(gettimeofday(&start, NULL));
+	sleep(runtime);
+	done = true;
+	pthread_join(producer, NULL);
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		wakeups += workers[i].wakeups;
+		events += workers[i].events;
+		wasted += workers[i].wasted;
+		if (!shared || !i)
+			close(workers[i].epfd);
+	}
+	BUG_ON(gettimeofday(&stop, NULL));
+	pthread_barrier_destroy(&start_barrier);
+
+	for (i = 0; i < nfds; i++)
+		close(fds[i]);
+	free(fds);
+	free(workers);
+
+	timersub(&stop, &start, &diff);
+	secs = (double)diff.tv_sec + (double)diff.tv_usec / 1000000;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads waiting on %d eventfds, %s, for %d sec\n\n",
+		       nthreads, nfds, mode, runtime);
+		printf(" %14lf writes/sec\n", writes / secs);
+		printf(" %14lf reads/sec\n", events / secs);
+		printf(" %14lf wakeups/sec\n", wakeups / secs);
+		printf(" %14lf %% wasted wakeups\n",
+		       wakeups ? 100.0 * wasted / wakeups : 0.0);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf %lf %lf\n", events / secs, wakeups / secs,
+		       wakeups ? 100.0 * wasted / wakeups : 0.0);
+		break;
+
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	return 0;
+}
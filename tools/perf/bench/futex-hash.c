@@ -0,0 +1,149 @@
+/*
+ * futex-hash.c
+ *
+ * hash: Contention on the futex hash table
+ *
+ * Every thread owns a set of futexes and calls FUTEX_WAIT on them with a
+ * value they never hold, so each call hashes the futex, takes and drops
+ * the bucket lock and returns EWOULDBLOCK right away.  With more threads
+ * and futexes, more of them meet in the same buckets.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "futex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+static int		nthreads;
+static int		nfutexes	= 1024;
+static int		runtime		= 10;
+static bool		shared;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of threads (default: online cpus)"),
+	OPT_INTEGER('f', "futexes", &nfutexes,
+		    "Specify number of futexes per thread"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify run time in seconds"),
+	OPT_BOOLEAN('S', "shared", &shared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_hash_usage[] = {
+	"perf bench futex hash <options>",
+	NULL
+};
+
+struct worker {
+	pthread_t		thread;
+	u_int32_t		*futexes;
+	unsigned long		ops;
+};
+
+static int			futex_flag;
+static volatile bool		done;
+static pthread_barrier_t	start_barrier;
+
+static void *worker_fn(void *arg)
+{
+	struct worker *w = arg;
+	unsigned long ops = 0;
+	int i, ret;
+
+	pthread_barrier_wait(&start_barrier);
+
+	while (!done) {
+		for (i = 0; i < nfutexes; i++, ops++) {
+			ret = futex_wait(&w->futexes[i], 1234, futex_flag);
+			if (ret == 0 || errno != EWOULDBLOCK)
+				die("futex_wait: unexpected return %d: %s\n",
+				    ret, strerror(errno));
+		}
+	}
+	w->ops = ops;
+	return NULL;
+}
+
+int bench_futex_hash(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	struct worker *workers;
+	unsigned long ops = 0;
+	double secs;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_hash_usage, 0);
+
+	if (!nthreads)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0 || nfutexes <= 0 || runtime <= 0) {
+		fprintf(stderr, "Invalid threads:%d, futexes:%d or "
+			"runtime:%d\n", nthreads, nfutexes, runtime);
+		return 1;
+	}
+	futex_flag = shared ? 0 : FUTEX_PRIVATE_FLAG;
+
+	workers = zalloc(nthreads * sizeof(*workers));
+	if (!workers)
+		die("memory allocation failed\n");
+
+	done = false;
+	pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
+	for (i = 0; i < nthreads; i++) {
+		workers[i].futexes = zalloc(nfutexes * sizeof(u_int32_t));
+		if (!workers[i].futexes)
+			die("memory allocation failed\n");
+		if (pthread_create(&workers[i].thread, NULL, worker_fn,
+				   &workers[i]))
+			die("pthread_create: %s\n", strerror(errno));
+	}
+
+	pthread_barrier_wait(&start_barrier);
+	BUG_ON(gettimeofday(&start, NULL));
+	sleep(runtime);
+	done = true;
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		ops += workers[i].ops;
+		free(workers[i].futexes);
+	}
+	BUG_ON(gettimeofday(&stop, NULL));
+	pthread_barrier_destroy(&start_barrier);
+	free(workers);
+
+	timersub(&stop, &start, &diff);
+	secs = (double)diff.tv_sec + (double)diff.tv_usec / 1000000;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads hashing %d %s futexes each for %d sec\n\n",
+		       nthreads, nfutexes, shared ? "shared" : "private",
+		       runtime);
+		printf(" %14lf ops/sec\n", ops / secs);
+		printf(" %14lf ops/sec per thread\n", ops / secs / nthreads);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", ops / secs);
+		break;
+
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	return 0;
+}
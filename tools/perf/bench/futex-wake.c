@@ -0,0 +1,207 @@
+/*
+ * futex-wake.c
+ *
+ * wake:    Time to wake up a crowd of threads blocked on one futex
+ * requeue: Time to requeue a crowd of threads from one futex to another
+ *
+ * Each round starts the threads, lets all of them block in FUTEX_WAIT
+ * and then times the FUTEX_WAKE, or FUTEX_CMP_REQUEUE, calls it takes to
+ * get every one of them off the futex.  Requeued threads are woken up
+ * from the second futex afterwards, outside of the measurement.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "futex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+static int		nthreads;
+static int		iterations	= 10;
+static int		nwake		= 1;
+static int		nrequeue	= 1;
+static bool		shared;
+
+static const struct option wake_options[] = {
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of blocked threads (default: online cpus)"),
+	OPT_INTEGER('i', "iterations", &iterations,
+		    "Specify number of rounds"),
+	OPT_INTEGER('w', "nwake", &nwake,
+		    "Specify number of threads to wake per call"),
+	OPT_BOOLEAN('S', "shared", &shared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const struct option requeue_options[] = {
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of blocked threads (default: online cpus)"),
+	OPT_INTEGER('i', "iterations", &iterations,
+		    "Specify number of rounds"),
+	OPT_INTEGER('q', "nrequeue", &nrequeue,
+		    "Specify number of threads to requeue per call"),
+	OPT_BOOLEAN('S', "shared", &shared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_wake_usage[] = {
+	"perf bench futex wake <options>",
+	NULL
+};
+
+static const char * const bench_futex_requeue_usage[] = {
+	"perf bench futex requeue <options>",
+	NULL
+};
+
+static u_int32_t	futex1, futex2;
+static int		futex_flag;
+static volatile int	nblocked;
+
+static void *waiter_fn(void *arg __used)
+{
+	__sync_fetch_and_add(&nblocked, 1);
+
+	/* futex1 never changes, so only a wakeup gets us out of here */
+	while (futex_wait(&futex1, 0, futex_flag) && errno == EINTR)
+		;
+	return NULL;
+}
+
+static void block_threads(pthread_t *threads)
+{
+	int i;
+
+	nblocked = 0;
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&threads[i], NULL, waiter_fn, NULL))
+			die("pthread_create: %s\n", strerror(errno));
+
+	while (nblocked < nthreads)
+		usleep(1000);
+	/* give the last ones time to go to sleep in the kernel */
+	usleep(100000);
+}
+
+static int wake_all(u_int32_t *uaddr, int nr)
+{
+	int calls, ret, done = 0;
+
+	for (calls = 0; done < nthreads; calls++) {
+		ret = futex_wake(uaddr, nr, futex_flag);
+		if (ret < 0)
+			die("futex_wake: %s\n", strerror(errno));
+		done += ret;
+	}
+	return calls;
+}
+
+static int requeue_all(void)
+{
+	int calls, ret, done = 0;
+
+	for (calls = 0; done < nthreads; calls++) {
+		ret = futex_cmp_requeue(&futex1, 0, &futex2, 0, nrequeue,
+					futex_flag);
+		if (ret < 0)
+			die("futex_cmp_requeue: %s\n", strerror(errno));
+		done += ret;
+	}
+	return calls;
+}
+
+static int run_rounds(const char *name, bool requeue)
+{
+	struct timeval start, stop, diff;
+	unsigned long calls = 0;
+	double usecs = 0;
+	pthread_t *threads;
+	int i, j;
+
+	if (!nthreads)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0 || iterations <= 0 || nwake <= 0 ||
+	    nrequeue <= 0) {
+		fprintf(stderr, "Invalid threads:%d, iterations:%d, nwake:%d "
+			"or nrequeue:%d\n", nthreads, iterations, nwake,
+			nrequeue);
+		return 1;
+	}
+	futex_flag = shared ? 0 : FUTEX_PRIVATE_FLAG;
+
+	threads = zalloc(nthreads * sizeof(*threads));
+	if (!threads)
+		die("memory allocation failed\n");
+
+	for (i = 0; i < iterations; i++) {
+		block_threads(threads);
+
+		BUG_ON(gettimeofday(&start, NULL));
+		if (requeue)
+			calls += requeue_all();
+		else
+			calls += wake_all(&futex1, nwake);
+		BUG_ON(gettimeofday(&stop, NULL));
+
+		if (requeue)
+			wake_all(&futex2, nthreads);
+		for (j = 0; j < nthreads; j++)
+			pthread_join(threads[j], NULL);
+
+		timersub(&stop, &start, &diff);
+		usecs += (double)diff.tv_sec * 1000000 + diff.tv_usec;
+	}
+	free(threads);
+	usecs /= iterations;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %s %d threads blocked on a %s futex, %d per call, "
+		       "%d rounds\n\n", name, nthreads,
+		       shared ? "shared" : "private",
+		       requeue ? nrequeue : nwake, iterations);
+		printf(" %14lf usecs per round\n", usecs);
+		printf(" %14lf usecs per thread\n", usecs / nthreads);
+		printf(" %14lf calls per round\n",
+		       (double)calls / iterations);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", usecs);
+		break;
+
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	return 0;
+}
+
+int bench_futex_wake(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	argc = parse_options(argc, argv, wake_options,
+			     bench_futex_wake_usage, 0);
+
+	return run_rounds("Waking", false);
+}
+
+int bench_futex_requeue(int argc, const char **argv,
+			const char *prefix __used)
+{
+	argc = parse_options(argc, argv, requeue_options,
+			     bench_futex_requeue_usage, 0);
+
+	return run_rounds("Requeueing", true);
+}
@@ -0,0 +1,46 @@
+/*
+ * futex.h
+ *
+ * Glibc doesn't wrap futex(2), so the futex benchmarks call it through
+ * these helpers.
+ */
+
+#ifndef _FUTEX_H
+#define _FUTEX_H
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <linux/futex.h>
+
+/*
+ * The private flag is either 0 or FUTEX_PRIVATE_FLAG, depending on
+ * whether the benchmark was asked for shared futexes.
+ */
+static inline int
+futex_wait(u_int32_t *uaddr, u_int32_t val, int private)
+{
+	return syscall(__NR_futex, uaddr, FUTEX_WAIT | private, val,
+		       NULL, NULL, 0);
+}
+
+static inline int
+futex_wake(u_int32_t *uaddr, int nr_wake, int private)
+{
+	return syscall(__NR_futex, uaddr, FUTEX_WAKE | private, nr_wake,
+		       NULL, NULL, 0);
+}
+
+/*
+ * Wake up to nr_wake waiters on uaddr and move up to nr_requeue of the
+ * rest over to uaddr2, as long as *uaddr still holds val.
+ */
+static inline int
+futex_cmp_requeue(u_int32_t *uaddr, u_int32_t val, u_int32_t *uaddr2,
+		  int nr_wake, int nr_requeue, int private)
+{
+	return syscall(__NR_futex, uaddr, FUTEX_CMP_REQUEUE | private,
+		       nr_wake, (unsigned long)nr_requeue, uaddr2, val);
+}
+
+#endif /* _FUTEX_H */
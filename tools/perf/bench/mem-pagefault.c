@@ -0,0 +1,175 @@
+/*
+ * mem-pagefault.c
+ *
+ * pagefault: Rate of page faults on fresh anonymous memory
+ *
+ * Every thread maps its own region of the shared address space, touches
+ * each page of it once and unmaps it again, over and over until the run
+ * time is up.  With several threads the faults contend on mmap_sem and
+ * the page table locks of the one mm.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+static const char	*length_str	= "64MB";
+static const char	*mode		= "write";
+static int		nthreads	= 1;
+static int		runtime		= 5;
+
+static const struct option options[] = {
+	OPT_STRING('l', "length", &length_str, "64MB",
+		    "Specify length of memory each thread maps. "
+		    "available unit: B, KB, MB, GB (upper and lower)"),
+	OPT_STRING('m', "mode", &mode, "write",
+		    "Specify access: write (allocate pages) or read (map "
+		    "the zero page)"),
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of faulting threads"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify run time in seconds"),
+	OPT_END()
+};
+
+static const char * const bench_mem_pagefault_usage[] = {
+	"perf bench mem pagefault <options>",
+	NULL
+};
+
+struct worker {
+	pthread_t		thread;
+	unsigned long		faults;
+};
+
+static size_t			length;
+static long			page_size;
+static bool			write_mode;
+static volatile bool		done;
+static pthread_barrier_t	start_barrier;
+
+static void *worker_fn(void *arg)
+{
+	struct worker *w = arg;
+	unsigned long faults = 0;
+	volatile char *p;
+	char *buf;
+	size_t i;
+
+	pthread_barrier_wait(&start_barrier);
+
+	while (!done) {
+		buf = mmap(NULL, length, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (buf == MAP_FAILED)
+			die("mmap: %s\n", strerror(errno));
+#ifdef MADV_NOHUGEPAGE
+		/* one fault per page, not per huge page */
+		madvise(buf, length, MADV_NOHUGEPAGE);
+#endif
+
+		p = buf;
+		for (i = 0; i < length && !done; i += page_size) {
+			if (write_mode)
+				p[i] = 1;
+			else
+				(void)p[i];
+			faults++;
+		}
+		munmap(buf, length);
+	}
+	/* counted locally, so the threads don't share a hot cacheline */
+	w->faults = faults;
+	return NULL;
+}
+
+int bench_mem_pagefault(int argc, const char **argv,
+			const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	unsigned long faults = 0;
+	struct worker *workers;
+	double secs;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_pagefault_usage, 0);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	length = (size_t)perf_atoll((char *)length_str);
+	if ((s64)length < page_size) {
+		fprintf(stderr, "Invalid length:%s\n", length_str);
+		return 1;
+	}
+	if (!strcmp(mode, "write"))
+		write_mode = true;
+	else if (strcmp(mode, "read")) {
+		fprintf(stderr, "Unknown mode:%s\n", mode);
+		return 1;
+	}
+	if (nthreads <= 0 || runtime <= 0) {
+		fprintf(stderr, "Invalid threads:%d or runtime:%d\n",
+			nthreads, runtime);
+		return 1;
+	}
+
+	workers = zalloc(nthreads * sizeof(*workers));
+	if (!workers)
+		die("memory allocation failed\n");
+
+	done = false;
+	pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&workers[i].thread, NULL, worker_fn,
+				   &workers[i]))
+			die("pthread_create: %s\n", strerror(errno));
+
+	pthread_barrier_wait(&start_barrier);
+	BUG_ON(gettimeofday(&start, NULL));
+	sleep(runtime);
+	done = true;
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		faults += workers[i].faults;
+	}
+	BUG_ON(gettimeofday(&stop, NULL));
+	pthread_barrier_destroy(&start_barrier);
+	free(workers);
+
+	if (!faults)
+		die("no page faults in %d sec\n", runtime);
+
+	timersub(&stop, &start, &diff);
+	secs = (double)diff.tv_sec + (double)diff.tv_usec / 1000000;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d thread(s) %s faulting %s regions for %d sec\n\n",
+		       nthreads, write_mode ? "write" : "read", length_str,
+		       runtime);
+		printf(" %14lf faults/sec\n", faults / secs);
+		printf(" %14lf usecs/fault per thread\n",
+		       secs * 1000000 * nthreads / faults);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", faults / secs);
+		break;
+
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	return 0;
+}
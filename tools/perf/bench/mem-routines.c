@@ -0,0 +1,195 @@
+/*
+ * mem-routines.c
+ *
+ * memset:  Fill memory of various lengths with memset()
+ * memmove: Move overlapping memory of various lengths with memmove()
+ *
+ * Unlike memcpy, which times a single call on a cold buffer, these
+ * repeat the routine over a warm buffer until the total length is
+ * reached, so short lengths are measured too.  Each length in the list
+ * gets a result of its own.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define K 1024
+
+static const char	*lengths_str	= "64B,1KB,4KB,64KB,1MB,16MB";
+static const char	*total_str	= "1GB";
+static int		offset		= 64;
+
+static const struct option memset_options[] = {
+	OPT_STRING('l', "length", &lengths_str, "64B,...,16MB",
+		    "Specify comma separated lengths of memory to fill. "
+		    "available unit: B, KB, MB, GB (upper and lower)"),
+	OPT_STRING('t', "total", &total_str, "1GB",
+		    "Specify total length to fill for each length"),
+	OPT_END()
+};
+
+static const struct option memmove_options[] = {
+	OPT_STRING('l', "length", &lengths_str, "64B,...,16MB",
+		    "Specify comma separated lengths of memory to move. "
+		    "available unit: B, KB, MB, GB (upper and lower)"),
+	OPT_STRING('t', "total", &total_str, "1GB",
+		    "Specify total length to move for each length"),
+	OPT_INTEGER('o', "offset", &offset,
+		    "Specify distance between source and destination"),
+	OPT_END()
+};
+
+static const char * const bench_mem_memset_usage[] = {
+	"perf bench mem memset <options>",
+	NULL
+};
+
+static const char * const bench_mem_memmove_usage[] = {
+	"perf bench mem memmove <options>",
+	NULL
+};
+
+/*
+ * Called through pointers so that the compiler cannot see what the
+ * loops do and drop or inline them.
+ */
+static void *(*memset_fn)(void *, int, size_t) = memset;
+static void *(*memmove_fn)(void *, const void *, size_t) = memmove;
+
+static double timeval2double(struct timeval *ts)
+{
+	return (double)ts->tv_sec +
+		(double)ts->tv_usec / (double)1000000;
+}
+
+static void do_memset(char *buf, size_t len, u64 loops)
+{
+	u64 i;
+
+	for (i = 0; i < loops; i++)
+		memset_fn(buf, (int)i, len);
+}
+
+/* move back and forth, so both copy directions are exercised */
+static void do_memmove(char *buf, size_t len, u64 loops)
+{
+	u64 i;
+
+	for (i = 0; i < loops; i += 2) {
+		memmove_fn(buf + offset, buf, len);
+		memmove_fn(buf, buf + offset, len);
+	}
+}
+
+#define print_bps(x) do {					\
+		if (x < K)					\
+			printf(" %14lf B/Sec", x);		\
+		else if (x < K * K)				\
+			printf(" %14lf KB/Sec", x / K);		\
+		else if (x < K * K * K)				\
+			printf(" %14lf MB/Sec", x / K / K);	\
+		else						\
+			printf(" %14lf GB/Sec", x / K / K / K); \
+	} while (0)
+
+static int run_lengths(const char *name, size_t pad,
+		       void (*fn)(char *, size_t, u64))
+{
+	struct timeval tv_start, tv_end, tv_diff;
+	char *lengths, *str, *saveptr = NULL;
+	size_t len, total;
+	double bps;
+	u64 loops;
+	char *buf;
+
+	total = (size_t)perf_atoll((char *)total_str);
+	if ((s64)total <= 0) {
+		fprintf(stderr, "Invalid total:%s\n", total_str);
+		return 1;
+	}
+
+	lengths = strdup(lengths_str);
+	if (!lengths)
+		die("memory allocation failed\n");
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %s %s Bytes per length ...\n\n", name, total_str);
+
+	for (str = strtok_r(lengths, ",", &saveptr); str;
+	     str = strtok_r(NULL, ",", &saveptr)) {
+		len = (size_t)perf_atoll(str);
+		if ((s64)len <= 0) {
+			fprintf(stderr, "Invalid length:%s\n", str);
+			free(lengths);
+			return 1;
+		}
+
+		buf = zalloc(len + pad);
+		if (!buf)
+			die("memory allocation failed - maybe length is too large?\n");
+
+		/* an even number, so memmove ends where it started */
+		loops = (total / len) & ~1ULL;
+		if (!loops)
+			loops = 2;
+
+		/* warm up the caches and fault the buffer in */
+		fn(buf, len, 2);
+
+		BUG_ON(gettimeofday(&tv_start, NULL));
+		fn(buf, len, loops);
+		BUG_ON(gettimeofday(&tv_end, NULL));
+
+		timersub(&tv_end, &tv_start, &tv_diff);
+		bps = (double)len * loops / timeval2double(&tv_diff);
+		free(buf);
+
+		switch (bench_format) {
+		case BENCH_FORMAT_DEFAULT:
+			printf(" %14s:", str);
+			print_bps(bps);
+			printf("\n");
+			break;
+		case BENCH_FORMAT_SIMPLE:
+			printf("%zu %lf\n", len, bps);
+			break;
+		default:
+			/* reaching this means there's some disaster: */
+			die("unknown format: %d\n", bench_format);
+			break;
+		}
+	}
+
+	free(lengths);
+	return 0;
+}
+
+int bench_mem_memset(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	argc = parse_options(argc, argv, memset_options,
+			     bench_mem_memset_usage, 0);
+
+	return run_lengths("memset", 0, do_memset);
+}
+
+int bench_mem_memmove(int argc, const char **argv,
+		      const char *prefix __used)
+{
+	argc = parse_options(argc, argv, memmove_options,
+			     bench_mem_memmove_usage, 0);
+
+	if (offset <= 0) {
+		fprintf(stderr, "Invalid offset:%d\n", offset);
+		return 1;
+	}
+
+	return run_lengths("memmove", offset, do_memmove);
+}
@@ -0,0 +1,277 @@
+/*
+ * pipe-throughput.c
+ *
+ * throughput: Bulk data transfer through a pipe between two processes
+ *
+ * The writer produces each block in its own buffer and pushes it into the
+ * pipe with write(), vmsplice(), or vmsplice() with SPLICE_F_GIFT |
+ * SPLICE_F_MOVE, which hands the pages over to the pipe.  The reader
+ * either read()s the data or splice()s it on to a file with
+ * SPLICE_F_MOVE, so gifted pages can move into the page cache.
+ *
+ * Block n of the stream is filled with the byte n, and the reader checks
+ * that this is what comes out of the pipe, or what ends up in the output
+ * file if it is a regular one.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#ifndef F_SETPIPE_SZ
+#define F_SETPIPE_SZ	1031
+#endif
+#ifndef F_GETPIPE_SZ
+#define F_GETPIPE_SZ	1032
+#endif
+
+#define K 1024
+
+static const char	*length_str	= "1GB";
+static const char	*block_str	= "64KB";
+static const char	*writer		= "write";
+static const char	*reader		= "read";
+static const char	*output		= "/dev/null";
+static int		pipe_size;
+
+static const struct option options[] = {
+	OPT_STRING('l', "length", &length_str, "1GB",
+		    "Specify total length of data to transfer. "
+		    "available unit: B, KB, MB, GB (upper and lower)"),
+	OPT_STRING('b', "block", &block_str, "64KB",
+		    "Specify length of each write"),
+	OPT_STRING('w', "writer", &writer, "write",
+		    "Specify writer: write, vmsplice or gift"),
+	OPT_STRING('r', "reader", &reader, "read",
+		    "Specify reader: read or splice"),
+	OPT_STRING('o', "output", &output, "/dev/null",
+		    "Specify file the splice reader writes to"),
+	OPT_INTEGER('s', "pipe-size", &pipe_size,
+		    "Set pipe size with F_SETPIPE_SZ (default: let it grow)"),
+	OPT_END()
+};
+
+static const char * const bench_pipe_throughput_usage[] = {
+	"perf bench pipe throughput <options>",
+	NULL
+};
+
+static void check_data(const char *buf, size_t len, size_t pos, size_t block)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (buf[i] != (char)((pos + i) / block))
+			die("data mismatch at byte %zu\n", pos + i);
+	}
+}
+
+/* read everything from fd, checking it if asked to */
+static size_t do_read(int fd, size_t block, int verify)
+{
+	char *buf = malloc(block);
+	size_t pos = 0;
+	ssize_t ret;
+
+	if (!buf)
+		die("memory allocation failed\n");
+
+	while ((ret = read(fd, buf, block)) != 0) {
+		if (ret < 0) {
+			if (errno != EINTR)
+				die("read: %s\n", strerror(errno));
+			continue;
+		}
+		if (verify)
+			check_data(buf, ret, pos, block);
+		pos += ret;
+	}
+	free(buf);
+	return pos;
+}
+
+static void do_splice(int fd, size_t len, size_t block, int verify)
+{
+	struct stat st;
+	ssize_t ret;
+	int out;
+
+	out = open(output, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (out < 0)
+		die("open %s: %s\n", output, strerror(errno));
+
+	while ((ret = splice(fd, NULL, out, NULL, block, SPLICE_F_MOVE)) != 0) {
+		if (ret < 0 && errno != EINTR)
+			die("splice: %s\n", strerror(errno));
+	}
+
+	if (verify && !fstat(out, &st) && S_ISREG(st.st_mode)) {
+		if (lseek(out, 0, SEEK_SET) < 0)
+			die("lseek: %s\n", strerror(errno));
+		if (do_read(out, block, 1) != len)
+			die("short output file\n");
+	}
+	close(out);
+}
+
+/* produce len bytes block by block and push them into the pipe */
+static void do_write(int fd, size_t len, size_t block, int mode)
+{
+	unsigned int flags = 0;
+	struct iovec iov;
+	size_t done;
+	ssize_t ret;
+	char *buf;
+
+	buf = mmap(NULL, block, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		die("mmap: %s\n", strerror(errno));
+
+	if (mode == 2)
+		flags = SPLICE_F_GIFT | SPLICE_F_MOVE;
+
+	for (done = 0; done < len; done += block) {
+		/*
+		 * Produce the next block. After a gift the pages are gone
+		 * and this faults in fresh ones, which is the price of not
+		 * copying. Plain vmsplice() only pins the pages, so without
+		 * a gift this may change data still queued in the pipe,
+		 * which is why that is the one writer that is not checked.
+		 * A gift that is cut short must leave the rest of the block
+		 * in place for the next call.
+		 */
+		memset(buf, (int)(done / block), block);
+
+		iov.iov_base = buf;
+		iov.iov_len = block;
+		while (iov.iov_len) {
+			if (mode == 0)
+				ret = write(fd, iov.iov_base, iov.iov_len);
+			else
+				ret = vmsplice(fd, &iov, 1, flags);
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				die("%s: %s\n", mode ? "vmsplice" : "write",
+				    strerror(errno));
+			}
+			iov.iov_base = (char *)iov.iov_base + ret;
+			iov.iov_len -= ret;
+		}
+	}
+	munmap(buf, block);
+}
+
+int bench_pipe_throughput(int argc, const char **argv,
+			  const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	int fds[2], wait_stat, mode, final_size;
+	size_t len, block;
+	double secs, bps;
+	pid_t pid;
+
+	argc = parse_options(argc, argv, options,
+			     bench_pipe_throughput_usage, 0);
+
+	len = (size_t)perf_atoll((char *)length_str);
+	block = (size_t)perf_atoll((char *)block_str);
+	if ((s64)len <= 0 || (s64)block <= 0) {
+		fprintf(stderr, "Invalid length:%s or block:%s\n",
+			length_str, block_str);
+		return 1;
+	}
+	len -= len % block;
+
+	if (!strcmp(writer, "write"))
+		mode = 0;
+	else if (!strcmp(writer, "vmsplice"))
+		mode = 1;
+	else if (!strcmp(writer, "gift"))
+		mode = 2;
+	else {
+		fprintf(stderr, "Unknown writer:%s\n", writer);
+		return 1;
+	}
+	if (strcmp(reader, "read") && strcmp(reader, "splice")) {
+		fprintf(stderr, "Unknown reader:%s\n", reader);
+		return 1;
+	}
+	if (mode == 2 && block % sysconf(_SC_PAGESIZE)) {
+		fprintf(stderr, "gift needs page aligned blocks\n");
+		return 1;
+	}
+
+	if (pipe(fds))
+		die("pipe: %s\n", strerror(errno));
+	if (pipe_size && fcntl(fds[1], F_SETPIPE_SZ, pipe_size) < 0)
+		die("F_SETPIPE_SZ: %s\n", strerror(errno));
+
+	/* don't let the reader inherit buffered output */
+	fflush(stdout);
+
+	pid = fork();
+	if (pid < 0)
+		die("fork: %s\n", strerror(errno));
+	if (!pid) {
+		close(fds[1]);
+		if (!strcmp(reader, "read")) {
+			if (do_read(fds[0], block, mode != 1) != len)
+				die("short read\n");
+		} else
+			do_splice(fds[0], len, block, mode != 1);
+		exit(0);
+	}
+	close(fds[0]);
+
+	gettimeofday(&start, NULL);
+	do_write(fds[1], len, block, mode);
+	final_size = fcntl(fds[1], F_GETPIPE_SZ);
+	close(fds[1]);
+	if (waitpid(pid, &wait_stat, 0) != pid || !WIFEXITED(wait_stat) ||
+	    WEXITSTATUS(wait_stat))
+		die("reader failed\n");
+	gettimeofday(&stop, NULL);
+
+	timersub(&stop, &start, &diff);
+	secs = (double)diff.tv_sec + (double)diff.tv_usec / 1000000;
+	bps = secs > 0 ? (double)len / secs : 0;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Transferred %zu bytes in %zu byte blocks, "
+		       "%s -> %s\n\n", len, block, writer, reader);
+		printf(" %14s: %lu.%03lu [sec]\n", "Total time",
+		       diff.tv_sec, (unsigned long) (diff.tv_usec / 1000));
+		printf(" %14lf MB/Sec\n", bps / K / K);
+		printf(" %14d bytes final pipe size\n", final_size);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf %d\n", bps / K / K, final_size);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -13,6 +13,9 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  pipe  ... pipe and splice data transfer
+ *  futex ... futex operations
+ *  epoll ... epoll event delivery and management
  *
  */
 
@@ -52,6 +55,54 @@ static struct bench_suite mem_suites[] = {
 	{ "memcpy",
 	  "Simple memory copy in various ways",
 	  bench_mem_memcpy },
+	{ "memset",
+	  "Memory fill of various lengths",
+	  bench_mem_memset },
+	{ "memmove",
+	  "Overlapping memory move of various lengths",
+	  bench_mem_memmove },
+	{ "pagefault",
+	  "Page faults on fresh anonymous memory",
+	  bench_mem_pagefault },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite pipe_suites[] = {
+	{ "throughput",
+	  "Bulk data transfer through a pipe between two processes",
+	  bench_pipe_throughput },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL                  }
+};
+
+static struct bench_suite futex_suites[] = {
+	{ "hash",
+	  "Contention on the futex hash table",
+	  bench_futex_hash },
+	{ "wake",
+	  "Wake up threads blocked on one futex",
+	  bench_futex_wake },
+	{ "requeue",
+	  "Requeue threads blocked on one futex to another",
+	  bench_futex_requeue },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite epoll_suites[] = {
+	{ "wait",
+	  "Event delivery to threads in epoll_wait()",
+	  bench_epoll_wait },
+	{ "ctl",
+	  "Adding, modifying and removing epoll watches",
+	  bench_epoll_ctl },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -71,6 +122,15 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "pipe",
+	  "pipe and splice data transfer",
+	  pipe_suites },
+	{ "futex",
+	  "futex operations",
+	  futex_suites },
+	{ "epoll",
+	  "epoll event delivery and management",
+	  epoll_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "test all subsystem (pseudo subsystem)",
 	  NULL },
@@ -9,6 +9,7 @@
 #include "util/session.h"
 
 #include "util/parse-options.h"
+#include "util/parse-events.h"
 #include "util/trace-event.h"
 
 #include "util/debug.h"
@@ -721,6 +722,63 @@ struct trace_migrate_task_event {
 	u32 cpu;
 };
 
+struct trace_wake_affine_event {
+	u32 size;
+
+	u16 common_type;
+	u8 common_flags;
+	u8 common_preempt_count;
+	u32 common_pid;
+	u32 common_tgid;
+
+	char comm[16];
+	u32 pid;
+
+	s32 level;
+	u32 this_cpu;
+	u32 prev_cpu;
+	s64 this_load;
+	s64 prev_load;
+	u32 reason;
+};
+
+struct trace_select_task_rq_event {
+	u32 size;
+
+	u16 common_type;
+	u8 common_flags;
+	u8 common_preempt_count;
+	u32 common_pid;
+	u32 common_tgid;
+
+	char comm[16];
+	u32 pid;
+
+	u32 sd_flag;
+	s32 level;
+	u32 prev_cpu;
+	u32 target_cpu;
+	u32 reason;
+};
+
+struct trace_load_balance_event {
+	u32 size;
+
+	u16 common_type;
+	u8 common_flags;
+	u8 common_preempt_count;
+	u32 common_pid;
+	u32 common_tgid;
+
+	u32 cpu;
+	u32 idle;
+	s32 level;
+	s32 busiest_cpu;
+	u64 imbalance;
+	u32 nr_moved;
+	u32 reason;
+};
+
 struct trace_sched_handler {
 	void (*switch_event)(struct trace_switch_event *,
 			     struct perf_session *,
@@ -755,6 +813,18 @@ struct trace_sched_handler {
 			   int cpu,
 			   u64 timestamp,
 			   struct thread *thread);
+
+	void (*wake_affine_event)(struct trace_wake_affine_event *,
+				  int cpu,
+				  u64 timestamp);
+
+	void (*select_task_rq_event)(struct trace_select_task_rq_event *,
+				     int cpu,
+				     u64 timestamp);
+
+	void (*load_balance_event)(struct trace_load_balance_event *,
+				   int cpu,
+				   u64 timestamp);
 };
 
 
@@ -1574,6 +1644,69 @@ process_sched_migrate_task_event(void *data, struct perf_session *session,
 						 event, cpu, timestamp, thread);
 }
 
+static void
+process_sched_wake_affine_event(void *data, struct event *event,
+				int cpu, u64 timestamp)
+{
+	struct trace_wake_affine_event wake_affine_event;
+
+	FILL_COMMON_FIELDS(wake_affine_event, event, data);
+
+	FILL_ARRAY(wake_affine_event, comm, event, data);
+	FILL_FIELD(wake_affine_event, pid, event, data);
+	FILL_FIELD(wake_affine_event, level, event, data);
+	FILL_FIELD(wake_affine_event, this_cpu, event, data);
+	FILL_FIELD(wake_affine_event, prev_cpu, event, data);
+	FILL_FIELD(wake_affine_event, this_load, event, data);
+	FILL_FIELD(wake_affine_event, prev_load, event, data);
+	FILL_FIELD(wake_affine_event, reason, event, data);
+
+	if (trace_handler->wake_affine_event)
+		trace_handler->wake_affine_event(&wake_affine_event,
+						 cpu, timestamp);
+}
+
+static void
+process_sched_select_task_rq_event(void *data, struct event *event,
+				   int cpu, u64 timestamp)
+{
+	struct trace_select_task_rq_event select_event;
+
+	FILL_COMMON_FIELDS(select_event, event, data);
+
+	FILL_ARRAY(select_event, comm, event, data);
+	FILL_FIELD(select_event, pid, event, data);
+	FILL_FIELD(select_event, sd_flag, event, data);
+	FILL_FIELD(select_event, level, event, data);
+	FILL_FIELD(select_event, prev_cpu, event, data);
+	FILL_FIELD(select_event, target_cpu, event, data);
+	FILL_FIELD(select_event, reason, event, data);
+
+	if (trace_handler->select_task_rq_event)
+		trace_handler->select_task_rq_event(&select_event,
+						    cpu, timestamp);
+}
+
+static void
+process_sched_load_balance_event(void *data, struct event *event,
+				 int cpu, u64 timestamp)
+{
+	struct trace_load_balance_event lb_event;
+
+	FILL_COMMON_FIELDS(lb_event, event, data);
+
+	FILL_FIELD(lb_event, cpu, event, data);
+	FILL_FIELD(lb_event, idle, event, data);
+	FILL_FIELD(lb_event, level, event, data);
+	FILL_FIELD(lb_event, busiest_cpu, event, data);
+	FILL_FIELD(lb_event, imbalance, event, data);
+	FILL_FIELD(lb_event, nr_moved, event, data);
+	FILL_FIELD(lb_event, reason, event, data);
+
+	if (trace_handler->load_balance_event)
+		trace_handler->load_balance_event(&lb_event, cpu, timestamp);
+}
+
 static void process_raw_event(union perf_event *raw_event __used,
 			      struct perf_session *session, void *data, int cpu,
 			      u64 timestamp, struct thread *thread)
@@ -1599,6 +1732,12 @@ static void process_raw_event(union perf_event *raw_event __used,
 		process_sched_exit_event(event, cpu, timestamp, thread);
 	if (!strcmp(event->name, "sched_migrate_task"))
 		process_sched_migrate_task_event(data, session, event, cpu, timestamp, thread);
+	if (!strcmp(event->name, "sched_wake_affine"))
+		process_sched_wake_affine_event(data, event, cpu, timestamp);
+	if (!strcmp(event->name, "sched_select_task_rq"))
+		process_sched_select_task_rq_event(data, event, cpu, timestamp);
+	if (!strcmp(event->name, "sched_load_balance"))
+		process_sched_load_balance_event(data, event, cpu, timestamp);
 }
 
 static int process_sample_event(union perf_event *event,
@@ -1743,6 +1882,360 @@ static void __cmd_map(void)
 	print_bad_events();
 }
 
+/*
+ * perf sched placement: how select_task_rq_fair(), wake_affine() and
+ * load_balance() decided, per sched domain level, and what the wakeups
+ * cost in wake-to-run latency.  The reason codes mirror the enums in
+ * the kernel's include/linux/sched.h.
+ */
+enum {
+	WAKE_AFFINE_SYNC,
+	WAKE_AFFINE_BALANCED,
+	WAKE_AFFINE_LIGHT,
+	WAKE_AFFINE_IMBALANCED,
+	NR_WAKE_AFFINE_REASONS
+};
+
+enum {
+	SELECT_NO_DOMAIN,
+	SELECT_AFFINE,
+	SELECT_PREV,
+	SELECT_IDLEST,
+	NR_SELECT_REASONS
+};
+
+enum {
+	LB_NOT_BALANCER,
+	LB_NO_BUSIEST_GROUP,
+	LB_NO_BUSIEST_QUEUE,
+	LB_MOVED,
+	LB_FAILED,
+	LB_ACTIVE,
+	LB_PINNED,
+	NR_LB_REASONS
+};
+
+#define NR_IDLE_TYPES		3
+#define MAX_DOMAIN_LEVELS	8
+#define NR_LAT_BUCKETS		24
+
+static const char * const idle_type_str[NR_IDLE_TYPES] = {
+	"idle", "busy", "newidle"
+};
+
+struct domain_stats {
+	u64	wake_affine[NR_WAKE_AFFINE_REASONS];
+	u64	select[NR_SELECT_REASONS];
+	u64	select_sibling;
+	u64	select_migrated;
+	u64	lb[NR_IDLE_TYPES][NR_LB_REASONS];
+	u64	lb_tasks[NR_IDLE_TYPES];
+};
+
+/* Index 0 is "no domain", domain level n lives at n + 1 */
+static struct domain_stats	domain_stats[MAX_DOMAIN_LEVELS + 1];
+
+struct lat_hist {
+	u64	nr;
+	u64	total;
+	u64	max;
+	u64	bucket[NR_LAT_BUCKETS];
+};
+
+/* One histogram per select reason, all wakeups at NR_SELECT_REASONS */
+static struct lat_hist		wake_lat[NR_SELECT_REASONS + 1];
+
+static u64			wake_stamp[MAX_PID];
+/* select reason + 1 of the pending wakeup, 0 if it was not traced */
+static u8			wake_reason[MAX_PID];
+
+static struct domain_stats *domain_stats_of(int level)
+{
+	if (level < -1 || level >= MAX_DOMAIN_LEVELS)
+		return NULL;
+	return &domain_stats[level + 1];
+}
+
+static void
+placement_wake_affine_event(struct trace_wake_affine_event *wa_event,
+			    int cpu __used, u64 timestamp __used)
+{
+	struct domain_stats *ds = domain_stats_of(wa_event->level);
+
+	if (ds && wa_event->reason < NR_WAKE_AFFINE_REASONS)
+		ds->wake_affine[wa_event->reason]++;
+}
+
+static void
+placement_select_task_rq_event(struct trace_select_task_rq_event *select_event,
+			       int cpu, u64 timestamp __used)
+{
+	struct domain_stats *ds = domain_stats_of(select_event->level);
+	u32 reason = select_event->reason;
+
+	if (!ds || reason >= NR_SELECT_REASONS)
+		return;
+
+	ds->select[reason]++;
+	if (select_event->target_cpu != select_event->prev_cpu)
+		ds->select_migrated++;
+
+	/*
+	 * select_idle_sibling() moved the task off the cpu that
+	 * wake_affine() settled on; the event fires on the waker's cpu.
+	 */
+	if ((reason == SELECT_AFFINE &&
+	     select_event->target_cpu != (u32)cpu) ||
+	    (reason == SELECT_PREV &&
+	     select_event->target_cpu != select_event->prev_cpu))
+		ds->select_sibling++;
+
+	if (select_event->pid < MAX_PID)
+		wake_reason[select_event->pid] = reason + 1;
+}
+
+static void
+placement_load_balance_event(struct trace_load_balance_event *lb_event,
+			     int cpu __used, u64 timestamp __used)
+{
+	struct domain_stats *ds = domain_stats_of(lb_event->level);
+
+	if (!ds || lb_event->idle >= NR_IDLE_TYPES ||
+	    lb_event->reason >= NR_LB_REASONS)
+		return;
+
+	ds->lb[lb_event->idle][lb_event->reason]++;
+	ds->lb_tasks[lb_event->idle] += lb_event->nr_moved;
+}
+
+static void
+placement_wakeup_event(struct trace_wakeup_event *wakeup_event,
+		       struct perf_session *session __used,
+		       struct event *event __used,
+		       int cpu __used,
+		       u64 timestamp,
+		       struct thread *thread __used)
+{
+	if (!wakeup_event->success || wakeup_event->pid >= MAX_PID)
+		return;
+
+	if (!wake_stamp[wakeup_event->pid])
+		wake_stamp[wakeup_event->pid] = timestamp;
+}
+
+static void lat_hist_add(struct lat_hist *hist, u64 delta)
+{
+	u64 usecs = delta / 1000;
+	int bucket = 0;
+
+	/* bucket n counts [2^(n-1), 2^n) usecs, the last one is open */
+	while (usecs && bucket < NR_LAT_BUCKETS - 1) {
+		usecs >>= 1;
+		bucket++;
+	}
+
+	hist->bucket[bucket]++;
+	hist->nr++;
+	hist->total += delta;
+	if (delta > hist->max)
+		hist->max = delta;
+}
+
+static void
+placement_switch_event(struct trace_switch_event *switch_event,
+		       struct perf_session *session __used,
+		       struct event *event __used,
+		       int cpu __used,
+		       u64 timestamp,
+		       struct thread *thread __used)
+{
+	u32 pid = switch_event->next_pid;
+	u64 stamp;
+
+	if (pid >= MAX_PID || !wake_stamp[pid])
+		return;
+
+	stamp = wake_stamp[pid];
+	wake_stamp[pid] = 0;
+	if (timestamp < stamp) {
+		nr_unordered_timestamps++;
+		return;
+	}
+
+	lat_hist_add(&wake_lat[NR_SELECT_REASONS], timestamp - stamp);
+	if (wake_reason[pid])
+		lat_hist_add(&wake_lat[wake_reason[pid] - 1],
+			     timestamp - stamp);
+	wake_reason[pid] = 0;
+}
+
+static struct trace_sched_handler placement_ops  = {
+	.wakeup_event		= placement_wakeup_event,
+	.switch_event		= placement_switch_event,
+	.wake_affine_event	= placement_wake_affine_event,
+	.select_task_rq_event	= placement_select_task_rq_event,
+	.load_balance_event	= placement_load_balance_event,
+};
+
+static void print_domain(int level)
+{
+	if (level < 0)
+		printf("    none ");
+	else
+		printf("  %6d ", level);
+}
+
+static void output_select_stats(void)
+{
+	int level, i;
+
+	printf("\n -----------------------------------------------------------------------------------------------\n");
+	printf("  Domain | Placements |  No domain |     Affine |       Prev |     Idlest |   Sibling |  Migrated\n");
+	printf(" -----------------------------------------------------------------------------------------------\n");
+
+	for (level = -1; level < MAX_DOMAIN_LEVELS; level++) {
+		struct domain_stats *ds = domain_stats_of(level);
+		u64 total = 0;
+
+		for (i = 0; i < NR_SELECT_REASONS; i++)
+			total += ds->select[i];
+		if (!total)
+			continue;
+
+		print_domain(level);
+		printf("| %10" PRIu64 " ", total);
+		for (i = 0; i < NR_SELECT_REASONS; i++)
+			printf("| %10" PRIu64 " ", ds->select[i]);
+		printf("| %9" PRIu64 " | %9" PRIu64 "\n",
+		       ds->select_sibling, ds->select_migrated);
+	}
+}
+
+static void output_wake_affine_stats(void)
+{
+	int level, i;
+
+	printf("\n ------------------------------------------------------------------------------\n");
+	printf("  Domain |  Attempts |      Sync |  Balanced |     Light | Imbalanced | Hit rate\n");
+	printf(" ------------------------------------------------------------------------------\n");
+
+	for (level = 0; level < MAX_DOMAIN_LEVELS; level++) {
+		struct domain_stats *ds = domain_stats_of(level);
+		u64 total = 0;
+
+		for (i = 0; i < NR_WAKE_AFFINE_REASONS; i++)
+			total += ds->wake_affine[i];
+		if (!total)
+			continue;
+
+		print_domain(level);
+		printf("| %9" PRIu64 " ", total);
+		for (i = 0; i < NR_WAKE_AFFINE_REASONS - 1; i++)
+			printf("| %9" PRIu64 " ", ds->wake_affine[i]);
+		printf("| %10" PRIu64 " | %7.2f%%\n",
+		       ds->wake_affine[WAKE_AFFINE_IMBALANCED],
+		       100.0 * (total - ds->wake_affine[WAKE_AFFINE_IMBALANCED]) /
+		       total);
+	}
+}
+
+static void output_load_balance_stats(void)
+{
+	int level, idle, i;
+
+	printf("\n -----------------------------------------------------------------------------------------------\n");
+	printf("  Domain | Type    |     Runs |  Balanced |     Moved |    Failed |    Active |    Pinned |   Tasks\n");
+	printf(" -----------------------------------------------------------------------------------------------\n");
+
+	for (level = 0; level < MAX_DOMAIN_LEVELS; level++) {
+		struct domain_stats *ds = domain_stats_of(level);
+
+		for (idle = 0; idle < NR_IDLE_TYPES; idle++) {
+			u64 *lb = ds->lb[idle];
+			u64 total = 0;
+
+			for (i = 0; i < NR_LB_REASONS; i++)
+				total += lb[i];
+			if (!total)
+				continue;
+
+			print_domain(level);
+			printf("| %-7s | %8" PRIu64 " | %9" PRIu64 " ",
+			       idle_type_str[idle], total,
+			       lb[LB_NOT_BALANCER] + lb[LB_NO_BUSIEST_GROUP] +
+			       lb[LB_NO_BUSIEST_QUEUE]);
+			printf("| %9" PRIu64 " | %9" PRIu64 " | %9" PRIu64
+			       " | %9" PRIu64 " | %7" PRIu64 "\n",
+			       lb[LB_MOVED], lb[LB_FAILED], lb[LB_ACTIVE],
+			       lb[LB_PINNED], ds->lb_tasks[idle]);
+		}
+	}
+}
+
+static void output_wake_latency(void)
+{
+	static const int order[] = {
+		NR_SELECT_REASONS, SELECT_NO_DOMAIN, SELECT_AFFINE,
+		SELECT_PREV, SELECT_IDLEST
+	};
+	int last = 0, bucket;
+	unsigned int i;
+
+	for (bucket = 0; bucket < NR_LAT_BUCKETS; bucket++)
+		if (wake_lat[NR_SELECT_REASONS].bucket[bucket])
+			last = bucket;
+
+	printf("\n -----------------------------------------------------------------------------------------\n");
+	printf("  Wake-to-run latency |        All |  No domain |     Affine |       Prev |     Idlest\n");
+	printf(" -----------------------------------------------------------------------------------------\n");
+
+	for (bucket = 0; bucket <= last; bucket++) {
+		if (!bucket)
+			printf("  %7d - %6d us ", 0, 1);
+		else if (bucket == NR_LAT_BUCKETS - 1)
+			printf("  %7d +        us ", 1 << (bucket - 1));
+		else
+			printf("  %7d - %6d us ", 1 << (bucket - 1),
+			       1 << bucket);
+		for (i = 0; i < ARRAY_SIZE(order); i++)
+			printf("%s| %10" PRIu64, i ? " " : "",
+			       wake_lat[order[i]].bucket[bucket]);
+		printf("\n");
+	}
+
+	printf(" -----------------------------------------------------------------------------------------\n");
+	printf("  %-19s ", "avg ms");
+	for (i = 0; i < ARRAY_SIZE(order); i++) {
+		struct lat_hist *hist = &wake_lat[order[i]];
+
+		printf("%s| %10.3f", i ? " " : "", hist->nr ?
+		       (double)hist->total / hist->nr / 1e6 : 0.0);
+	}
+	printf("\n  %-19s ", "max ms");
+	for (i = 0; i < ARRAY_SIZE(order); i++)
+		printf("%s| %10.3f", i ? " " : "",
+		       (double)wake_lat[order[i]].max / 1e6);
+	printf("\n  %-19s ", "wakeups");
+	for (i = 0; i < ARRAY_SIZE(order); i++)
+		printf("%s| %10" PRIu64, i ? " " : "", wake_lat[order[i]].nr);
+	printf("\n");
+}
+
+static void __cmd_placement(void)
+{
+	setup_pager();
+	read_events(true, NULL);
+
+	output_select_stats();
+	output_wake_affine_stats();
+	output_load_balance_stats();
+	output_wake_latency();
+
+	printf("\n");
+	print_bad_events();
+	printf("\n");
+}
+
 static void __cmd_replay(void)
 {
 	unsigned long i;
@@ -1777,7 +2270,7 @@ static void __cmd_replay(void)
 
 
 static const char * const sched_usage[] = {
-	"perf sched [<options>] {record|latency|map|replay|script}",
+	"perf sched [<options>] {record|latency|map|replay|script|placement}",
 	NULL
 };
 
@@ -1823,6 +2316,21 @@ static const struct option replay_options[] = {
 	OPT_END()
 };
 
+static const char * const placement_usage[] = {
+	"perf sched placement [<options>]",
+	NULL
+};
+
+static const struct option placement_options[] = {
+	OPT_INCR('v', "verbose", &verbose,
+		    "be more verbose (show symbol address, etc)"),
+	OPT_INTEGER('C', "CPU", &profile_cpu,
+		    "CPU to profile on"),
+	OPT_BOOLEAN('D', "dump-raw-trace", &dump_trace,
+		    "dump raw trace in ASCII"),
+	OPT_END()
+};
+
 static void setup_sorting(void)
 {
 	char *tmp, *tok, *str = strdup(sort_order);
@@ -1858,12 +2366,20 @@ static const char *record_args[] = {
 	"-e", "sched:sched_migrate_task",
 };
 
+/* for 'perf sched placement', recorded only if the kernel has them */
+static const char *placement_events[] = {
+	"sched:sched_wake_affine",
+	"sched:sched_select_task_rq",
+	"sched:sched_load_balance",
+};
+
 static int __cmd_record(int argc, const char **argv)
 {
 	unsigned int rec_argc, i, j;
 	const char **rec_argv;
 
-	rec_argc = ARRAY_SIZE(record_args) + argc - 1;
+	rec_argc = ARRAY_SIZE(record_args) + 2 * ARRAY_SIZE(placement_events) +
+		   argc - 1;
 	rec_argv = calloc(rec_argc + 1, sizeof(char *));
 
 	if (rec_argv == NULL)
@@ -1872,10 +2388,20 @@ static int __cmd_record(int argc, const char **argv)
 	for (i = 0; i < ARRAY_SIZE(record_args); i++)
 		rec_argv[i] = strdup(record_args[i]);
 
+	for (j = 0; j < ARRAY_SIZE(placement_events); j++) {
+		if (!is_valid_tracepoint(placement_events[j])) {
+			pr_debug("%s not available, not recorded\n",
+				 placement_events[j]);
+			continue;
+		}
+		rec_argv[i++] = strdup("-e");
+		rec_argv[i++] = strdup(placement_events[j]);
+	}
+
 	for (j = 1; j < (unsigned int)argc; j++, i++)
 		rec_argv[i] = argv[j];
 
-	BUG_ON(i != rec_argc);
+	BUG_ON(i > rec_argc);
 
 	return cmd_record(i, rec_argv, NULL);
 }
@@ -1917,6 +2443,14 @@ int cmd_sched(int argc, const char **argv, const char *prefix __used)
 				usage_with_options(replay_usage, replay_options);
 		}
 		__cmd_replay();
+	} else if (!strncmp(argv[0], "pla", 3)) {
+		trace_handler = &placement_ops;
+		if (argc > 1) {
+			argc = parse_options(argc, argv, placement_options, placement_usage, 0);
+			if (argc)
+				usage_with_options(placement_usage, placement_options);
+		}
+		__cmd_placement();
 	} else {
 		usage_with_options(sched_usage, sched_options);
 	}
@@ -0,0 +1,59 @@
+#!/bin/sh
+#
+# Buffered write and read throughput through the passthrough example,
+# once per FUSE configuration: write-through with the default request
+# size, a 1MB max request, and the writeback cache with each of those.
+# Small (4k) application writes show the difference best, since in
+# write-through mode each one is a separate FUSE_WRITE round trip.
+# The -s runs move the data with splice; compare the connection's
+# page_stats in the fusectl filesystem before and after.
+#
+# usage: bench.sh <passthrough binary> <scratch dir> [size in MB]
+#
+
+PT=$1
+DIR=$2
+MB=${3:-256}
+[ -x "$PT" ] && [ -d "$DIR" ] ||
+	{ echo "usage: $0 <passthrough> <scratch dir> [MB]" >&2; exit 1; }
+
+SRC=$DIR/src
+MNT=$DIR/mnt
+mkdir -p "$SRC" "$MNT" || exit 1
+
+rate() {
+	awk -v mb="$MB" -v s="$1" -v e="$2" \
+		'BEGIN { printf "%9.2f MB/s", mb / (e - s) }'
+}
+
+run() {
+	"$PT" "$@" "$SRC" "$MNT" 2> /dev/null &
+	pid=$!
+	sleep 1
+	mountpoint -q "$MNT" || { echo "mount failed" >&2; exit 1; }
+
+	start=$(date +%s.%N)
+	dd if=/dev/zero of="$MNT/f" bs=4k count=$((MB * 256)) conv=fsync \
+		2> /dev/null || exit 1
+	end=$(date +%s.%N)
+	w=$(rate "$start" "$end")
+
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+	start=$(date +%s.%N)
+	dd if="$MNT/f" of=/dev/null bs=1M 2> /dev/null || exit 1
+	end=$(date +%s.%N)
+	r=$(rate "$start" "$end")
+
+	rm -f "$MNT/f"
+	umount "$MNT"
+	wait $pid
+	printf "%-12s write %s  read %s\n" "${*:-default}" "$w" "$r"
+}
+
+run
+run -p 256
+run -w
+run -w -p 256
+run -s
+run -w -s -p 256
@@ -0,0 +1,85 @@
+/*
+ * Dirty a pattern of pages in a file through one file descriptor and
+ * fsync it, or check that a file holds what such a run left behind.
+ * Used by writeback-holes.sh to see how the writeback cache batches
+ * dirty pages into FUSE_WRITE requests.
+ *
+ * The pattern has one character per page: 'x' writes the page, '.'
+ * leaves it alone.  Page n is filled with the byte 'a' + n % 26, pages
+ * that are left alone must read back as zeros.
+ *
+ * Build:
+ *	gcc -O2 -Wall -o holes holes.c
+ *
+ * usage: holes [-c] <file> <pattern>
+ *	-c	check the file instead of writing it
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define PAGE_SZ		4096
+
+static char page[PAGE_SZ];
+static char got[PAGE_SZ];
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *pattern;
+	int check = 0, fd;
+	size_t n, len;
+
+	if (argc > 1 && !strcmp(argv[1], "-c")) {
+		check = 1;
+		argc--;
+		argv++;
+	}
+	if (argc != 3) {
+		fprintf(stderr, "usage: holes [-c] <file> <pattern>\n");
+		return 1;
+	}
+	pattern = argv[2];
+	len = strlen(pattern);
+
+	fd = open(argv[1], check ? O_RDONLY : O_RDWR | O_CREAT | O_TRUNC,
+		  0644);
+	if (fd < 0)
+		die(argv[1]);
+
+	/* size the file first, so that no page has to be read in */
+	if (!check && ftruncate(fd, len * PAGE_SZ))
+		die("ftruncate");
+
+	for (n = 0; n < len; n++) {
+		off_t off = (off_t) n * PAGE_SZ;
+
+		memset(page, pattern[n] == 'x' ? 'a' + n % 26 : 0, PAGE_SZ);
+		if (!check) {
+			if (pattern[n] == 'x' &&
+			    pwrite(fd, page, PAGE_SZ, off) != PAGE_SZ)
+				die("pwrite");
+			continue;
+		}
+		if (pread(fd, got, PAGE_SZ, off) != PAGE_SZ)
+			die("pread");
+		if (memcmp(got, page, PAGE_SZ)) {
+			fprintf(stderr, "page %zu has the wrong data\n", n);
+			return 1;
+		}
+	}
+
+	if (!check && fsync(fd))
+		die("fsync");
+	close(fd);
+	return 0;
+}
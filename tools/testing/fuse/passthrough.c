@@ -0,0 +1,700 @@
+/*
+ * Minimal FUSE passthrough filesystem, speaking the kernel protocol
+ * on /dev/fuse directly so that it needs nothing but the kernel
+ * headers.  It mirrors a source directory under a mount point, which
+ * is enough to run file I/O benchmarks through FUSE and compare the
+ * write-through and writeback cache modes and request sizes.
+ *
+ * Single threaded, no rename/link/xattr/locking support, node IDs are
+ * kept in a flat table that is searched linearly.  Not meant to be
+ * anything but a load generator.
+ *
+ * Build after "make headers_install" in the kernel tree:
+ *	gcc -O2 -Wall -I ../../../usr/include -o passthrough passthrough.c
+ *
+ * usage: passthrough [-w] [-s] [-p max_pages] [-l log]
+ *		      <source dir> <mount point>
+ *	-w	ask for the writeback cache (FUSE_WRITEBACK_CACHE)
+ *	-s	move file data with splice instead of read/write
+ *	-p	pages per request to negotiate (FUSE_MAX_PAGES), default 32
+ *	-l	append "<offset> <size>" to log for every FUSE_WRITE
+ *
+ * With -s, WRITE data goes from /dev/fuse through a pipe into the
+ * backing file, and READ replies are built from page cache pages of
+ * the backing file spliced into a pipe behind a vmspliced header, then
+ * spliced into /dev/fuse with SPLICE_F_MOVE so the kernel can steal
+ * them.  The fusectl page_stats file shows how many pages were moved.
+ *
+ * Runs in the foreground until the file system is unmounted.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <linux/fuse.h>
+
+#define PAGE_SZ		4096
+#define MAX_PAGES	256
+#define BUF_SIZE	(MAX_PAGES * PAGE_SZ + PAGE_SZ)
+
+struct node {
+	char *path;		/* NULL if the slot is free */
+	uint64_t nlookup;
+};
+
+static struct node *nodes;
+static uint64_t nr_nodes;
+static int fuse_fd;
+static int want_wb;
+static int use_splice;
+static int req_pipe[2];		/* /dev/fuse -> us, us -> /dev/fuse */
+static int data_pipe[2];	/* backing file -> req_pipe */
+static unsigned int want_pages = 32;
+static FILE *write_log;
+static char buf[BUF_SIZE];
+static char out[BUF_SIZE];
+
+static void reply(uint64_t unique, int error, const void *arg, size_t len)
+{
+	struct fuse_out_header oh;
+	struct iovec iov[2];
+
+	oh.len = sizeof(oh) + (error ? 0 : len);
+	oh.error = error;
+	oh.unique = unique;
+	iov[0].iov_base = &oh;
+	iov[0].iov_len = sizeof(oh);
+	iov[1].iov_base = (void *) arg;
+	iov[1].iov_len = error ? 0 : len;
+
+	if (writev(fuse_fd, iov, 2) < 0 && errno != ENOENT)
+		perror("writev");
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void read_full(int fd, void *p, size_t len)
+{
+	while (len) {
+		ssize_t res = read(fd, p, len);
+
+		if (res <= 0)
+			die("pipe read");
+		p += res;
+		len -= res;
+	}
+}
+
+static void splice_full(int in, loff_t *inoff, int out, loff_t *outoff,
+			size_t len)
+{
+	while (len) {
+		ssize_t res = splice(in, inoff, out, outoff, len, SPLICE_F_MOVE);
+
+		if (res <= 0)
+			die("splice");
+		len -= res;
+	}
+}
+
+/*
+ * Reply to a READ without copying the data through user space.  The
+ * header is vmspliced on its own so that each page of file data starts
+ * a new pipe buffer, which is what lets the kernel steal it.
+ */
+static void splice_read_reply(uint64_t unique, struct fuse_read_in *in)
+{
+	struct fuse_out_header oh;
+	struct iovec iov = { &oh, sizeof(oh) };
+	loff_t off = in->offset;
+	size_t len = 0;
+
+	while (len < in->size) {
+		ssize_t res = splice(in->fh, &off, data_pipe[1], NULL,
+				     in->size - len, SPLICE_F_MOVE);
+		if (res < 0 && !len) {
+			reply(unique, -errno, NULL, 0);
+			return;
+		}
+		if (res <= 0)
+			break;
+		len += res;
+	}
+
+	oh.len = sizeof(oh) + len;
+	oh.error = 0;
+	oh.unique = unique;
+	if (vmsplice(req_pipe[1], &iov, 1, 0) != sizeof(oh))
+		die("vmsplice");
+	splice_full(data_pipe[0], NULL, req_pipe[1], NULL, len);
+	splice_full(req_pipe[0], NULL, fuse_fd, NULL, oh.len);
+}
+
+static uint64_t node_get(const char *path)
+{
+	uint64_t i, free_slot = 0;
+
+	for (i = 1; i < nr_nodes; i++) {
+		if (!nodes[i].path) {
+			if (!free_slot)
+				free_slot = i;
+		} else if (!strcmp(nodes[i].path, path)) {
+			nodes[i].nlookup++;
+			return i;
+		}
+	}
+	if (!free_slot) {
+		free_slot = nr_nodes++;
+		nodes = realloc(nodes, nr_nodes * sizeof(*nodes));
+		if (!nodes) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	nodes[free_slot].path = strdup(path);
+	nodes[free_slot].nlookup = 1;
+	return free_slot;
+}
+
+static void node_forget(uint64_t nodeid, uint64_t nlookup)
+{
+	if (nodeid <= FUSE_ROOT_ID || nodeid >= nr_nodes || !nodes[nodeid].path)
+		return;
+	if (nodes[nodeid].nlookup > nlookup) {
+		nodes[nodeid].nlookup -= nlookup;
+		return;
+	}
+	free(nodes[nodeid].path);
+	nodes[nodeid].path = NULL;
+}
+
+static const char *node_path(uint64_t nodeid)
+{
+	if (nodeid >= nr_nodes)
+		return NULL;
+	return nodes[nodeid].path;
+}
+
+static void fill_attr(struct fuse_attr *attr, const struct stat *st)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->ino = st->st_ino;
+	attr->size = st->st_size;
+	attr->blocks = st->st_blocks;
+	attr->atime = st->st_atim.tv_sec;
+	attr->atimensec = st->st_atim.tv_nsec;
+	attr->mtime = st->st_mtim.tv_sec;
+	attr->mtimensec = st->st_mtim.tv_nsec;
+	attr->ctime = st->st_ctim.tv_sec;
+	attr->ctimensec = st->st_ctim.tv_nsec;
+	attr->mode = st->st_mode;
+	attr->nlink = st->st_nlink;
+	attr->uid = st->st_uid;
+	attr->gid = st->st_gid;
+	attr->rdev = st->st_rdev;
+	attr->blksize = st->st_blksize;
+}
+
+static int child_path(char *dst, uint64_t parent, const char *name)
+{
+	const char *dir = node_path(parent);
+
+	if (!dir)
+		return -ENOENT;
+	if (snprintf(dst, PATH_MAX, "%s/%s", dir, name) >= PATH_MAX)
+		return -ENAMETOOLONG;
+	return 0;
+}
+
+static int entry_reply(struct fuse_entry_out *eo, const char *path)
+{
+	struct stat st;
+
+	if (lstat(path, &st))
+		return -errno;
+
+	memset(eo, 0, sizeof(*eo));
+	eo->nodeid = node_get(path);
+	eo->entry_valid = 1;
+	eo->attr_valid = 1;
+	fill_attr(&eo->attr, &st);
+	return 0;
+}
+
+/*
+ * With the writeback cache the kernel reads in partially written pages
+ * through whatever file it has, and it sends explicit offsets for
+ * appending writes, so write-only and O_APPEND opens must not be
+ * passed through as they are.
+ */
+static int open_flags(int flags)
+{
+	if (!want_wb)
+		return flags;
+	if ((flags & O_ACCMODE) == O_WRONLY)
+		flags = (flags & ~O_ACCMODE) | O_RDWR;
+	return flags & ~O_APPEND;
+}
+
+static void do_init(struct fuse_in_header *ih, struct fuse_init_in *in)
+{
+	struct fuse_init_out io;
+	size_t len = sizeof(io);
+
+	memset(&io, 0, sizeof(io));
+	io.major = FUSE_KERNEL_VERSION;
+	io.minor = FUSE_KERNEL_MINOR_VERSION;
+	if (in->minor < io.minor)
+		io.minor = in->minor;
+	io.max_readahead = in->max_readahead;
+	io.flags = in->flags & (FUSE_ASYNC_READ | FUSE_BIG_WRITES);
+	io.max_write = 32 * PAGE_SZ;
+
+	if (want_wb && (in->flags & FUSE_WRITEBACK_CACHE))
+		io.flags |= FUSE_WRITEBACK_CACHE;
+	if (in->flags & FUSE_MAX_PAGES) {
+		io.flags |= FUSE_MAX_PAGES;
+		io.max_pages = want_pages;
+		io.max_write = want_pages * PAGE_SZ;
+	}
+	/* kernels that don't offer FUSE_MAX_PAGES reject the long reply */
+	if (!(in->flags & FUSE_MAX_PAGES))
+		len = offsetof(struct fuse_init_out, time_gran);
+
+	fprintf(stderr, "passthrough: protocol 7.%u, max_write %u%s\n",
+		io.minor, io.max_write,
+		io.flags & FUSE_WRITEBACK_CACHE ? ", writeback cache" : "");
+	reply(ih->unique, 0, &io, len);
+}
+
+static int do_setattr(const char *path, struct fuse_setattr_in *in)
+{
+	if (in->valid & FATTR_MODE && chmod(path, in->mode))
+		return -errno;
+	if (in->valid & (FATTR_UID | FATTR_GID)) {
+		uid_t uid = in->valid & FATTR_UID ? in->uid : (uid_t) -1;
+		gid_t gid = in->valid & FATTR_GID ? in->gid : (gid_t) -1;
+
+		if (lchown(path, uid, gid))
+			return -errno;
+	}
+	if (in->valid & FATTR_SIZE) {
+		int err = in->valid & FATTR_FH ?
+			ftruncate(in->fh, in->size) : truncate(path, in->size);
+		if (err)
+			return -errno;
+	}
+	if (in->valid & (FATTR_ATIME | FATTR_MTIME)) {
+		struct timespec ts[2];
+
+		ts[0].tv_sec = in->atime;
+		ts[0].tv_nsec = in->atimensec;
+		if (!(in->valid & FATTR_ATIME))
+			ts[0].tv_nsec = UTIME_OMIT;
+		else if (in->valid & FATTR_ATIME_NOW)
+			ts[0].tv_nsec = UTIME_NOW;
+		ts[1].tv_sec = in->mtime;
+		ts[1].tv_nsec = in->mtimensec;
+		if (!(in->valid & FATTR_MTIME))
+			ts[1].tv_nsec = UTIME_OMIT;
+		else if (in->valid & FATTR_MTIME_NOW)
+			ts[1].tv_nsec = UTIME_NOW;
+		if (utimensat(AT_FDCWD, path, ts, AT_SYMLINK_NOFOLLOW))
+			return -errno;
+	}
+	return 0;
+}
+
+static int do_readdir(DIR *dp, struct fuse_read_in *in, size_t *len)
+{
+	struct dirent *de;
+	size_t pos = 0;
+
+	seekdir(dp, in->offset);
+	while ((de = readdir(dp))) {
+		struct fuse_dirent *fd = (struct fuse_dirent *) (out + pos);
+		size_t namelen = strlen(de->d_name);
+		size_t entlen = FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET + namelen);
+
+		if (pos + entlen > in->size) {
+			/* does not fit, hand it out next time */
+			break;
+		}
+		fd->ino = de->d_ino;
+		fd->off = telldir(dp);
+		fd->namelen = namelen;
+		fd->type = de->d_type;
+		memcpy(fd->name, de->d_name, namelen);
+		memset(fd->name + namelen, 0, entlen - FUSE_NAME_OFFSET - namelen);
+		pos += entlen;
+	}
+	*len = pos;
+	return 0;
+}
+
+static void handle(struct fuse_in_header *ih, void *arg)
+{
+	char path[PATH_MAX];
+	const char *p = node_path(ih->nodeid);
+	struct stat st;
+	ssize_t res;
+	int err = 0;
+
+	if (ih->opcode != FUSE_INIT && ih->opcode != FUSE_DESTROY &&
+	    ih->opcode != FUSE_FORGET && ih->opcode != FUSE_BATCH_FORGET &&
+	    !p) {
+		reply(ih->unique, -ESTALE, NULL, 0);
+		return;
+	}
+
+	switch (ih->opcode) {
+	case FUSE_INIT:
+		do_init(ih, arg);
+		return;
+
+	case FUSE_DESTROY:
+		reply(ih->unique, 0, NULL, 0);
+		exit(0);
+
+	case FUSE_FORGET:
+		node_forget(ih->nodeid, ((struct fuse_forget_in *) arg)->nlookup);
+		return;
+
+	case FUSE_BATCH_FORGET: {
+		struct fuse_batch_forget_in *in = arg;
+		struct fuse_forget_one *one = (void *) (in + 1);
+		uint32_t i;
+
+		for (i = 0; i < in->count; i++)
+			node_forget(one[i].nodeid, one[i].nlookup);
+		return;
+	}
+
+	case FUSE_LOOKUP: {
+		struct fuse_entry_out eo;
+
+		err = child_path(path, ih->nodeid, arg);
+		if (!err)
+			err = entry_reply(&eo, path);
+		reply(ih->unique, err, &eo, sizeof(eo));
+		return;
+	}
+
+	case FUSE_GETATTR:
+	case FUSE_SETATTR: {
+		struct fuse_attr_out ao;
+
+		if (ih->opcode == FUSE_SETATTR)
+			err = do_setattr(p, arg);
+		if (!err && lstat(p, &st))
+			err = -errno;
+		memset(&ao, 0, sizeof(ao));
+		ao.attr_valid = 1;
+		fill_attr(&ao.attr, &st);
+		reply(ih->unique, err, &ao, sizeof(ao));
+		return;
+	}
+
+	case FUSE_OPEN:
+	case FUSE_OPENDIR: {
+		struct fuse_open_in *in = arg;
+		struct fuse_open_out oo;
+
+		memset(&oo, 0, sizeof(oo));
+		if (ih->opcode == FUSE_OPEN) {
+			int fd = open(p, open_flags(in->flags) &
+				      ~(O_CREAT | O_EXCL | O_NOCTTY));
+
+			if (fd < 0)
+				err = -errno;
+			oo.fh = fd;
+		} else {
+			DIR *dp = opendir(p);
+
+			if (!dp)
+				err = -errno;
+			oo.fh = (uintptr_t) dp;
+		}
+		reply(ih->unique, err, &oo, sizeof(oo));
+		return;
+	}
+
+	case FUSE_CREATE: {
+		struct fuse_create_in *in = arg;
+		struct {
+			struct fuse_entry_out eo;
+			struct fuse_open_out oo;
+		} co;
+		int fd = -1;
+
+		memset(&co, 0, sizeof(co));
+		err = child_path(path, ih->nodeid, (char *) (in + 1));
+		if (!err) {
+			fd = open(path, open_flags(in->flags) | O_CREAT,
+				  in->mode & ~in->umask);
+			if (fd < 0)
+				err = -errno;
+		}
+		if (!err)
+			err = entry_reply(&co.eo, path);
+		if (err && fd >= 0)
+			close(fd);
+		co.oo.fh = fd;
+		reply(ih->unique, err, &co, sizeof(co));
+		return;
+	}
+
+	case FUSE_READ: {
+		struct fuse_read_in *in = arg;
+
+		if (use_splice) {
+			splice_read_reply(ih->unique, in);
+			return;
+		}
+		res = pread(in->fh, out, in->size, in->offset);
+		reply(ih->unique, res < 0 ? -errno : 0, out, res);
+		return;
+	}
+
+	case FUSE_WRITE: {
+		struct fuse_write_in *in = arg;
+		struct fuse_write_out wo;
+
+		memset(&wo, 0, sizeof(wo));
+		if (write_log) {
+			fprintf(write_log, "%llu %u\n",
+				(unsigned long long) in->offset, in->size);
+			fflush(write_log);
+		}
+		if (use_splice) {
+			/* the data is still in the pipe, behind the header */
+			loff_t off = in->offset;
+			size_t left = in->size;
+
+			res = 0;
+			while (left) {
+				res = splice(req_pipe[0], NULL, in->fh, &off,
+					     left, SPLICE_F_MOVE);
+				if (res <= 0)
+					break;
+				left -= res;
+			}
+			if (left) {
+				err = res < 0 ? -errno : -EIO;
+				read_full(req_pipe[0], out, left);
+			}
+			res = in->size - left;
+		} else {
+			res = pwrite(in->fh, in + 1, in->size, in->offset);
+			if (res < 0)
+				err = -errno;
+		}
+		wo.size = res;
+		reply(ih->unique, err, &wo, sizeof(wo));
+		return;
+	}
+
+	case FUSE_READDIR: {
+		struct fuse_read_in *in = arg;
+		size_t len;
+
+		err = do_readdir((DIR *) (uintptr_t) in->fh, in, &len);
+		reply(ih->unique, err, out, len);
+		return;
+	}
+
+	case FUSE_RELEASE:
+		close(((struct fuse_release_in *) arg)->fh);
+		break;
+
+	case FUSE_RELEASEDIR:
+		closedir((DIR *) (uintptr_t) ((struct fuse_release_in *) arg)->fh);
+		break;
+
+	case FUSE_FLUSH:
+		break;
+
+	case FUSE_FSYNC: {
+		struct fuse_fsync_in *in = arg;
+
+		/* bit 0 of fsync_flags asks for fdatasync */
+		if ((in->fsync_flags & 1 ? fdatasync(in->fh) : fsync(in->fh)))
+			err = -errno;
+		break;
+	}
+
+	case FUSE_MKDIR: {
+		struct fuse_mkdir_in *in = arg;
+		struct fuse_entry_out eo;
+
+		err = child_path(path, ih->nodeid, (char *) (in + 1));
+		if (!err && mkdir(path, in->mode & ~in->umask))
+			err = -errno;
+		if (!err)
+			err = entry_reply(&eo, path);
+		reply(ih->unique, err, &eo, sizeof(eo));
+		return;
+	}
+
+	case FUSE_UNLINK:
+	case FUSE_RMDIR:
+		err = child_path(path, ih->nodeid, arg);
+		if (!err && (ih->opcode == FUSE_UNLINK ? unlink(path) : rmdir(path)))
+			err = -errno;
+		break;
+
+	case FUSE_STATFS: {
+		struct fuse_statfs_out so;
+		struct statvfs sv;
+
+		memset(&so, 0, sizeof(so));
+		if (statvfs(p, &sv))
+			err = -errno;
+		so.st.blocks = sv.f_blocks;
+		so.st.bfree = sv.f_bfree;
+		so.st.bavail = sv.f_bavail;
+		so.st.files = sv.f_files;
+		so.st.ffree = sv.f_ffree;
+		so.st.bsize = sv.f_bsize;
+		so.st.frsize = sv.f_frsize;
+		so.st.namelen = sv.f_namemax;
+		reply(ih->unique, err, &so, sizeof(so));
+		return;
+	}
+
+	default:
+		err = -ENOSYS;
+		break;
+	}
+	reply(ih->unique, err, NULL, 0);
+}
+
+int main(int argc, char *argv[])
+{
+	char opts[256], src[PATH_MAX];
+	struct stat st;
+	int c;
+
+	while ((c = getopt(argc, argv, "wsp:l:")) != -1) {
+		switch (c) {
+		case 'w':
+			want_wb = 1;
+			break;
+		case 's':
+			use_splice = 1;
+			break;
+		case 'p':
+			want_pages = atoi(optarg);
+			if (want_pages < 1 || want_pages > MAX_PAGES) {
+				fprintf(stderr, "max_pages must be 1..%d\n",
+					MAX_PAGES);
+				return 1;
+			}
+			break;
+		case 'l':
+			write_log = fopen(optarg, "a");
+			if (!write_log) {
+				perror(optarg);
+				return 1;
+			}
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (argc - optind != 2)
+		goto usage;
+
+	if (!realpath(argv[optind], src) || stat(src, &st)) {
+		perror(argv[optind]);
+		return 1;
+	}
+
+	nr_nodes = FUSE_ROOT_ID + 1;
+	nodes = calloc(nr_nodes, sizeof(*nodes));
+	nodes[FUSE_ROOT_ID].path = strdup(src);
+	nodes[FUSE_ROOT_ID].nlookup = 1;
+
+	if (use_splice) {
+		/* room for a whole request: header, args and max_pages */
+		int size = (want_pages + 2) * PAGE_SZ;
+
+		if (pipe(req_pipe) || pipe(data_pipe))
+			die("pipe");
+		if (fcntl(req_pipe[0], F_SETPIPE_SZ, size) < 0 ||
+		    fcntl(data_pipe[0], F_SETPIPE_SZ, size) < 0)
+			die("F_SETPIPE_SZ");
+	}
+
+	fuse_fd = open("/dev/fuse", O_RDWR);
+	if (fuse_fd < 0) {
+		perror("/dev/fuse");
+		return 1;
+	}
+	snprintf(opts, sizeof(opts),
+		 "fd=%d,rootmode=%o,user_id=%u,group_id=%u,"
+		 "default_permissions,allow_other",
+		 fuse_fd, st.st_mode & S_IFMT, getuid(), getgid());
+	if (mount("passthrough", argv[optind + 1], "fuse",
+		  MS_NOSUID | MS_NODEV, opts)) {
+		perror("mount");
+		return 1;
+	}
+
+	for (;;) {
+		struct fuse_in_header *ih = (void *) buf;
+		ssize_t len;
+
+		if (use_splice)
+			len = splice(fuse_fd, NULL, req_pipe[1], NULL,
+				     sizeof(buf), 0);
+		else
+			len = read(fuse_fd, buf, sizeof(buf));
+
+		if (len < 0) {
+			if (errno == EINTR || errno == ENOENT)
+				continue;
+			/* ENODEV: unmounted */
+			if (errno != ENODEV)
+				perror("read");
+			break;
+		}
+		if (use_splice && len >= (ssize_t) sizeof(*ih)) {
+			size_t rest = len - sizeof(*ih);
+
+			read_full(req_pipe[0], ih, sizeof(*ih));
+			/* leave WRITE data in the pipe for FUSE_WRITE */
+			if (ih->opcode == FUSE_WRITE)
+				rest = sizeof(struct fuse_write_in);
+			read_full(req_pipe[0], ih + 1, rest);
+		}
+		if ((size_t) len < sizeof(*ih) || ih->len != len) {
+			fprintf(stderr, "short request\n");
+			break;
+		}
+		handle(ih, ih + 1);
+	}
+	return 0;
+
+usage:
+	fprintf(stderr,
+		"usage: %s [-w] [-s] [-p max_pages] [-l log] "
+		"<source> <mountpoint>\n",
+		argv[0]);
+	return 1;
+}
@@ -0,0 +1,64 @@
+#!/bin/sh
+#
+# Check that the writeback cache batches runs of contiguous dirty pages
+# into one FUSE_WRITE each, and never merges pages across a hole.  A
+# pattern of dirty pages and holes is written through the passthrough
+# example with -w, the FUSE_WRITEs it logs are compared with the runs
+# in the pattern, and the backing file is checked afterwards.
+#
+# usage: writeback-holes.sh <passthrough binary> <holes binary> <scratch dir>
+#
+
+PT=$1
+HOLES=$2
+DIR=$3
+[ -x "$PT" ] && [ -x "$HOLES" ] && [ -d "$DIR" ] ||
+	{ echo "usage: $0 <passthrough> <holes> <scratch dir>" >&2; exit 1; }
+
+SRC=$DIR/src
+MNT=$DIR/mnt
+LOG=$DIR/writes.log
+mkdir -p "$SRC" "$MNT" || exit 1
+
+# "<offset> <size>" of each run of 'x' pages
+runs() {
+	echo "$1" | awk '{
+		n = length($0)
+		for (i = 1; i <= n; i++) {
+			if (substr($0, i, 1) != "x")
+				continue
+			for (j = i; j < n && substr($0, j + 1, 1) == "x"; j++)
+				;
+			print (i - 1) * 4096, (j - i + 1) * 4096
+			i = j
+		}
+	}'
+}
+
+fail=0
+for pattern in "xxx.x.xx..xxxx" ".x.x.x.x" "xxxxxxxx" "x..xx...xxx....x"
+do
+	rm -f "$LOG"
+	"$PT" -w -l "$LOG" "$SRC" "$MNT" 2> /dev/null &
+	pid=$!
+	sleep 1
+	mountpoint -q "$MNT" || { echo "mount failed" >&2; exit 1; }
+
+	"$HOLES" "$MNT/f" "$pattern" || fail=1
+
+	umount "$MNT"
+	wait $pid
+
+	sort -n "$LOG" > "$LOG.sorted"
+	if ! runs "$pattern" | cmp -s - "$LOG.sorted"; then
+		echo "$pattern: FUSE_WRITEs do not match the dirty runs:"
+		cat "$LOG.sorted"
+		fail=1
+	elif ! "$HOLES" -c "$SRC/f" "$pattern"; then
+		fail=1
+	else
+		echo "$pattern: ok"
+	fi
+	rm -f "$SRC/f"
+done
+exit $fail
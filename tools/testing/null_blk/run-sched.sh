@@ -0,0 +1,32 @@
+#!/bin/sh
+#
+# Run the fio jobs in this directory against a request-based null_blk
+# device, once for each I/O scheduler.
+#
+# usage: run-sched.sh [results dir] [extra null_blk options]
+#
+
+DIR=$(dirname "$0")
+OUT=${1:-null_blk-results}
+[ $# -gt 0 ] && shift
+SCHEDULERS=${SCHEDULERS:-"noop deadline cfq"}
+DEV=/dev/nullb0
+
+command -v fio > /dev/null || { echo "fio not found" >&2; exit 1; }
+
+rmmod null_blk 2> /dev/null
+modprobe null_blk queue_mode=1 nr_devices=1 "$@" || exit 1
+trap "rmmod null_blk" EXIT
+
+mkdir -p "$OUT" || exit 1
+for sched in $SCHEDULERS; do
+	if ! echo $sched > /sys/block/nullb0/queue/scheduler; then
+		echo "$sched: not available, skipped" >&2
+		continue
+	fi
+	for job in iops lat; do
+		echo "$sched: $job"
+		DEV=$DEV fio --output="$OUT/$sched-$job.txt" "$DIR/$job.fio" ||
+			exit 1
+	done
+done
@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# Compare read throughput of the same file set packed with different
+# squashfs compressors.  Each image is built with mksquashfs, loop
+# mounted, read by parallel-read.sh and unmounted again.  The image
+# size is printed too, as ratio is the other half of the trade-off.
+#
+# usage: compare-comp.sh <source dir> [reader counts...]
+#
+# COMPRESSORS (default "lz4 lzo xz") picks the compressors to compare.
+#
+
+DIR=$(dirname "$0")
+SRC=$1
+[ -d "$SRC" ] || { echo "usage: $0 <source dir> [readers...]" >&2; exit 1; }
+shift
+COMPRESSORS=${COMPRESSORS:-"lz4 lzo xz"}
+
+command -v mksquashfs > /dev/null || { echo "mksquashfs not found" >&2; exit 1; }
+
+TMP=$(mktemp -d) || exit 1
+trap "umount $TMP/mnt 2> /dev/null; rm -rf $TMP" EXIT
+mkdir $TMP/mnt
+
+for comp in $COMPRESSORS; do
+	img=$TMP/$comp.img
+	if ! mksquashfs "$SRC" $img -comp $comp -noappend > /dev/null; then
+		echo "$comp: mksquashfs failed, skipped" >&2
+		continue
+	fi
+	if ! mount -t squashfs -o loop,ro $img $TMP/mnt; then
+		echo "$comp: mount failed, skipped" >&2
+		continue
+	fi
+	echo "$comp: $(du -k $img | cut -f 1) KB image"
+	"$DIR/parallel-read.sh" $TMP/mnt "$@"
+	umount $TMP/mnt
+	rm -f $img
+done
@@ -0,0 +1,32 @@
+#!/bin/sh
+#
+# Measure cold-cache read throughput of a mounted squashfs with an
+# increasing number of parallel readers.  Each run drops the page cache,
+# then cats every regular file under the mount point using N readers at
+# once, so the figures show how well decompression scales with readers.
+# Compare kernels built with the different SQUASHFS_DECOMP_* options.
+#
+# usage: parallel-read.sh <mount point> [reader counts...]
+#
+
+MNT=$1
+[ -d "$MNT" ] || { echo "usage: $0 <mount point> [readers...]" >&2; exit 1; }
+shift
+READERS=${*:-"1 2 4 8"}
+
+# bytes read per pass, for the throughput figure
+KB=$(find "$MNT" -type f -print0 | xargs -0 du -k -c --apparent-size |
+	tail -n 1 | cut -f 1)
+
+for n in $READERS; do
+	sync
+	echo 3 > /proc/sys/vm/drop_caches || exit 1
+	start=$(date +%s.%N)
+	find "$MNT" -type f -print0 |
+		xargs -0 -n 16 -P "$n" cat > /dev/null || exit 1
+	end=$(date +%s.%N)
+	echo "$n $start $end $KB" | awk '{
+		t = $3 - $2
+		printf "%3d readers: %8.2f s %9.2f MB/s\n", $1, t, $4 / 1024 / t
+	}'
+done
@@ -0,0 +1,280 @@
+/*
+ * mtp-bench.c -- measure MTP gadget bulk throughput
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -g -o mtp-bench mtp-bench.c */
+
+/*
+ * Both ends of a raw file transfer through the MTP function, without any
+ * MTP protocol on top, so only the gadget's bulk data path is measured.
+ * With dummy_hcd both ends run on the same machine:
+ *
+ *   modprobe dummy_hcd; modprobe g_android   (MTP function enabled)
+ *
+ *   gadget -> host:
+ *	mtp-bench send /data/file &
+ *	mtp-bench in /dev/bus/usb/BBB/DDD <file size>
+ *
+ *   host -> gadget:
+ *	mtp-bench receive /data/file <size> &
+ *	mtp-bench out /dev/bus/usb/BBB/DDD <size>
+ *
+ * Each side prints the bytes moved and the resulting rate.  The gadget
+ * buffer sizes and queue depths are the mtp_tx_req_len, mtp_rx_req_len,
+ * mtp_tx_reqs and mtp_rx_reqs module parameters of the gadget driver.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <linux/types.h>
+#include <linux/usbdevice_fs.h>
+#include <linux/usb/ch9.h>
+
+#include "../../include/linux/usb/f_mtp.h"
+
+#define MTP_DEV		"/dev/mtp_usb"
+#define MAX_URBS	16
+
+static unsigned buflen = 16384;
+static unsigned nurbs = 4;
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void report(const char *what, long long bytes, double secs)
+{
+	printf("%s: %lld bytes in %.3f s, %.2f MB/s\n", what, bytes, secs,
+	       secs > 0 ? bytes / secs / (1024 * 1024) : 0.0);
+}
+
+/* gadget side: hand the file to f_mtp and time the ioctl */
+static int gadget_xfer(int send, const char *path, long long size)
+{
+	struct mtp_file_range mfr;
+	struct stat st;
+	double start;
+	int fd, mtp;
+
+	fd = open(path, send ? O_RDONLY : O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		die(path);
+	if (send) {
+		if (fstat(fd, &st))
+			die(path);
+		size = st.st_size;
+	}
+	mtp = open(MTP_DEV, O_RDWR);
+	if (mtp < 0)
+		die(MTP_DEV);
+
+	memset(&mfr, 0, sizeof(mfr));
+	mfr.fd = fd;
+	mfr.offset = 0;
+	mfr.length = size;
+
+	start = now();
+	if (ioctl(mtp, send ? MTP_SEND_FILE : MTP_RECEIVE_FILE, &mfr))
+		die(send ? "MTP_SEND_FILE" : "MTP_RECEIVE_FILE");
+	if (!send && fsync(fd))
+		die(path);
+	report(send ? "send" : "receive", size, now() - start);
+
+	close(mtp);
+	close(fd);
+	return 0;
+}
+
+/* host side: find the bulk endpoints of the MTP/PTP interface */
+static int find_endpoints(int fd, unsigned *ifnum, unsigned *ep_in,
+			  unsigned *ep_out, unsigned *maxpacket)
+{
+	unsigned char desc[4096];
+	ssize_t len, i;
+	int found = 0;
+
+	len = read(fd, desc, sizeof(desc));
+	if (len < 0)
+		die("read descriptors");
+
+	for (i = 0; i + 2 <= len && desc[i]; i += desc[i]) {
+		if (desc[i + 1] == USB_DT_INTERFACE) {
+			struct usb_interface_descriptor *intf = (void *)&desc[i];
+
+			if (found)
+				break;
+			if (intf->bInterfaceClass == USB_CLASS_VENDOR_SPEC ||
+			    intf->bInterfaceClass == USB_CLASS_STILL_IMAGE) {
+				*ifnum = intf->bInterfaceNumber;
+				*ep_in = *ep_out = 0;
+				found = 1;
+			}
+		} else if (found && desc[i + 1] == USB_DT_ENDPOINT) {
+			struct usb_endpoint_descriptor *ep = (void *)&desc[i];
+
+			if ((ep->bmAttributes & USB_ENDPOINT_XFERTYPE_MASK) !=
+			    USB_ENDPOINT_XFER_BULK)
+				continue;
+			if (ep->bEndpointAddress & USB_DIR_IN)
+				*ep_in = ep->bEndpointAddress;
+			else
+				*ep_out = ep->bEndpointAddress;
+			/* wMaxPacketSize is little endian and unaligned */
+			*maxpacket = desc[i + 4] | desc[i + 5] << 8;
+		}
+	}
+	return found && *ep_in && *ep_out ? 0 : -1;
+}
+
+/* host side: stream size bytes with nurbs bulk URBs kept in flight */
+static int host_xfer(int in, const char *path, long long size)
+{
+	struct usbdevfs_urb urbs[MAX_URBS], *urb;
+	unsigned ifnum, ep_in, ep_out, maxpacket = 512;
+	long long submitted = 0, done = 0;
+	int queued = 0, zlp, fd, i;
+	double start;
+	char *buf;
+
+	fd = open(path, O_RDWR);
+	if (fd < 0)
+		die(path);
+	if (find_endpoints(fd, &ifnum, &ep_in, &ep_out, &maxpacket)) {
+		fprintf(stderr, "%s: no MTP interface found\n", path);
+		return 1;
+	}
+	if (ioctl(fd, USBDEVFS_CLAIMINTERFACE, &ifnum))
+		die("USBDEVFS_CLAIMINTERFACE");
+
+	buf = malloc((size_t)buflen * nurbs);
+	if (!buf)
+		die("malloc");
+	memset(buf, 0x5a, (size_t)buflen * nurbs);
+	memset(urbs, 0, sizeof(urbs));
+
+	/* an aligned IN transfer is terminated by a zero length packet */
+	zlp = in && size % maxpacket == 0;
+
+	start = now();
+	for (;;) {
+		while (queued < (int)nurbs && (submitted < size || zlp)) {
+			unsigned len = size - submitted > buflen ?
+					buflen : size - submitted;
+
+			/* find an idle URB */
+			for (i = 0; urbs[i].usercontext; i++)
+				;
+			urb = &urbs[i];
+			memset(urb, 0, sizeof(*urb));
+			urb->type = USBDEVFS_URB_TYPE_BULK;
+			urb->endpoint = in ? ep_in : ep_out;
+			urb->buffer = buf + (size_t)i * buflen;
+			urb->buffer_length = in && !len ? buflen : len;
+			urb->usercontext = urb;
+			if (ioctl(fd, USBDEVFS_SUBMITURB, urb))
+				die("USBDEVFS_SUBMITURB");
+			if (!len)
+				zlp = 0;
+			submitted += len;
+			queued++;
+		}
+		if (!queued)
+			break;
+
+		if (ioctl(fd, USBDEVFS_REAPURB, &urb))
+			die("USBDEVFS_REAPURB");
+		queued--;
+		urb->usercontext = NULL;
+		if (urb->status) {
+			fprintf(stderr, "urb status %d\n", urb->status);
+			return 1;
+		}
+		done += urb->actual_length;
+		if (in && urb->actual_length < urb->buffer_length &&
+		    done < size) {
+			fprintf(stderr, "short read after %lld bytes\n", done);
+			return 1;
+		}
+	}
+	report(in ? "in" : "out", done, now() - start);
+
+	ioctl(fd, USBDEVFS_RELEASEINTERFACE, &ifnum);
+	free(buf);
+	close(fd);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s send FILE\n"
+		"       %s receive FILE SIZE\n"
+		"       %s [-b BUFLEN] [-n URBS] in|out USBDEV SIZE\n",
+		prog, prog, prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *prog = argv[0];
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:n:")) != -1) {
+		switch (opt) {
+		case 'b':
+			buflen = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			nurbs = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(prog);
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (!buflen || !nurbs || nurbs > MAX_URBS || argc < 2)
+		usage(prog);
+
+	if (!strcmp(argv[0], "send"))
+		return gadget_xfer(1, argv[1], 0);
+	if (argc < 3)
+		usage(prog);
+	if (!strcmp(argv[0], "receive"))
+		return gadget_xfer(0, argv[1], strtoll(argv[2], NULL, 0));
+	if (!strcmp(argv[0], "in"))
+		return host_xfer(1, argv[1], strtoll(argv[2], NULL, 0));
+	if (!strcmp(argv[0], "out"))
+		return host_xfer(0, argv[1], strtoll(argv[2], NULL, 0));
+	usage(prog);
+	return 2;
+}